@@ -4,14 +4,17 @@
 #include "gfx/vulkan/Resource.hpp"
 #include "gfx/vulkan/Device.hpp"
 #include "gfx/vulkan/Pipeline.hpp"
+#include "gfx/vulkan/MsaaTargets.hpp"
+
+#include "Meshlet.hpp"
+#include "Model.hpp"
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <bit>
 #include <chrono>
+#include <unordered_map>
 
-#include <assimp/Importer.hpp>
-#include <assimp/scene.h>
-#include <assimp/postprocess.h>
 #include <imgui.h>
 
 using namespace Engine;
@@ -21,54 +24,42 @@ class ModelRenderer : public Renderer {
    private:
     Buffer vertexBuffer;
     Buffer indexBuffer;
-    uint32_t indexCount;
+    vk::IndexType indexType;
+
+    Model model;
+    uint32_t currentLod = 0;
+    float maxPixelError = 1.0f;
+
+    // LOD 0 is drawn per meshlet, skipping the ones facing away
+    bool meshletCulling = true;
+    glm::vec3 modelSpaceCameraPos;
+    uint32_t visibleMeshlets = 0;
+
+    // texture.hlsl does not read normals, so the 20 byte layout loses nothing
+    VertexLayout vertexLayout = VertexLayout::eQuantized;
+    glm::mat4 dequantization;
 
     vk::DescriptorSetLayout uboLayout;
     vk::DescriptorSet uboSet;
-    Buffer uniformBuffer;
+    // Of this frame's copy in the uniform ring
+    uint32_t uboOffset = 0;
 
     Texture texture;
     vk::DescriptorSetLayout textureLayout;
     vk::DescriptorSet textureSet;
 
     vk::PipelineLayout pipelineLayout;
-    vk::Pipeline pipeline;
-
-    Texture depthTexture;
-    Texture msaaTexture;
+    // Built the first time a sample count is rendered with and kept, so a
+    // switch back and forth neither stalls nor recompiles
+    std::unordered_map<vk::SampleCountFlagBits, vk::Pipeline> pipelines;
 
     float rotation = 0.0f;
     float minLod = 0.0f;
     bool needRecreateSampler = false;
 
-    bool msaaResetFlag = false;
     int sampleValueIndex = 0;
     int maxSampleValueIndex = 3;
 
-    struct Vertex {
-        glm::vec3 pos;
-        glm::vec2 uv;
-        glm::vec4 color;
-
-        static vk::VertexInputBindingDescription getBindingDescription() {
-            return vk::VertexInputBindingDescription(
-                0, sizeof(Vertex), vk::VertexInputRate::eVertex);
-        }
-
-        static std::array<vk::VertexInputAttributeDescription, 3>
-        getAttributeDescriptions() {
-            return {
-                vk::VertexInputAttributeDescription(
-                    0, 0, vk::Format::eR32G32B32Sfloat, offsetof(Vertex, pos)),
-                vk::VertexInputAttributeDescription(
-                    1, 0, vk::Format::eR32G32Sfloat, offsetof(Vertex, uv)),
-                vk::VertexInputAttributeDescription(
-                    2, 0, vk::Format::eR32G32B32A32Sfloat,
-                    offsetof(Vertex, color)),
-            };
-        }
-    };
-
     struct UBO {
         glm::mat4 model;
         glm::mat4 view;
@@ -76,30 +67,15 @@ class ModelRenderer : public Renderer {
     } ubo;
 
     void onPrepare() override {
-        sampleValueIndex = std::floor(std::log2((double)msaaSamples));
-        maxSampleValueIndex = sampleValueIndex;
-
-        auto extent = getFinalExtent();
-        depthTexture = device->createTexture();
-        depthTexture.sampleCount = msaaSamples;
-        depthTexture.allocate(extent, 1, vk::Format::eD32SfloatS8Uint,
-                              vk::ImageUsageFlagBits::eDepthStencilAttachment,
-                              vk::ImageAspectFlagBits::eDepth);
-        msaaTexture = device->createTexture();
-        msaaTexture.sampleCount = msaaSamples;
-        msaaTexture.allocate(extent, 1, swapchain->format,
-                             vk::ImageUsageFlagBits::eColorAttachment,
-                             vk::ImageAspectFlagBits::eColor);
-        msaaTexture.createSampler();
+        sampleValueIndex = std::countr_zero((uint32_t)msaaSamples);
+        maxSampleValueIndex = std::countr_zero((uint32_t)maxMsaaSamples);
 
         prepareData();
         prepareTexture();
         prepareUBO();
-        buildPipeline();
+        preparePipelineLayout();
     }
 
-    void onSceneResize() override { recreateTextures(); }
-
     void onUpdate() override {
         static auto startTime = std::chrono::high_resolution_clock::now();
         auto currentTime = std::chrono::high_resolution_clock::now();
@@ -107,19 +83,25 @@ class ModelRenderer : public Renderer {
             std::chrono::duration<double, std::milli>(currentTime - startTime)
                 .count();
 
-        ubo.model = glm::rotate(glm::mat4(1.0f),
-                                (float)rotation / 90 * glm::radians(90.0f),
-                                glm::vec3(0.0f, 0.0f, 1.0f));
-        ubo.view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f),
+        auto transform = glm::rotate(glm::mat4(1.0f),
+                                     (float)rotation / 90 * glm::radians(90.0f),
+                                     glm::vec3(0.0f, 0.0f, 1.0f));
+        ubo.model = transform * dequantization;
+        glm::vec3 cameraPos(2.0f, 2.0f, 2.0f);
+        ubo.view = glm::lookAt(cameraPos, glm::vec3(0.0f),
                                glm::vec3(0.0f, 0.0f, 1.0f));
         auto extent = getFinalExtent();
         ubo.proj =
             glm::perspective(glm::radians(45.0f),
                              extent.width / (float)extent.height, 0.1f, 10.0f);
+        currentLod = model.mesh.selectLod(
+            transform, cameraPos, ubo.proj[1][1] * extent.height * 0.5f,
+            maxPixelError);
+        modelSpaceCameraPos =
+            glm::vec3(glm::inverse(transform) * glm::vec4(cameraPos, 1.0f));
         ubo.proj[1][1] *= -1;
 
-        std::memcpy(uniformBuffer.allocationInfo.pMappedData, &ubo,
-                    sizeof(UBO));
+        uboOffset = uniformRing.push(ubo);
 
         auto logicalDevice = device->getLogicalDevice();
         if (needRecreateSampler) {
@@ -144,67 +126,44 @@ class ModelRenderer : public Renderer {
             logicalDevice.updateDescriptorSets(descriptorWrite, {});
             needRecreateSampler = false;
         }
-
-        if (msaaResetFlag) {
-            recreateTextures();
-
-            logicalDevice.destroyPipeline(pipeline);
-            logicalDevice.destroyPipelineLayout(pipelineLayout);
-
-            buildPipeline();
-
-            msaaResetFlag = false;
-        }
-    }
-
-    void recreateTextures() {
-        auto logicalDevice = device->getLogicalDevice();
-        logicalDevice.waitIdle();
-
-        depthTexture.destroy();
-        msaaTexture.destroy();
-
-        auto extent = getFinalExtent();
-        depthTexture.sampleCount = msaaSamples;
-        depthTexture.allocate(extent, 1, vk::Format::eD32SfloatS8Uint,
-                              vk::ImageUsageFlagBits::eDepthStencilAttachment,
-                              vk::ImageAspectFlagBits::eDepth);
-        msaaTexture.sampleCount = msaaSamples;
-        msaaTexture.allocate(extent, 1, swapchain->format,
-                             vk::ImageUsageFlagBits::eColorAttachment,
-                             vk::ImageAspectFlagBits::eColor);
-        msaaTexture.createSampler();
     }
 
     void onDestroy() override {
-        uniformBuffer.destroy();
         vertexBuffer.destroy();
         indexBuffer.destroy();
         texture.destroy();
-        depthTexture.destroy();
-        msaaTexture.destroy();
 
         auto logicalDevice = device->getLogicalDevice();
         logicalDevice.destroyDescriptorSetLayout(uboLayout);
         logicalDevice.destroyDescriptorSetLayout(textureLayout);
-        logicalDevice.destroyPipeline(pipeline);
+        for (auto [sampleCount, pipeline] : pipelines) {
+            logicalDevice.destroyPipeline(pipeline);
+        }
         logicalDevice.destroyPipelineLayout(pipelineLayout);
     }
 
-    void draw() override {
-        auto& cmdBuffer = getCurrentDrawCmdBuffer();
-
-        vk::RenderingAttachmentInfo depthAttachmentInfo{
-            .imageView = depthTexture.imageView,
-            .imageLayout = vk::ImageLayout::eDepthStencilAttachmentOptimal,
-            .loadOp = vk::AttachmentLoadOp::eClear,
-            .storeOp = vk::AttachmentStoreOp::eStore,
-            .clearValue = vk::ClearValue{.depthStencil =
-                                             {
-                                                 .depth = 1.0f,
-                                                 .stencil = 0,
-                                             }},
-        };
+    void setupRenderGraph(RenderGraph &graph,
+                          RenderGraphHandle finalColor) override {
+        auto targets = createMsaaTargets(graph, finalColor, getFinalExtent(),
+                                         swapchain->format,
+                                         vk::Format::eD32SfloatS8Uint,
+                                         msaaSamples);
+        auto pipeline = getPipeline(msaaSamples);
+
+        auto scenePass = graph.addPass(
+            "scene",
+            [this, &graph, targets, pipeline](vk::CommandBuffer cmdBuffer) {
+                recordScenePass(cmdBuffer, graph, targets, pipeline);
+            });
+        targets.declareWrites(scenePass);
+    }
+
+    void recordScenePass(vk::CommandBuffer cmdBuffer, const RenderGraph &graph,
+                         const MsaaTargets &targets, vk::Pipeline pipeline) {
+        auto depthAttachmentInfo = targets.getDepthAttachment(graph);
+        auto colorAttachmentInfo = targets.getColorAttachment(
+            graph, getFinalColorTexture().imageView,
+            vk::ClearColorValue{std::array<float, 4>{0.0f, 0.0f, 0.0f, 1.0f}});
 
         vk::RenderingInfo renderingInfo{
             .renderArea =
@@ -213,57 +172,46 @@ class ModelRenderer : public Renderer {
                     .extent = getFinalExtent(),
                 },
             .layerCount = 1,
+            .colorAttachmentCount = 1,
+            .pColorAttachments = &colorAttachmentInfo,
             .pDepthAttachment = &depthAttachmentInfo,
         };
 
-        vk::RenderingAttachmentInfo renderingAttachmentInfo{
-            .imageLayout = vk::ImageLayout::eColorAttachmentOptimal,
-            .loadOp = vk::AttachmentLoadOp::eClear,
-            .storeOp = vk::AttachmentStoreOp::eStore,
-            .clearValue = vk::ClearColorValue{std::array<float, 4>{0.0f, 0.0f,
-                                                                   0.0f, 1.0f}},
-        };
-
-        bool useMultiSampling = (msaaSamples | vk::SampleCountFlagBits::e1) !=
-                                vk::SampleCountFlagBits::e1;
-        if (useMultiSampling) {
-            renderingAttachmentInfo.imageView = msaaTexture.imageView;
-            renderingAttachmentInfo.resolveMode =
-                vk::ResolveModeFlagBits::eAverage;
-            renderingAttachmentInfo.resolveImageView =
-                getFinalColorTexture().imageView;
-            renderingAttachmentInfo.resolveImageLayout =
-                vk::ImageLayout::eColorAttachmentOptimal;
-        } else {
-            renderingAttachmentInfo.imageView =
-                getFinalColorTexture().imageView;
-        }
-
-        renderingInfo.colorAttachmentCount = 1;
-        renderingInfo.pColorAttachments = &renderingAttachmentInfo;
-
         cmdBuffer.beginRendering(renderingInfo);
 
         cmdBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline);
         cmdBuffer.bindVertexBuffers(0, {vertexBuffer.buffer}, {0});
-        cmdBuffer.bindIndexBuffer(indexBuffer.buffer, 0,
-                                  vk::IndexType::eUint16);
+        cmdBuffer.bindIndexBuffer(indexBuffer.buffer, 0, indexType);
         cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
                                      pipelineLayout, 0, {uboSet, textureSet},
-                                     {});
+                                     {uboOffset});
 
         auto extent = getFinalExtent();
         cmdBuffer.setViewport(0, getDefaultViewport(extent));
         cmdBuffer.setScissor(0, getDefaultScissor(extent));
 
-        cmdBuffer.drawIndexed(indexCount, 1, 0, 0, 0);
+        visibleMeshlets = 0;
+        if (meshletCulling && currentLod == 0 &&
+            !model.mesh.meshlets.empty()) {
+            for (const auto& meshlet : model.mesh.meshlets) {
+                if (isMeshletBackfacing(meshlet, modelSpaceCameraPos)) {
+                    continue;
+                }
+                cmdBuffer.drawIndexed(meshlet.indexCount, 1,
+                                      meshlet.firstIndex, 0, 0);
+                visibleMeshlets++;
+            }
+        } else {
+            const auto& lod = model.mesh.lods[currentLod];
+            cmdBuffer.drawIndexed(lod.indexCount, 1, lod.firstIndex, 0, 0);
+        }
         cmdBuffer.endRendering();
     }
 
     void drawUi() override {
         auto fontScale = device->getUiLayout()->fontScale;
         auto boxWidth = fontScale * 12;
-        auto boxHeight = fontScale * 10;
+        auto boxHeight = fontScale * 15;
 
         ImGui::SetNextWindowSize(ImVec2(boxWidth, boxHeight), ImGuiCond_Once);
         ImGui::SetNextWindowPos(
@@ -290,6 +238,20 @@ class ModelRenderer : public Renderer {
 
         ImGui::Separator();
 
+        ImGui::Text("LOD %u (%u triangles)", currentLod,
+                    model.mesh.lods[currentLod].indexCount / 3);
+        ImGui::SetNextItemWidth(ImGui::GetWindowWidth() -
+                                ImGui::GetStyle().WindowPadding.x * 2);
+        ImGui::SliderFloat("##lodpixelerror", &maxPixelError, 0.25f, 32.0f,
+                           "%.2f px");
+        ImGui::Checkbox("Meshlet Culling", &meshletCulling);
+        if (meshletCulling && currentLod == 0) {
+            ImGui::Text("%u / %zu meshlets", visibleMeshlets,
+                        model.mesh.meshlets.size());
+        }
+
+        ImGui::Separator();
+
         ImGui::Text("MSAA Samples");
         ImGui::SetNextItemWidth(ImGui::GetWindowWidth() -
                                 ImGui::GetStyle().WindowPadding.x * 2);
@@ -299,7 +261,6 @@ class ModelRenderer : public Renderer {
                          IM_ARRAYSIZE(sampleCountOptions))) {
             if (sampleValueIndex <= maxSampleValueIndex) {
                 msaaSamples = (vk::SampleCountFlagBits)(1 << sampleValueIndex);
-                msaaResetFlag = true;
             } else {
                 sampleValueIndex = maxSampleValueIndex;
             }
@@ -315,7 +276,7 @@ class ModelRenderer : public Renderer {
 
         auto binding = vk::DescriptorSetLayoutBinding{
             .binding = 0,
-            .descriptorType = vk::DescriptorType::eUniformBuffer,
+            .descriptorType = vk::DescriptorType::eUniformBufferDynamic,
             .descriptorCount = 1,
             .stageFlags = vk::ShaderStageFlagBits::eVertex,
         };
@@ -333,22 +294,14 @@ class ModelRenderer : public Renderer {
                      })
                      .front();
 
-        uniformBuffer = device->createBuffer();
-        uniformBuffer.allocate(sizeof(UBO),
-                               vk::BufferUsageFlagBits::eUniformBuffer, true);
-
-        vk::DescriptorBufferInfo bufferInfo{
-            .buffer = uniformBuffer.buffer,
-            .offset = 0,
-            .range = sizeof(UBO),
-        };
+        auto bufferInfo = uniformRing.getDescriptorInfo(sizeof(UBO));
 
         vk::WriteDescriptorSet descriptorWrite{
             .dstSet = uboSet,
             .dstBinding = 0,
             .dstArrayElement = 0,
             .descriptorCount = 1,
-            .descriptorType = vk::DescriptorType::eUniformBuffer,
+            .descriptorType = vk::DescriptorType::eUniformBufferDynamic,
             .pBufferInfo = &bufferInfo,
         };
         logicalDevice.updateDescriptorSets(descriptorWrite, {});
@@ -398,47 +351,14 @@ class ModelRenderer : public Renderer {
     }
 
     void prepareData() {
-        auto importer = Assimp::Importer();
-        const aiScene* scene =
-            importer.ReadFile(RESOURCE_DIR + std::string("viking_room.obj"),
-                              aiProcess_Triangulate);
-
-        std::vector<Vertex> vertices;
-        std::vector<uint16_t> indices;
-
-        for (unsigned int i = 0; i < scene->mNumMeshes; i++) {
-            aiMesh* mesh = scene->mMeshes[i];
-            for (unsigned int j = 0; j < mesh->mNumVertices; j++) {
-                Vertex vertex;
-                vertex.pos =
-                    glm::vec3(mesh->mVertices[j].x, mesh->mVertices[j].y,
-                              mesh->mVertices[j].z);
-                vertex.uv = mesh->mTextureCoords[0]
-                                ? glm::vec2(mesh->mTextureCoords[0][j].x,
-                                            mesh->mTextureCoords[0][j].y)
-                                : glm::vec2(0.0f, 0.0f);
-                vertex.color = mesh->mColors[0]
-                                   ? glm::vec4(mesh->mColors[0][j].r,
-                                               mesh->mColors[0][j].g,
-                                               mesh->mColors[0][j].b,
-                                               mesh->mColors[0][j].a)
-                                   : glm::vec4(1.0f);
-                vertex.uv.y =
-                    1.0f -
-                    vertex.uv.y;  // obj format assume coord 0 is the bottom
-                vertices.push_back(vertex);
-            }
-
-            for (unsigned int j = 0; j < mesh->mNumFaces; j++) {
-                aiFace face = mesh->mFaces[j];
-                for (unsigned int k = 0; k < face.mNumIndices; k++) {
-                    indices.push_back(face.mIndices[k]);
-                }
-            }
+        model.loadFromFile("viking_room.obj", {.buildMeshlets = true});
+        if (vertexLayout == VertexLayout::eQuantized) {
+            model.mesh.quantize();
         }
+        dequantization = model.mesh.dequantization;
 
-        auto vbSize = sizeof(Vertex) * vertices.size();
-        auto ibSize = sizeof(uint16_t) * indices.size();
+        auto vbSize = model.getTotalVerticesSize(vertexLayout);
+        auto ibSize = model.getTotalIndicesSize();
 
         vertexBuffer = device->createBuffer();
         vertexBuffer.allocate(vbSize,
@@ -448,8 +368,8 @@ class ModelRenderer : public Renderer {
         auto stagingBuffer = device->createBuffer();
         stagingBuffer.allocate(vbSize, vk::BufferUsageFlagBits::eTransferSrc,
                                true);
-        std::memcpy(stagingBuffer.allocationInfo.pMappedData, vertices.data(),
-                    vbSize);
+        std::memcpy(stagingBuffer.allocationInfo.pMappedData,
+                    model.mesh.getVertexData(vertexLayout).data(), vbSize);
 
         auto cmdBuffer = device->allocateCommandBuffer();
         cmdBuffer.copyBuffer(stagingBuffer.buffer, vertexBuffer.buffer,
@@ -459,64 +379,90 @@ class ModelRenderer : public Renderer {
         stagingBuffer.destroy();
 
         indexBuffer = device->createBuffer();
-        indexBuffer.allocate(sizeof(uint16_t) * indices.size(),
-                             vk::BufferUsageFlagBits::eIndexBuffer);
-        indexCount = static_cast<uint32_t>(indices.size());
+        indexBuffer.allocate(ibSize, vk::BufferUsageFlagBits::eIndexBuffer);
+        indexType = model.mesh.indexType;
 
         void* data = indexBuffer.map();
-        std::memcpy(data, indices.data(), sizeof(uint16_t) * indices.size());
+        model.mesh.writeIndices(data);
         indexBuffer.unmap();
     }
 
-    void buildPipeline() {
+    void preparePipelineLayout() {
+        vk::DescriptorSetLayout setLayouts[2] = {uboLayout, textureLayout};
+        pipelineLayout = device->getLogicalDevice().createPipelineLayout({
+            .setLayoutCount = 2,
+            .pSetLayouts = setLayouts,
+        });
+
+        // Every sample count built so far is rebuilt on a shader edit
+        shaderReloader.watch(
+            {"test/texture.vert.spv", "test/texture.frag.spv"}, [this] {
+                // All or nothing, a failed build drops the ones done so far
+                std::unordered_map<vk::SampleCountFlagBits, vk::Pipeline>
+                    rebuilt;
+                try {
+                    for (auto [sampleCount, pipeline] : pipelines) {
+                        rebuilt[sampleCount] = buildPipeline(sampleCount);
+                    }
+                } catch (...) {
+                    for (auto [sampleCount, pipeline] : rebuilt) {
+                        device->getLogicalDevice().destroyPipeline(pipeline);
+                    }
+                    throw;
+                }
+                for (auto [sampleCount, pipeline] : pipelines) {
+                    shaderReloader.retire(pipeline);
+                }
+                pipelines = std::move(rebuilt);
+            });
+    }
+
+    vk::Pipeline getPipeline(vk::SampleCountFlagBits sampleCount) {
+        auto it = pipelines.find(sampleCount);
+        if (it == pipelines.end()) {
+            it = pipelines.emplace(sampleCount, buildPipeline(sampleCount))
+                     .first;
+        }
+        return it->second;
+    }
+
+    vk::Pipeline buildPipeline(vk::SampleCountFlagBits sampleCount) {
         auto logicalDevice = device->getLogicalDevice();
         PipelineBuilder pipelineBuilder(logicalDevice);
 
-        auto vertShader = device->createShaderModule("test/texture.vert.spv");
-        auto fragShader = device->createShaderModule("test/texture.frag.spv");
+        // Unique, a failed reload throws before the pipeline is built
+        vk::UniqueShaderModule vertShader(
+            device->createShaderModule("test/texture.vert.spv"), logicalDevice);
+        vk::UniqueShaderModule fragShader(
+            device->createShaderModule("test/texture.frag.spv"), logicalDevice);
 
         vk::PipelineShaderStageCreateInfo vertexShaderStageCI{
             .stage = vk::ShaderStageFlagBits::eVertex,
-            .module = vertShader,
+            .module = *vertShader,
             .pName = "vert",
         };
         vk::PipelineShaderStageCreateInfo fragmentShaderStageCI{
             .stage = vk::ShaderStageFlagBits::eFragment,
-            .module = fragShader,
+            .module = *fragShader,
             .pName = "frag",
         };
 
-        auto bindingDescription = Vertex::getBindingDescription();
-        auto attributeDescriptions = Vertex::getAttributeDescriptions();
-        pipelineBuilder.vertexInputCI.vertexBindingDescriptionCount = 1;
-        pipelineBuilder.vertexInputCI.pVertexBindingDescriptions =
-            &bindingDescription;
-        pipelineBuilder.vertexInputCI.vertexAttributeDescriptionCount =
-            static_cast<uint32_t>(attributeDescriptions.size());
-        pipelineBuilder.vertexInputCI.pVertexAttributeDescriptions =
-            attributeDescriptions.data();
+        pipelineBuilder.setVertexInput(
+            Vertex::getBindingDescriptions(vertexLayout),
+            Vertex::getAttributeDescriptions(vertexLayout));
 
         pipelineBuilder.rasterizationCI.frontFace =
             vk::FrontFace::eCounterClockwise;
 
-        pipelineBuilder.multisampleCI.rasterizationSamples = msaaSamples;
+        pipelineBuilder.multisampleCI.rasterizationSamples = sampleCount;
 
         pipelineBuilder.addColorAttachment(swapchain->format);
 
-        vk::DescriptorSetLayout setLayouts[2] = {uboLayout, textureLayout};
-        pipelineLayout = logicalDevice.createPipelineLayout({
-            .setLayoutCount = 2,
-            .pSetLayouts = setLayouts,
-        });
-
         pipelineBuilder.setLayout(pipelineLayout);
         pipelineBuilder.shaderStages.push_back(vertexShaderStageCI);
         pipelineBuilder.shaderStages.push_back(fragmentShaderStageCI);
 
-        pipeline = pipelineBuilder.build();
-
-        logicalDevice.destroyShaderModule(vertShader);
-        logicalDevice.destroyShaderModule(fragShader);
+        return pipelineBuilder.build();
     }
 };
 
@@ -1,8 +1,15 @@
 #include "core/Core.hpp"
+#include "core/FrustumCuller.hpp"
+#include "core/ShadowCascades.hpp"
 
 #include "gfx/vulkan/Renderer.hpp"
 #include "gfx/vulkan/Resource.hpp"
 #include "gfx/vulkan/Device.hpp"
+#include "gfx/vulkan/DepthPyramid.hpp"
+#include "gfx/vulkan/DrawCuller.hpp"
+#include "gfx/vulkan/GeometryPool.hpp"
+#include "gfx/vulkan/IndirectDraw.hpp"
+#include "gfx/vulkan/InstanceBuffer.hpp"
 #include "gfx/vulkan/Pipeline.hpp"
 #include "gfx/vulkan/Utils.hpp"
 
@@ -11,41 +18,75 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <imgui_impl_vulkan.h>
+#include <chrono>
+#include <unordered_map>
 
 using namespace Engine;
 
-struct BufferIndex {
-    uint32_t startIndex;
-    uint32_t count;
-};
+const uint32_t MAX_SCENE_OBJECTS = 4096;
+
+// Copies of the cube are laid out on a grid and share its geometry
+const uint32_t CUBE_GRID_FIRST_ID = 1000;
+const int MAX_CUBE_GRID_SIZE = 60;
+
+// Cull views, the camera's and two per shadow cascade. The cascade views
+// keep either the dynamic or the static shadow casters.
+const uint32_t CAMERA_VIEW = 0;
+const uint32_t FIRST_CASCADE_VIEW = 1;
+const uint32_t FIRST_STATIC_CASCADE_VIEW =
+    FIRST_CASCADE_VIEW + MAX_SHADOW_CASCADES;
+// No object sets every flag, a view requiring all of them draws nothing
+const uint32_t NO_OBJECTS = ~0u;
+
+// Casters this far towards the light from a cascade still cast into it
+const float SHADOW_CASTER_DISTANCE = 20.0f;
+
+// The camera projection, the cascades are fitted to the same frustum
+const float CAMERA_FOV_Y = glm::radians(45.0f);
+const float CAMERA_NEAR = 0.1f;
+const float CAMERA_FAR = 1000.0f;
 
 struct ModelInfo {
     uint32_t id;
-
-    BufferIndex vertex;
-    BufferIndex index;
+    GeometryHandle geometry;
 
     glm::mat4 model;
+    bool castsShadow = true;
+    // Static casters are drawn into the shadow cache instead of every frame
+    bool isStatic = true;
 };
 
 struct SceneData {
     std::vector<ModelInfo> modelInfos;
+    std::unordered_map<uint32_t, size_t> modelIndices;
 
-    Buffer vertexBuffer;
-    Buffer indexBuffer;
-    Buffer uniformBuffer;
+    // Split vertex streams, the shadow pass only binds the positions
+    GeometryPool geometryPool;
+
+    // Owns the per frame object buffers. Without GPU culling the draw
+    // commands are written on the CPU instead, both once the frame's
+    // previous submission has finished.
+    DrawCuller culler;
+    DepthPyramid depthPyramid;
+    std::array<IndirectDrawBuffer, MAX_SHADOW_CASCADES> shadowDraws;
+    std::array<IndirectDrawBuffer, MAX_SHADOW_CASCADES> staticShadowDraws;
+    IndirectDrawBuffer sceneDraws;
+    InstanceBuffer instances;
+
+    // World bounds for the CPU path, slot i is modelInfos[i]
+    FrustumCuller frustumCuller;
+    std::vector<uint32_t> visibleObjects;
 
     vk::DescriptorSetLayout descriptorSetLayout;
-    vk::DescriptorSet descriptorSet;
+    std::array<vk::DescriptorSet, MAX_FRAMES_IN_FLIGHT> descriptorSets;
 
     ModelInfo &getModelInfoById(uint32_t id) {
-        for (auto &modelInfo : modelInfos) {
-            if (modelInfo.id == id) {
-                return modelInfo;
-            }
+        auto it = modelIndices.find(id);
+        if (it == modelIndices.end()) {
+            throw std::runtime_error("Model Info not found");
         }
 
-        throw std::runtime_error("Model Info not found");
+        return modelInfos[it->second];
     }
 };
 
@@ -53,16 +94,31 @@ struct UBO {
     glm::mat4 view;
     glm::mat4 proj;
 
-    glm::mat4 lightView;
-    glm::mat4 lightProj;
+    std::array<glm::mat4, MAX_SHADOW_CASCADES> cascadeViewProj;
+    // View space distance where each cascade ends
+    glm::vec4 cascadeSplits;
     glm::vec3 lightPos;
 
     float shadowBias;
-    float enablePCF;
+    uint32_t cascadeCount;
+    uint32_t pcfKernelSize;
+    float pcfRadius;
 };
 
-struct PerObjectData {
-    glm::mat4 model;
+// Tap layouts of the PCF kernel, see shadow.hlsl
+enum PcfPattern : uint32_t {
+    PCF_GRID = 0,
+    PCF_POISSON = 1,
+};
+
+// constant_id of the feature toggles in shadow.hlsl
+constexpr uint32_t SPEC_ENABLE_PCF = 0;
+constexpr uint32_t SPEC_PCF_PATTERN = 1;
+
+// Bits of the scene pipeline permutation
+enum ScenePermutation : uint32_t {
+    SCENE_PCF = 1 << 0,
+    SCENE_PCF_POISSON = 1 << 1,
 };
 
 class ShadowPassRenderer : public Renderer {
@@ -73,31 +129,79 @@ class ShadowPassRenderer : public Renderer {
     Texture shadowTexture;
     Texture depthTexture;
 
+    // Static casters only, copied into the shadow map every frame before
+    // the dynamic casters are drawn on top. A cascade is only redrawn when
+    // its projection or the static casters change.
+    Texture staticShadowTexture;
+    std::array<vk::ImageView, MAX_SHADOW_CASCADES> staticCascadeViews;
+    std::array<glm::mat4, MAX_SHADOW_CASCADES> cachedCascadeViewProj;
+    std::array<bool, MAX_SHADOW_CASCADES> staticCascadeStale{};
+    bool staticCastersChanged = true;
+    bool cacheStaticShadows = true;
+    int redrawnStaticCascades = 0;
+
     vk::PipelineLayout shadowPipelineLayout;
     vk::Pipeline shadowPipeline;
 
     vk::PipelineLayout finalImagePipelineLayout;
-    vk::Pipeline finalImagePipeline;
+    PipelinePermutations scenePipelines;
+    // The permutation of this frame, resolved in onUpdate() so a new one is
+    // never compiled while the graph records
+    vk::Pipeline scenePipeline;
 
     vk::DescriptorSetLayout shadowDescriptorSetLayout;
     vk::DescriptorSet shadowDescriptorSet;
 
-    vk::Extent2D shadowMapExtent = {4096, 4096};
+    // Per cascade, four of them hold as many texels as one 4096 map
+    vk::Extent2D shadowMapExtent = {2048, 2048};
+    std::array<vk::ImageView, MAX_SHADOW_CASCADES> cascadeViews;
+    int cascadeCount = MAX_SHADOW_CASCADES;
+    float shadowDistance = 20.0f;
+    float splitLambda = 0.75f;
 
     Model cube;
     Model plane;
+    VertexLayout vertexLayout = VertexLayout::eFull;
 
     UBO ubo;
-    PerObjectData perObjectData;
+    // Of this frame's copy in the uniform ring
+    uint32_t uboOffset = 0;
 
-    float shadowBound = 2.0f;
     float rotation = 30.0f;
     float distance = 2.0f;
 
-    VkDescriptorSet shadowSetForImGui;
+    // Makes the cube a dynamic caster
+    bool spinCube = false;
+    glm::mat4 cubeTransform;
+
+    std::array<VkDescriptorSet, MAX_SHADOW_CASCADES> cascadeSetsForImGui;
+    int shownCascade = 0;
 
     float shadowBias = 0.000061035f;
     bool enablePCF = true;
+    int pcfPattern = PCF_POISSON;
+    int pcfKernelSize = 2;
+    float pcfRadius = 1.5f;
+
+    // The shadow map sampler compares, ImGui needs the depth values
+    vk::Sampler shadowPreviewSampler;
+
+    bool gpuCulling = true;
+    bool occlusionCulling = true;
+
+    int cubeGridSize = 0;
+    int builtCubeGridSize = 0;
+
+    // The per instance stream follows the vertex streams of each pipeline
+    uint32_t shadowInstanceBinding;
+    uint32_t sceneInstanceBinding;
+
+    // The pyramid holds last frame's depth, seen through this matrix
+    bool depthPyramidValid = false;
+    glm::mat4 depthPyramidViewProj;
+
+    // Handle in this frame's render graph, for the UI pass
+    RenderGraphHandle shadowMap;
 
     struct {
         glm::vec3 pos;
@@ -105,28 +209,49 @@ class ShadowPassRenderer : public Renderer {
     } light;
 
     void onDestroy() override {
-        sceneData.uniformBuffer.destroy();
-        sceneData.vertexBuffer.destroy();
-        sceneData.indexBuffer.destroy();
+        sceneData.geometryPool.destroy();
+        sceneData.culler.destroy();
+        sceneData.depthPyramid.destroy();
+        for (auto &shadowDraws : sceneData.shadowDraws) {
+            shadowDraws.destroy();
+        }
+        for (auto &shadowDraws : sceneData.staticShadowDraws) {
+            shadowDraws.destroy();
+        }
+        sceneData.sceneDraws.destroy();
+        sceneData.instances.destroy();
 
+        auto logicalDevice = device->getLogicalDevice();
+        for (auto view : cascadeViews) {
+            logicalDevice.destroyImageView(view);
+        }
+        for (auto view : staticCascadeViews) {
+            logicalDevice.destroyImageView(view);
+        }
+        logicalDevice.destroySampler(shadowPreviewSampler);
         shadowTexture.destroy();
+        staticShadowTexture.destroy();
         depthTexture.destroy();
 
-        auto logicalDevice = device->getLogicalDevice();
-        logicalDevice.destroyDescriptorSetLayout(sceneData.descriptorSetLayout);
-
-        logicalDevice.destroyPipelineLayout(shadowPipelineLayout);
+        // The layouts belong to the device's layout cache
         logicalDevice.destroyPipeline(shadowPipeline);
-        logicalDevice.destroyPipelineLayout(finalImagePipelineLayout);
-        logicalDevice.destroyPipeline(finalImagePipeline);
-        logicalDevice.destroyDescriptorSetLayout(shadowDescriptorSetLayout);
+        for (auto pipeline : scenePipelines.release()) {
+            logicalDevice.destroyPipeline(pipeline);
+        }
     }
 
     void onSceneResize() override {
+        renderGraph.forget(depthTexture.image);
+        renderGraph.forget(sceneData.depthPyramid.getImage());
         depthTexture.destroy();
         depthTexture.allocate(getFinalExtent(), 1, vk::Format::eD32Sfloat,
-                              vk::ImageUsageFlagBits::eDepthStencilAttachment,
+                              vk::ImageUsageFlagBits::eDepthStencilAttachment |
+                                  vk::ImageUsageFlagBits::eSampled,
                               vk::ImageAspectFlagBits::eDepth);
+
+        sceneData.depthPyramid.resize(depthTexture, getFinalExtent());
+        sceneData.culler.setDepthPyramid(sceneData.depthPyramid);
+        depthPyramidValid = false;
     }
 
     void onPrepare() override {
@@ -134,53 +259,48 @@ class ShadowPassRenderer : public Renderer {
 
         depthTexture = device->createTexture();
         depthTexture.allocate(getFinalExtent(), 1, vk::Format::eD32Sfloat,
-                              vk::ImageUsageFlagBits::eDepthStencilAttachment,
+                              vk::ImageUsageFlagBits::eDepthStencilAttachment |
+                                  vk::ImageUsageFlagBits::eSampled,
                               vk::ImageAspectFlagBits::eDepth);
 
-        sceneData.vertexBuffer = device->createBuffer();
-        sceneData.indexBuffer = device->createBuffer();
-        sceneData.uniformBuffer = device->createBuffer();
-
-        sceneData.vertexBuffer.allocate(
-            100000, vk::BufferUsageFlagBits::eVertexBuffer |
-                        vk::BufferUsageFlagBits::eTransferDst);
-        sceneData.indexBuffer.allocate(1000000,
-                                       vk::BufferUsageFlagBits::eIndexBuffer);
-        sceneData.uniformBuffer.allocate(
-            sizeof(UBO), vk::BufferUsageFlagBits::eUniformBuffer, true);
-
-        vk::DescriptorSetLayoutBinding descriptorSetLayoutBinding{
-            .binding = 0,
-            .descriptorType = vk::DescriptorType::eUniformBuffer,
-            .descriptorCount = 1,
-            .stageFlags = vk::ShaderStageFlagBits::eVertex |
-                          vk::ShaderStageFlagBits::eFragment,
-        };
+        sceneData.geometryPool.init(device, 1 << 16, 1 << 20, vertexLayout,
+                                    VertexStreams::eSplitPosition);
 
-        auto logicalDevice = device->getLogicalDevice();
-        sceneData.descriptorSetLayout = logicalDevice.createDescriptorSetLayout(
-            {.bindingCount = 1, .pBindings = &descriptorSetLayoutBinding});
+        sceneData.culler.init(device, MAX_SCENE_OBJECTS,
+                              FIRST_STATIC_CASCADE_VIEW + MAX_SHADOW_CASCADES);
+        sceneData.depthPyramid.init(device);
+        sceneData.depthPyramid.resize(depthTexture, getFinalExtent());
+        sceneData.culler.setDepthPyramid(sceneData.depthPyramid);
+        gpuCulling = sceneData.culler.isSupported();
 
-        sceneData.descriptorSet =
-            logicalDevice
-                .allocateDescriptorSets(
-                    {.descriptorPool = device->getDescriptorPool(),
-                     .descriptorSetCount = 1,
-                     .pSetLayouts = &sceneData.descriptorSetLayout})
-                .front();
+        for (auto &shadowDraws : sceneData.shadowDraws) {
+            shadowDraws.init(device, MAX_SCENE_OBJECTS);
+        }
+        for (auto &shadowDraws : sceneData.staticShadowDraws) {
+            shadowDraws.init(device, MAX_SCENE_OBJECTS);
+        }
+        sceneData.sceneDraws.init(device, MAX_SCENE_OBJECTS);
+        // Every object can be drawn by the camera and, as either kind of
+        // caster, once per cascade
+        sceneData.instances.init(device,
+                                 MAX_SCENE_OBJECTS * (1 + MAX_SHADOW_CASCADES));
 
-        shadowTexture = device->createTexture();
+        // Also derives the set layouts from the shaders
+        buildPipeline();
 
-        vk::DescriptorSetLayoutBinding shadowDescriptorSetLayoutBinding{
-            .binding = 0,
-            .descriptorType = vk::DescriptorType::eCombinedImageSampler,
-            .descriptorCount = 1,
-            .stageFlags = vk::ShaderStageFlagBits::eFragment,
-        };
+        auto logicalDevice = device->getLogicalDevice();
+
+        std::array<vk::DescriptorSetLayout, MAX_FRAMES_IN_FLIGHT>
+            sceneSetLayouts;
+        sceneSetLayouts.fill(sceneData.descriptorSetLayout);
+        auto sceneSets = logicalDevice.allocateDescriptorSets(
+            {.descriptorPool = device->getDescriptorPool(),
+             .descriptorSetCount = MAX_FRAMES_IN_FLIGHT,
+             .pSetLayouts = sceneSetLayouts.data()});
+        std::copy(sceneSets.begin(), sceneSets.end(),
+                  sceneData.descriptorSets.begin());
 
-        shadowDescriptorSetLayout = logicalDevice.createDescriptorSetLayout(
-            {.bindingCount = 1,
-             .pBindings = &shadowDescriptorSetLayoutBinding});
+        shadowTexture = device->createTexture();
 
         shadowDescriptorSet =
             logicalDevice
@@ -190,29 +310,66 @@ class ShadowPassRenderer : public Renderer {
                      .pSetLayouts = &shadowDescriptorSetLayout})
                 .front();
 
+        shadowTexture.arrayLayers = MAX_SHADOW_CASCADES;
         shadowTexture.allocate(shadowMapExtent, 1, vk::Format::eD32Sfloat,
                                vk::ImageUsageFlagBits::eDepthStencilAttachment |
-                                   vk::ImageUsageFlagBits::eSampled,
+                                   vk::ImageUsageFlagBits::eSampled |
+                                   vk::ImageUsageFlagBits::eTransferDst,
                                vk::ImageAspectFlagBits::eDepth);
         shadowTexture.addressMode = vk::SamplerAddressMode::eClampToBorder;
+        shadowTexture.compareEnable = true;
         shadowTexture.createSampler();
+        shadowPreviewSampler = logicalDevice.createSampler({
+            .magFilter = vk::Filter::eLinear,
+            .minFilter = vk::Filter::eLinear,
+            .mipmapMode = vk::SamplerMipmapMode::eNearest,
+            .addressModeU = vk::SamplerAddressMode::eClampToEdge,
+            .addressModeV = vk::SamplerAddressMode::eClampToEdge,
+            .addressModeW = vk::SamplerAddressMode::eClampToEdge,
+            .maxLod = VK_LOD_CLAMP_NONE,
+        });
+        createCascadeViews(shadowTexture, cascadeViews);
+
+        staticShadowTexture = device->createTexture();
+        staticShadowTexture.arrayLayers = MAX_SHADOW_CASCADES;
+        staticShadowTexture.allocate(
+            shadowMapExtent, 1, vk::Format::eD32Sfloat,
+            vk::ImageUsageFlagBits::eDepthStencilAttachment |
+                vk::ImageUsageFlagBits::eTransferSrc,
+            vk::ImageAspectFlagBits::eDepth);
+        createCascadeViews(staticShadowTexture, staticCascadeViews);
+
+        auto bufferInfo = uniformRing.getDescriptorInfo(sizeof(UBO));
+
+        for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            vk::DescriptorBufferInfo objectBufferInfo{
+                .buffer = sceneData.culler.getObjectBuffer(i),
+                .offset = 0,
+                .range = vk::WholeSize,
+            };
+
+            std::array<vk::WriteDescriptorSet, 2> sceneSetWrites = {{
+                {
+                    .dstSet = sceneData.descriptorSets[i],
+                    .dstBinding = 0,
+                    .dstArrayElement = 0,
+                    .descriptorCount = 1,
+                    .descriptorType =
+                        vk::DescriptorType::eUniformBufferDynamic,
+                    .pBufferInfo = &bufferInfo,
+                },
+                {
+                    .dstSet = sceneData.descriptorSets[i],
+                    .dstBinding = 1,
+                    .dstArrayElement = 0,
+                    .descriptorCount = 1,
+                    .descriptorType = vk::DescriptorType::eStorageBuffer,
+                    .pBufferInfo = &objectBufferInfo,
+                },
+            }};
 
-        vk::DescriptorBufferInfo bufferInfo{
-            .buffer = sceneData.uniformBuffer.buffer,
-            .offset = 0,
-            .range = sizeof(UBO),
-        };
-
-        vk::WriteDescriptorSet uboWrite{
-            .dstSet = sceneData.descriptorSet,
-            .dstBinding = 0,
-            .dstArrayElement = 0,
-            .descriptorCount = 1,
-            .descriptorType = vk::DescriptorType::eUniformBuffer,
-            .pBufferInfo = &bufferInfo,
-        };
-
-        logicalDevice.updateDescriptorSets(uboWrite, {});
+            logicalDevice.updateDescriptorSets(sceneSetWrites, {});
+        }
 
         vk::DescriptorImageInfo imageInfo{
             .sampler = shadowTexture.sampler,
@@ -236,71 +393,312 @@ class ShadowPassRenderer : public Renderer {
         plane.id = 2;
         plane.createPlane();
 
-        buildPipeline();
-
         AddModel(cube);
         AddModel(plane);
 
         auto &cubeInfo = sceneData.getModelInfoById(cube.id);
         auto &planeInfo = sceneData.getModelInfoById(plane.id);
 
-        cubeInfo.model = glm::translate(
+        cubeTransform = glm::translate(
             glm::scale(cubeInfo.model, glm::vec3(0.5f, 0.5f, 0.5f)),
             glm::vec3(0.0f, 0.0f, 0.8f));
+        cubeInfo.model = cubeTransform;
         planeInfo.model =
             glm::scale(planeInfo.model, glm::vec3(100.0, 100.0, 0.0));
-        perObjectData.model = glm::mat4(1.0f);
+        planeInfo.castsShadow = false;
         light.pos.z = 20.0f;
 
-        shadowSetForImGui = ImGui_ImplVulkan_AddTexture(
-            shadowTexture.sampler, shadowTexture.imageView,
-            VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL);
+        for (uint32_t i = 0; i < MAX_SHADOW_CASCADES; i++) {
+            cascadeSetsForImGui[i] = ImGui_ImplVulkan_AddTexture(
+                shadowPreviewSampler, cascadeViews[i],
+                VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL);
+        }
+    }
+
+    // The shadow passes render each cascade through a view of its layer of
+    // a D32 array
+    void createCascadeViews(
+        const Texture &texture,
+        std::array<vk::ImageView, MAX_SHADOW_CASCADES> &views) {
+        for (uint32_t i = 0; i < MAX_SHADOW_CASCADES; i++) {
+            views[i] = device->getLogicalDevice().createImageView({
+                .image = texture.image,
+                .viewType = vk::ImageViewType::e2D,
+                .format = vk::Format::eD32Sfloat,
+                .subresourceRange =
+                    {
+                        .aspectMask = vk::ImageAspectFlagBits::eDepth,
+                        .baseMipLevel = 0,
+                        .levelCount = 1,
+                        .baseArrayLayer = i,
+                        .layerCount = 1,
+                    },
+            });
+        }
     }
 
     void onUpdate() override {
+        scenePipeline = scenePipelines.get(getScenePermutation());
+
+        if (cubeGridSize != builtCubeGridSize) {
+            buildCubeGrid();
+        }
+        if (spinCube) {
+            static auto startTime = std::chrono::high_resolution_clock::now();
+            float seconds = std::chrono::duration<float>(
+                                std::chrono::high_resolution_clock::now() -
+                                startTime)
+                                .count();
+            sceneData.getModelInfoById(cube.id).model = glm::rotate(
+                cubeTransform, seconds, glm::vec3(0.0f, 0.0f, 1.0f));
+        }
+
         ubo.view = glm::lookAt(glm::vec3(distance), glm::vec3(0.0f, 0.0f, 0.5f),
                                glm::vec3(0.0f, 0.0f, 1.0f));
         ubo.proj = glm::perspective(
-            glm::radians(45.0f),
-            getFinalExtent().width / (float)getFinalExtent().height, 0.1f,
-            1000.0f);
+            CAMERA_FOV_Y,
+            getFinalExtent().width / (float)getFinalExtent().height,
+            CAMERA_NEAR, CAMERA_FAR);
         ubo.proj[1][1] *= -1;
 
-        ubo.lightView = glm::lookAt(light.pos, glm::vec3(0.0f),
-                                    glm::vec3(0.0f, 0.0f, 1.0f));
-        ubo.lightProj = glm::ortho(-shadowBound, shadowBound, -shadowBound,
-                                   shadowBound, 0.1f, 100.0f);
-        ubo.lightProj[1][1] *= -1;
-
         float angle = glm::radians(rotation);
         float x = light.radius * cos(angle);
         float y = light.radius * sin(angle);
         light.pos.x = x;
         light.pos.y = y;
         ubo.lightPos = light.pos;
+        updateCascades();
+        updateShadowCache();
         ubo.shadowBias = shadowBias;
-        ubo.enablePCF = (enablePCF) ? 1.0f : 0.0f;
+        ubo.pcfKernelSize = pcfKernelSize;
+        ubo.pcfRadius = pcfRadius;
+
+        uboOffset = uniformRing.push(ubo);
+    }
+
+    // The light shines at the origin, cascades only cover the first
+    // shadowDistance of the view
+    void updateCascades() {
+        auto extent = getFinalExtent();
+        CascadeCamera camera{
+            .view = ubo.view,
+            .fovY = CAMERA_FOV_Y,
+            .aspect = extent.width / (float)extent.height,
+        };
+        auto splits = computeCascadeSplits(cascadeCount, CAMERA_NEAR,
+                                           shadowDistance, splitLambda);
+
+        ubo.cascadeCount = cascadeCount;
+        for (int i = 0; i < cascadeCount; i++) {
+            float splitNear = i == 0 ? CAMERA_NEAR : splits[i - 1];
+            ubo.cascadeViewProj[i] = fitShadowCascade(
+                camera, splitNear, splits[i], -light.pos,
+                shadowMapExtent.width, SHADOW_CASTER_DISTANCE);
+            ubo.cascadeSplits[i] = splits[i];
+        }
+    }
+
+    // A cached cascade is redrawn when its projection moved or the static
+    // casters changed, the projection only holds still while the camera
+    // and the light do
+    void updateShadowCache() {
+        if (staticCastersChanged || !cacheStaticShadows) {
+            cachedCascadeViewProj.fill(glm::mat4(0.0f));
+            staticCastersChanged = false;
+        }
+        redrawnStaticCascades = 0;
+        for (uint32_t i = 0; i < MAX_SHADOW_CASCADES; i++) {
+            bool active = i < static_cast<uint32_t>(cascadeCount);
+            staticCascadeStale[i] =
+                active && ubo.cascadeViewProj[i] != cachedCascadeViewProj[i];
+            if (staticCascadeStale[i]) {
+                cachedCascadeViewProj[i] = ubo.cascadeViewProj[i];
+                redrawnStaticCascades++;
+            }
+        }
+    }
+
+    bool anyStaticCascadeStale() const {
+        return redrawnStaticCascades > 0;
+    }
+
+    void setupRenderGraph(RenderGraph &graph,
+                          RenderGraphHandle finalColor) override {
+        bool useGpuCulling = gpuCulling && sceneData.culler.isSupported();
+        bool useOcclusion =
+            useGpuCulling && occlusionCulling &&
+            sceneData.depthPyramid.isSupported();
+        updateObjects(useGpuCulling);
+
+        shadowMap = graph.importImage("shadow map", shadowTexture.image,
+                                      vk::ImageAspectFlagBits::eDepth);
+        auto staticShadowMap =
+            graph.importImage("static shadow map", staticShadowTexture.image,
+                              vk::ImageAspectFlagBits::eDepth);
+        bool redrawStatic = anyStaticCascadeStale();
+        auto depth = graph.importImage("depth", depthTexture.image,
+                                       vk::ImageAspectFlagBits::eDepth);
+        auto depthPyramid = graph.importImage(
+            "depth pyramid", sceneData.depthPyramid.getImage(),
+            vk::ImageAspectFlagBits::eColor, vk::ImageLayout::eGeneral);
+
+        RenderGraphHandle drawCommands;
+        RenderGraphHandle drawCounts;
+        if (useGpuCulling) {
+            glm::mat4 viewProj = ubo.proj * ubo.view;
+            bool useDepthPyramid = useOcclusion && depthPyramidValid;
+            sceneData.culler.setView(
+                currentFrame, CAMERA_VIEW, viewProj, 0,
+                useDepthPyramid ? &depthPyramidViewProj : nullptr);
+            for (uint32_t i = 0; i < MAX_SHADOW_CASCADES; i++) {
+                bool active = i < static_cast<uint32_t>(cascadeCount);
+                sceneData.culler.setView(
+                    currentFrame, FIRST_CASCADE_VIEW + i,
+                    ubo.cascadeViewProj[i],
+                    active ? GPU_OBJECT_CASTS_SHADOW | GPU_OBJECT_DYNAMIC
+                           : NO_OBJECTS);
+                sceneData.culler.setView(
+                    currentFrame, FIRST_STATIC_CASCADE_VIEW + i,
+                    ubo.cascadeViewProj[i],
+                    staticCascadeStale[i]
+                        ? GPU_OBJECT_CASTS_SHADOW | GPU_OBJECT_STATIC
+                        : NO_OBJECTS);
+            }
 
-        std::memcpy(sceneData.uniformBuffer.allocationInfo.pMappedData, &ubo,
-                    sizeof(UBO));
+            drawCommands = graph.importBuffer(
+                "draw commands", sceneData.culler.getDrawCommandBuffer());
+            drawCounts = graph.importBuffer(
+                "draw counts", sceneData.culler.getDrawCountBuffer());
+
+            auto objectCount =
+                static_cast<uint32_t>(sceneData.modelInfos.size());
+            // The static views are only culled for a redraw
+            uint32_t viewCount =
+                redrawStatic ? FIRST_STATIC_CASCADE_VIEW + cascadeCount
+                             : FIRST_CASCADE_VIEW + cascadeCount;
+            auto cullPass = graph.addPass(
+                "cull", [this, objectCount,
+                         viewCount](vk::CommandBuffer cmdBuffer) {
+                    sceneData.culler.cull(cmdBuffer, currentFrame,
+                                          objectCount, viewCount);
+                });
+            cullPass
+                .write(drawCommands, RenderGraphUsage::eComputeStorageWrite)
+                .write(drawCounts, RenderGraphUsage::eTransferWrite)
+                .write(drawCounts, RenderGraphUsage::eComputeStorageWrite);
+            if (useDepthPyramid) {
+                cullPass.read(depthPyramid, RenderGraphUsage::eComputeSampled);
+            }
+        }
+
+        // Static casters into the cache, then the cache into the shadow map
+        // and the dynamic casters on top. Both depth passes keep the layers
+        // they do not redraw, hence the reads.
+        std::vector<RenderGraph::PassBuilder> drawPasses;
+        if (redrawStatic) {
+            auto staticPass = graph.addPass(
+                "static shadow",
+                [this, useGpuCulling](vk::CommandBuffer cmdBuffer) {
+                    recordShadowPass(cmdBuffer, true, useGpuCulling);
+                });
+            staticPass
+                .read(staticShadowMap, RenderGraphUsage::eDepthAttachment)
+                .write(staticShadowMap, RenderGraphUsage::eDepthAttachment);
+            drawPasses.push_back(staticPass);
+        }
+
+        graph
+            .addPass("shadow cache copy",
+                     [this](vk::CommandBuffer cmdBuffer) {
+                         copyStaticShadows(cmdBuffer);
+                     })
+            .read(staticShadowMap, RenderGraphUsage::eTransferRead)
+            .write(shadowMap, RenderGraphUsage::eTransferWrite);
+
+        auto shadowPass = graph.addPass(
+            "shadow", [this, useGpuCulling](vk::CommandBuffer cmdBuffer) {
+                recordShadowPass(cmdBuffer, false, useGpuCulling);
+            });
+        shadowPass.read(shadowMap, RenderGraphUsage::eDepthAttachment)
+            .write(shadowMap, RenderGraphUsage::eDepthAttachment);
+        drawPasses.push_back(shadowPass);
+
+        auto scenePass = graph.addPass(
+            "scene", [this, useGpuCulling](vk::CommandBuffer cmdBuffer) {
+                recordScenePass(cmdBuffer, useGpuCulling);
+            });
+        scenePass.read(shadowMap, RenderGraphUsage::eFragmentSampled)
+            .write(finalColor, RenderGraphUsage::eColorAttachment)
+            .write(depth, RenderGraphUsage::eDepthAttachment);
+
+        if (useGpuCulling) {
+            drawPasses.push_back(scenePass);
+            // Everything drawing from the culled commands
+            for (auto &pass : drawPasses) {
+                pass.read(drawCommands, RenderGraphUsage::eIndirectRead)
+                    .read(drawCounts, RenderGraphUsage::eIndirectRead);
+            }
+        }
+
+        // Next frame culls against this frame's depth
+        depthPyramidValid = useOcclusion;
+        if (useOcclusion) {
+            graph
+                .addPass("depth pyramid",
+                         [this](vk::CommandBuffer cmdBuffer) {
+                             sceneData.depthPyramid.build(cmdBuffer);
+                         })
+                .read(depth, RenderGraphUsage::eComputeSampled)
+                .read(depthPyramid, RenderGraphUsage::eComputeStorageRead)
+                .write(depthPyramid, RenderGraphUsage::eComputeStorageWrite);
+            graph.markOutput(depthPyramid);
+            depthPyramidViewProj = ubo.proj * ubo.view;
+        }
     }
 
-    void draw() override {
-        auto &cmdBuffer = getCurrentDrawCmdBuffer();
+    // The shadow map window samples it
+    void declareUiReads(RenderGraph::PassBuilder &pass) override {
+        pass.read(shadowMap, RenderGraphUsage::eFragmentSampled);
+    }
 
-        imageLayoutTransition(cmdBuffer, vk::ImageAspectFlagBits::eDepth,
-                              vk::PipelineStageFlagBits::eTopOfPipe,
-                              vk::PipelineStageFlagBits::eEarlyFragmentTests,
-                              vk::AccessFlagBits::eNone,
-                              vk::AccessFlagBits::eDepthStencilAttachmentWrite,
-                              vk::ImageLayout::eUndefined,
-                              vk::ImageLayout::eDepthStencilAttachmentOptimal,
-                              shadowTexture.image);
+    // Every cascade in turn, each into its own layer. The static casters
+    // only redraw the stale cascades of the cache.
+    void recordShadowPass(vk::CommandBuffer cmdBuffer, bool staticCasters,
+                          bool gpuCulled) {
+        for (int i = 0; i < cascadeCount; i++) {
+            if (!staticCasters || staticCascadeStale[i]) {
+                recordShadowCascade(cmdBuffer, i, staticCasters, gpuCulled);
+            }
+        }
+    }
+
+    void copyStaticShadows(vk::CommandBuffer cmdBuffer) {
+        vk::ImageSubresourceLayers layers{
+            .aspectMask = vk::ImageAspectFlagBits::eDepth,
+            .mipLevel = 0,
+            .baseArrayLayer = 0,
+            .layerCount = static_cast<uint32_t>(cascadeCount),
+        };
+        vk::ImageCopy region{
+            .srcSubresource = layers,
+            .dstSubresource = layers,
+            .extent = {shadowMapExtent.width, shadowMapExtent.height, 1},
+        };
+        cmdBuffer.copyImage(staticShadowTexture.image,
+                            vk::ImageLayout::eTransferSrcOptimal,
+                            shadowTexture.image,
+                            vk::ImageLayout::eTransferDstOptimal, region);
+    }
 
+    void recordShadowCascade(vk::CommandBuffer cmdBuffer, uint32_t cascade,
+                             bool staticCasters, bool gpuCulled) {
+        // The dynamic casters land on top of the copied static ones
         vk::RenderingAttachmentInfo shadowAttachmentInfo{
-            .imageView = shadowTexture.imageView,
+            .imageView = staticCasters ? staticCascadeViews[cascade]
+                                       : cascadeViews[cascade],
             .imageLayout = vk::ImageLayout::eDepthStencilAttachmentOptimal,
-            .loadOp = vk::AttachmentLoadOp::eClear,
+            .loadOp = staticCasters ? vk::AttachmentLoadOp::eClear
+                                    : vk::AttachmentLoadOp::eLoad,
             .storeOp = vk::AttachmentStoreOp::eStore,
             .clearValue = vk::ClearValue{.depthStencil =
                                              {
@@ -325,38 +723,33 @@ class ShadowPassRenderer : public Renderer {
                                shadowPipeline);
         cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
                                      shadowPipelineLayout, 0,
-                                     {sceneData.descriptorSet}, {});
-        cmdBuffer.bindVertexBuffers(0, {sceneData.vertexBuffer.buffer}, {0});
-        cmdBuffer.bindIndexBuffer(sceneData.indexBuffer.buffer, 0,
-                                  vk::IndexType::eUint16);
+                                     {sceneData.descriptorSets[currentFrame]},
+                                     {uboOffset});
+        cmdBuffer.pushConstants(shadowPipelineLayout,
+                                vk::ShaderStageFlagBits::eVertex, 0,
+                                sizeof(uint32_t), &cascade);
+        sceneData.geometryPool.bindVertexBuffers(cmdBuffer, true);
+        bindInstances(cmdBuffer, shadowInstanceBinding, gpuCulled);
 
         cmdBuffer.setViewport(0, getDefaultViewport(shadowMapExtent));
         cmdBuffer.setScissor(0, getDefaultScissor(shadowMapExtent));
 
-        for (auto &model : sceneData.modelInfos) {
-            if (model.id == plane.id) {
-                continue;
-            }
-
-            perObjectData.model = model.model;
-            cmdBuffer.pushConstants(finalImagePipelineLayout,
-                                    vk::ShaderStageFlagBits::eVertex, 0,
-                                    sizeof(PerObjectData), &perObjectData);
-            cmdBuffer.drawIndexed(model.index.count, 1, model.index.startIndex,
-                                  model.vertex.startIndex, 0);
+        if (gpuCulled) {
+            uint32_t view = (staticCasters ? FIRST_STATIC_CASCADE_VIEW
+                                           : FIRST_CASCADE_VIEW) +
+                            cascade;
+            sceneData.culler.draw(cmdBuffer, view,
+                                  sceneData.geometryPool.getIndexBuffer());
+        } else {
+            auto &draws = staticCasters ? sceneData.staticShadowDraws[cascade]
+                                        : sceneData.shadowDraws[cascade];
+            draws.record(cmdBuffer, sceneData.geometryPool.getIndexBuffer());
         }
 
         cmdBuffer.endRendering();
+    }
 
-        imageLayoutTransition(cmdBuffer, vk::ImageAspectFlagBits::eDepth,
-                              vk::PipelineStageFlagBits::eLateFragmentTests,
-                              vk::PipelineStageFlagBits::eFragmentShader,
-                              vk::AccessFlagBits::eDepthStencilAttachmentWrite,
-                              vk::AccessFlagBits::eShaderRead,
-                              vk::ImageLayout::eDepthStencilAttachmentOptimal,
-                              vk::ImageLayout::eDepthReadOnlyOptimal,
-                              shadowTexture.image);
-
+    void recordScenePass(vk::CommandBuffer cmdBuffer, bool gpuCulled) {
         vk::RenderingAttachmentInfo colorAttachmentInfo{
             .imageView = getFinalColorTexture().imageView,
             .imageLayout = vk::ImageLayout::eColorAttachmentOptimal,
@@ -392,22 +785,26 @@ class ShadowPassRenderer : public Renderer {
 
         cmdBuffer.beginRendering(writeToSwapchain);
         cmdBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics,
-                               finalImagePipeline);
-        cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
-                                     finalImagePipelineLayout, 1,
-                                     {shadowDescriptorSet}, {});
+                               scenePipeline);
+        // Both sets, the shadow layout's push constant range makes its set 0
+        // binding incompatible with this layout
+        cmdBuffer.bindDescriptorSets(
+            vk::PipelineBindPoint::eGraphics, finalImagePipelineLayout, 0,
+            {sceneData.descriptorSets[currentFrame], shadowDescriptorSet},
+            {uboOffset});
+        sceneData.geometryPool.bindVertexBuffers(cmdBuffer);
+        bindInstances(cmdBuffer, sceneInstanceBinding, gpuCulled);
 
         auto extent = getFinalExtent();
         cmdBuffer.setViewport(0, getDefaultViewport(extent));
         cmdBuffer.setScissor(0, getDefaultScissor(extent));
 
-        for (auto &model : sceneData.modelInfos) {
-            perObjectData.model = model.model;
-            cmdBuffer.pushConstants(finalImagePipelineLayout,
-                                    vk::ShaderStageFlagBits::eVertex, 0,
-                                    sizeof(PerObjectData), &perObjectData);
-            cmdBuffer.drawIndexed(model.index.count, 1, model.index.startIndex,
-                                  model.vertex.startIndex, 0);
+        if (gpuCulled) {
+            sceneData.culler.draw(cmdBuffer, CAMERA_VIEW,
+                                  sceneData.geometryPool.getIndexBuffer());
+        } else {
+            sceneData.sceneDraws.record(
+                cmdBuffer, sceneData.geometryPool.getIndexBuffer());
         }
 
         cmdBuffer.endRendering();
@@ -416,7 +813,7 @@ class ShadowPassRenderer : public Renderer {
     void drawUi() override {
         auto fontScale = device->getUiLayout()->fontScale;
         auto boxWidth = fontScale * 12;
-        auto boxHeight = fontScale * 17;
+        auto boxHeight = fontScale * 38;
 
         ImGui::SetNextWindowSize(ImVec2(boxWidth, boxHeight), ImGuiCond_Once);
         ImGui::SetNextWindowPos(
@@ -429,10 +826,21 @@ class ShadowPassRenderer : public Renderer {
 
         ImGui::Begin("Control", nullptr, flags);
 
-        ImGui::Text("Shadow Bound");
+        ImGui::Text("Shadow Distance");
+        ImGui::SetNextItemWidth(ImGui::GetWindowWidth() -
+                                ImGui::GetStyle().WindowPadding.x * 2);
+        ImGui::SliderFloat("##ShadowDistance", &shadowDistance, 1.0f, 100.0f);
+
+        ImGui::Text("Cascades");
         ImGui::SetNextItemWidth(ImGui::GetWindowWidth() -
                                 ImGui::GetStyle().WindowPadding.x * 2);
-        ImGui::SliderFloat("##ShadowBound", &shadowBound, 0.1f, 10.0f);
+        ImGui::SliderInt("##Cascades", &cascadeCount, 1, MAX_SHADOW_CASCADES);
+        shownCascade = std::min(shownCascade, cascadeCount - 1);
+
+        ImGui::Text("Split Lambda");
+        ImGui::SetNextItemWidth(ImGui::GetWindowWidth() -
+                                ImGui::GetStyle().WindowPadding.x * 2);
+        ImGui::SliderFloat("##SplitLambda", &splitLambda, 0.0f, 1.0f);
 
         ImGui::Text("# divide for bias");
         ImGui::SetNextItemWidth(ImGui::GetWindowWidth() -
@@ -463,6 +871,45 @@ class ShadowPassRenderer : public Renderer {
         ImGui::SliderFloat("##pz", &light.pos.z, 3.0f, 100.0f);
 
         ImGui::Checkbox("Enable PCF", &enablePCF);
+        ImGui::BeginDisabled(!enablePCF);
+        ImGui::SetNextItemWidth(ImGui::GetWindowWidth() -
+                                ImGui::GetStyle().WindowPadding.x * 2);
+        ImGui::Combo("##PcfPattern", &pcfPattern, "Grid\0Rotated Poisson\0");
+        // Kernel n takes n * n taps, each filtering 2x2 texels in hardware
+        ImGui::SetNextItemWidth(ImGui::GetWindowWidth() -
+                                ImGui::GetStyle().WindowPadding.x * 2);
+        ImGui::SliderInt("##PcfKernel", &pcfKernelSize, 1, 4, "Kernel %d");
+        ImGui::SetNextItemWidth(ImGui::GetWindowWidth() -
+                                ImGui::GetStyle().WindowPadding.x * 2);
+        ImGui::SliderFloat("##PcfRadius", &pcfRadius, 0.5f, 4.0f,
+                           "Radius %.1f texels");
+        ImGui::EndDisabled();
+
+        ImGui::Text("Cube Grid");
+        ImGui::SetNextItemWidth(ImGui::GetWindowWidth() -
+                                ImGui::GetStyle().WindowPadding.x * 2);
+        ImGui::SliderInt("##CubeGrid", &cubeGridSize, 0, MAX_CUBE_GRID_SIZE);
+
+        if (ImGui::Checkbox("Spin Cube", &spinCube)) {
+            sceneData.getModelInfoById(cube.id).isStatic = !spinCube;
+            staticCastersChanged = true;
+        }
+        ImGui::Checkbox("Cache Static Shadows", &cacheStaticShadows);
+        ImGui::Text("%d static cascades redrawn", redrawnStaticCascades);
+
+        ImGui::BeginDisabled(!sceneData.culler.isSupported());
+        ImGui::Checkbox("GPU Culling", &gpuCulling);
+        ImGui::EndDisabled();
+        ImGui::BeginDisabled(!gpuCulling ||
+                             !sceneData.depthPyramid.isSupported());
+        ImGui::Checkbox("Occlusion Culling", &occlusionCulling);
+        ImGui::EndDisabled();
+        if (!gpuCulling) {
+            ImGui::Text("CPU culling (%s)",
+                        sceneData.frustumCuller.getSimdName());
+        }
+        ImGui::Text("%u passes, %u barriers", renderGraph.getPassCount(),
+                    renderGraph.getBarrierCount());
         ImGui::End();
 
         float texturePrintSize = 240.0f;
@@ -471,149 +918,307 @@ class ShadowPassRenderer : public Renderer {
                                        fontScale * 4),
                                 ImGuiCond_Once);
         ImGui::Begin("Shadow Map", nullptr, ImGuiWindowFlags_AlwaysAutoResize);
-        ImGui::Image((ImTextureID)shadowSetForImGui,
+        ImGui::SetNextItemWidth(texturePrintSize);
+        ImGui::SliderInt("##ShownCascade", &shownCascade, 0, cascadeCount - 1,
+                         "Cascade %d");
+        ImGui::Image((ImTextureID)cascadeSetsForImGui[shownCascade],
                      ImVec2(texturePrintSize, texturePrintSize));
         ImGui::End();
     }
 
+    // The layouts are reflected from the shaders. Editing a shader
+    // rebuilds its pipeline, the layouts have to stay.
     void buildPipeline() {
-        auto pushConstantRange = vk::PushConstantRange{
-            .stageFlags = vk::ShaderStageFlagBits::eVertex,
-            .offset = 0,
-            .size = sizeof(PerObjectData),
-        };
+        scenePipelines.init(
+            [this](uint32_t mask) { return buildScenePipeline(mask); });
+        // The other permutations are built once the UI picks them
+        scenePipelines.get(getScenePermutation());
+        shadowPipeline = buildShadowPipeline();
+
+        shaderReloader.watch({"test/shadow_gen.vert.spv"}, [this] {
+            auto pipeline = buildShadowPipeline();
+            shaderReloader.retire(shadowPipeline);
+            shadowPipeline = pipeline;
+        });
+        shaderReloader.watch({"test/shadow.vert.spv", "test/shadow.frag.spv"},
+                             [this] {
+                                 for (auto pipeline : scenePipelines.rebuild(
+                                          getScenePermutation())) {
+                                     shaderReloader.retire(pipeline);
+                                 }
+                             });
+    }
 
+    vk::Pipeline buildShadowPipeline() {
         auto logicalDevice = device->getLogicalDevice();
         PipelineBuilder shadowPassBuilder(logicalDevice);
 
-        auto shadowVertShader =
-            device->createShaderModule("test/shadow_gen.vert.spv");
+        // Unique, a rejected reload throws before the pipeline is built
+        ShaderReflection vertStage;
+        vk::UniqueShaderModule shadowVertShader(
+            device->createShaderModule("test/shadow_gen.vert.spv", &vertStage),
+            logicalDevice);
 
-        auto vertexAttribute = Vertex::getAttributeDescriptions();
-        auto vertexDescription = Vertex::getBindingDescription();
-        shadowPassBuilder.vertexInputCI.vertexAttributeDescriptionCount =
-            static_cast<uint32_t>(vertexAttribute.size());
-        shadowPassBuilder.vertexInputCI.pVertexAttributeDescriptions =
-            vertexAttribute.data();
-        shadowPassBuilder.vertexInputCI.vertexBindingDescriptionCount = 1;
-        shadowPassBuilder.vertexInputCI.pVertexBindingDescriptions =
-            &vertexDescription;
+        shadowInstanceBinding =
+            setInstancedVertexInput(shadowPassBuilder, vertStage, true);
 
         shadowPassBuilder.depthAttachmentFormat = vk::Format::eD32Sfloat;
 
         shadowPassBuilder.shaderStages.push_back({
             .stage = vk::ShaderStageFlagBits::eVertex,
-            .module = shadowVertShader,
+            .module = *shadowVertShader,
             .pName = "vert",
         });
 
-        shadowPipelineLayout = logicalDevice.createPipelineLayout({
-            .setLayoutCount = 1,
-            .pSetLayouts = &sceneData.descriptorSetLayout,
-            .pushConstantRangeCount = 1,
-            .pPushConstantRanges = &pushConstantRange,
-        });
-
+        // Binds the scene's descriptor sets as well
+        const auto &layout =
+            usePipelineLayout(shadowPipelineLayout, std::span(&vertStage, 1));
+        if (layout.setLayouts.at(0) != sceneData.descriptorSetLayout) {
+            throw std::runtime_error("shadow_gen and shadow disagree on set 0");
+        }
         shadowPassBuilder.setLayout(shadowPipelineLayout);
-        shadowPipeline = shadowPassBuilder.build();
-        logicalDevice.destroyShaderModule(shadowVertShader);
+        return shadowPassBuilder.build();
+    }
 
+    // The pattern only matters with PCF, it does not split the unfiltered
+    // permutation
+    uint32_t getScenePermutation() const {
+        uint32_t mask = 0;
+        if (enablePCF) {
+            mask |= SCENE_PCF;
+            if (pcfPattern == PCF_POISSON) {
+                mask |= SCENE_PCF_POISSON;
+            }
+        }
+        return mask;
+    }
+
+    vk::Pipeline buildScenePipeline(uint32_t permutation) {
+        auto logicalDevice = device->getLogicalDevice();
         PipelineBuilder finalImageBuilder(logicalDevice);
-        auto finalImageVertShader =
-            device->createShaderModule("test/shadow.vert.spv");
-        auto finalImageFragShader =
-            device->createShaderModule("test/shadow.frag.spv");
-
-        finalImageBuilder.vertexInputCI.vertexAttributeDescriptionCount =
-            static_cast<uint32_t>(vertexAttribute.size());
-        finalImageBuilder.vertexInputCI.pVertexAttributeDescriptions =
-            vertexAttribute.data();
-        finalImageBuilder.vertexInputCI.vertexBindingDescriptionCount = 1;
-        finalImageBuilder.vertexInputCI.pVertexBindingDescriptions =
-            &vertexDescription;
+        std::array<ShaderReflection, 2> stages;
+        vk::UniqueShaderModule finalImageVertShader(
+            device->createShaderModule("test/shadow.vert.spv", &stages[0]),
+            logicalDevice);
+        vk::UniqueShaderModule finalImageFragShader(
+            device->createShaderModule("test/shadow.frag.spv", &stages[1]),
+            logicalDevice);
+
+        sceneInstanceBinding =
+            setInstancedVertexInput(finalImageBuilder, stages[0], false);
 
         finalImageBuilder.shaderStages.push_back({
             .stage = vk::ShaderStageFlagBits::eVertex,
-            .module = finalImageVertShader,
+            .module = *finalImageVertShader,
             .pName = "vert",
         });
 
         finalImageBuilder.shaderStages.push_back({
             .stage = vk::ShaderStageFlagBits::eFragment,
-            .module = finalImageFragShader,
+            .module = *finalImageFragShader,
             .pName = "frag",
         });
 
+        finalImageBuilder.setSpecialization(vk::ShaderStageFlagBits::eFragment,
+                                            SPEC_ENABLE_PCF,
+                                            (permutation & SCENE_PCF) != 0);
+        finalImageBuilder.setSpecialization(
+            vk::ShaderStageFlagBits::eFragment, SPEC_PCF_PATTERN,
+            static_cast<uint32_t>(permutation & SCENE_PCF_POISSON
+                                      ? PCF_POISSON
+                                      : PCF_GRID));
+
         finalImageBuilder.addColorAttachment(swapchain->format);
         finalImageBuilder.depthAttachmentFormat = vk::Format::eD32Sfloat;
 
-        vk::DescriptorSetLayout descriptorSetLayouts[2] = {
-            sceneData.descriptorSetLayout, shadowDescriptorSetLayout};
-        finalImagePipelineLayout = logicalDevice.createPipelineLayout({
-            .setLayoutCount = 2,
-            .pSetLayouts = descriptorSetLayouts,
-            .pushConstantRangeCount = 1,
-            .pPushConstantRanges = &pushConstantRange,
-        });
-
+        const auto &layout =
+            usePipelineLayout(finalImagePipelineLayout, stages);
+        sceneData.descriptorSetLayout = layout.setLayouts.at(0);
+        shadowDescriptorSetLayout = layout.setLayouts.at(1);
         finalImageBuilder.setLayout(finalImagePipelineLayout);
-        finalImagePipeline = finalImageBuilder.build();
+        return finalImageBuilder.build();
+    }
 
-        logicalDevice.destroyShaderModule(finalImageVertShader);
-        logicalDevice.destroyShaderModule(finalImageFragShader);
+    // The layout reflected from the stages, the UBO is bound with the
+    // frame's offset into the uniform ring. A rebuilt pipeline has to keep
+    // it, the descriptor sets were allocated for it.
+    const PipelineLayoutInfo &usePipelineLayout(
+        vk::PipelineLayout &current, std::span<ShaderReflection> stages) {
+        for (auto &stage : stages) {
+            stage.makeDynamic(0, 0);
+        }
+        const auto &layout = device->getLayoutCache().getLayout(stages);
+        if (current && layout.pipelineLayout != current) {
+            throw std::runtime_error(
+                "shader interface changed, restart to pick it up");
+        }
+        current = layout.pipelineLayout;
+        return layout;
     }
 
-    void AddModel(Model &model) {
-        uint32_t vbSize = model.getTotalVerticesSize();
-        uint32_t ibSize = model.getTotalIndicesSize();
-
-        auto stagingBuffer = device->createBuffer();
-        stagingBuffer.allocate(vbSize, vk::BufferUsageFlagBits::eTransferSrc,
-                               true);
-        std::memcpy(stagingBuffer.allocationInfo.pMappedData,
-                    model.mesh.vertices.data(), vbSize);
-
-        auto cmdBuffer = device->allocateCommandBuffer();
-        uint32_t vDstOffset = 0;
-
-        if (!sceneData.modelInfos.empty()) {
-            auto &vTail = sceneData.modelInfos.back().vertex;
-            vDstOffset = vTail.startIndex + vTail.count;
-        }
-        cmdBuffer.copyBuffer(
-            stagingBuffer.buffer, sceneData.vertexBuffer.buffer,
-            vk::BufferCopy{0, vDstOffset * sizeof(Vertex), vbSize});
-        device->flushCommandBuffer(cmdBuffer);
-
-        ModelInfo modelInfo{
-            .id = model.id,
-            .model = glm::mat4(1.0f),
-        };
+    // Split vertex streams plus the per instance object index, returns the
+    // binding of the latter. Only the locations the shader reads are kept.
+    uint32_t setInstancedVertexInput(PipelineBuilder &builder,
+                                     const ShaderReflection &vertStage,
+                                     bool positionOnly) {
+        auto bindings = Vertex::getBindingDescriptions(
+            vertexLayout, VertexStreams::eSplitPosition, positionOnly);
+        auto attributes = Vertex::getAttributeDescriptions(
+            vertexLayout, VertexStreams::eSplitPosition, positionOnly);
+
+        auto instanceBinding = static_cast<uint32_t>(bindings.size());
+        bindings.push_back(
+            Vertex::getInstanceBindingDescription(instanceBinding));
+        attributes.push_back(
+            Vertex::getInstanceAttributeDescription(instanceBinding));
+        builder.setVertexInput(bindings,
+                               vertStage.selectVertexAttributes(attributes));
+
+        return instanceBinding;
+    }
+
+    void bindInstances(vk::CommandBuffer cmdBuffer, uint32_t binding,
+                       bool gpuCulled) {
+        if (gpuCulled) {
+            cmdBuffer.bindVertexBuffers(
+                binding, {sceneData.culler.getInstanceBuffer()}, {0});
+        } else {
+            sceneData.instances.bind(cmdBuffer, binding);
+        }
+    }
 
-        modelInfo.vertex.count =
-            static_cast<uint32_t>(model.mesh.vertices.size());
-        modelInfo.vertex.startIndex = vDstOffset;
+    // Objects live at their index in the object buffer. Without GPU culling
+    // they are frustum culled here and the visible ones are grouped into one
+    // instanced command per geometry.
+    void updateObjects(bool gpuCulled) {
+        auto objects = sceneData.culler.getObjects(currentFrame);
+        auto objectCount = static_cast<uint32_t>(sceneData.modelInfos.size());
+        auto &frustumCuller = sceneData.frustumCuller;
+        if (!gpuCulled) {
+            frustumCuller.resize(objectCount);
+        }
+
+        for (uint32_t i = 0; i < objectCount; i++) {
+            const auto &model = sceneData.modelInfos[i];
+            const auto &geometry = sceneData.geometryPool.get(model.geometry);
+
+            objects[i] = {
+                .model = model.model,
+                .boundingSphere = geometry.boundingSphere,
+                .indexCount = geometry.indexCount,
+                .firstIndex = geometry.firstIndex,
+                .vertexOffset = geometry.vertexOffset,
+                .flags = (geometry.indexType == vk::IndexType::eUint32
+                              ? GPU_OBJECT_INDEX32
+                              : 0) |
+                         (model.castsShadow ? GPU_OBJECT_CASTS_SHADOW : 0) |
+                         (model.isStatic ? GPU_OBJECT_STATIC
+                                         : GPU_OBJECT_DYNAMIC),
+            };
+
+            if (!gpuCulled) {
+                frustumCuller.setTransformedSphere(i, geometry.boundingSphere,
+                                                   model.model);
+            }
+        }
+
+        auto &instances = sceneData.instances;
+        for (auto &shadowDraws : sceneData.shadowDraws) {
+            shadowDraws.begin(currentFrame);
+        }
+        for (auto &shadowDraws : sceneData.staticShadowDraws) {
+            shadowDraws.begin(currentFrame);
+        }
+        sceneData.sceneDraws.begin(currentFrame);
+        instances.begin(currentFrame);
+        if (!gpuCulled) {
+            auto &visible = sceneData.visibleObjects;
+            frustumCuller.cull(Frustum::fromMatrix(ubo.proj * ubo.view),
+                               visible);
+            for (auto i : visible) {
+                instances.add(sceneData.modelInfos[i].geometry, i);
+            }
+            instances.flush(sceneData.geometryPool, sceneData.sceneDraws);
+
+            for (int cascade = 0; cascade < cascadeCount; cascade++) {
+                frustumCuller.cull(
+                    Frustum::fromMatrix(ubo.cascadeViewProj[cascade]),
+                    visible);
+                // One flush per kind of caster, the static ones only when
+                // their cascade is redrawn
+                for (bool isStatic : {false, true}) {
+                    if (isStatic && !staticCascadeStale[cascade]) {
+                        continue;
+                    }
+                    for (auto i : visible) {
+                        const auto &model = sceneData.modelInfos[i];
+                        if (model.castsShadow && model.isStatic == isStatic) {
+                            instances.add(model.geometry, i);
+                        }
+                    }
+                    instances.flush(
+                        sceneData.geometryPool,
+                        isStatic ? sceneData.staticShadowDraws[cascade]
+                                 : sceneData.shadowDraws[cascade]);
+                }
+            }
+        }
+        for (auto &shadowDraws : sceneData.shadowDraws) {
+            shadowDraws.end();
+        }
+        for (auto &shadowDraws : sceneData.staticShadowDraws) {
+            shadowDraws.end();
+        }
+        sceneData.sceneDraws.end();
+    }
 
-        stagingBuffer.destroy();
+    void AddModel(Model &model) {
+        AddInstance(model.id, sceneData.geometryPool.add(model.mesh),
+                    glm::mat4(1.0f));
+    }
 
-        auto &indexBuffer = sceneData.indexBuffer;
+    // Another object drawing geometry that is already in the pool
+    void AddInstance(uint32_t id, GeometryHandle geometry,
+                     const glm::mat4 &transform) {
+        if (sceneData.modelInfos.size() == MAX_SCENE_OBJECTS) {
+            throw std::runtime_error("Too many scene objects");
+        }
 
-        uint32_t iDstOffset = 0;
-        if (!sceneData.modelInfos.empty()) {
-            auto &iTail = sceneData.modelInfos.back().index;
-            iDstOffset = iTail.startIndex + iTail.count;
+        sceneData.modelIndices[id] = sceneData.modelInfos.size();
+        sceneData.modelInfos.push_back({
+            .id = id,
+            .geometry = geometry,
+            .model = transform,
+        });
+    }
+
+    void buildCubeGrid() {
+        auto &modelInfos = sceneData.modelInfos;
+        std::erase_if(modelInfos, [](const ModelInfo &modelInfo) {
+            return modelInfo.id >= CUBE_GRID_FIRST_ID;
+        });
+        sceneData.modelIndices.clear();
+        for (size_t i = 0; i < modelInfos.size(); i++) {
+            sceneData.modelIndices[modelInfos[i].id] = i;
         }
-        void *data = indexBuffer.map();
-        std::memcpy(
-            static_cast<uint8_t *>(data) + iDstOffset * sizeof(uint16_t),
-            model.mesh.indices.data(), ibSize);
-        indexBuffer.unmap();
 
-        modelInfo.index.count =
-            static_cast<uint32_t>(model.mesh.indices.size());
-        modelInfo.index.startIndex = iDstOffset;
+        auto geometry = sceneData.getModelInfoById(cube.id).geometry;
+        const float spacing = 0.25f;
+        float offset = (cubeGridSize - 1) * spacing * 0.5f;
+        uint32_t id = CUBE_GRID_FIRST_ID;
+        for (int y = 0; y < cubeGridSize; y++) {
+            for (int x = 0; x < cubeGridSize; x++) {
+                glm::vec3 position(x * spacing - offset, y * spacing - offset,
+                                   0.05f);
+                AddInstance(id++, geometry,
+                            glm::scale(glm::translate(glm::mat4(1.0f),
+                                                      position),
+                                       glm::vec3(0.1f)));
+            }
+        }
 
-        sceneData.modelInfos.push_back(modelInfo);
+        builtCubeGridSize = cubeGridSize;
+        staticCastersChanged = true;
     }
 };
 
@@ -24,7 +24,12 @@ foreach ($file in $files) {
 
     # execute via command
     Write-Host "Compiling $relativePath"
-    & $dxc -spirv -T vs_6_0 -E vert $file.FullName -Fo "$outputDir\$basename.vert.spv"
-    & $dxc -spirv -T ps_6_0 -E frag $file.FullName -Fo "$outputDir\$basename.frag.spv"
+    # Only the entry points the file defines, includes have none
+    foreach ($stage in @(@("vert", "vs_6_0"), @("frag", "ps_6_0"), @("comp", "cs_6_0"))) {
+        $entry, $profile = $stage
+        if (Select-String -Path $file.FullName -Pattern "\b$entry\s*\(" -Quiet) {
+            & $dxc -spirv -T $profile -E $entry $file.FullName -Fo "$outputDir\$basename.$entry.spv"
+        }
+    }
     Write-Host
 }
\ No newline at end of file
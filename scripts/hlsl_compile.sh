@@ -41,11 +41,18 @@ hlsl_compile() {
         output_dir="$root/out/$(dirname "$relative_path")"
         mkdir -p "$output_dir"
 
-        echo "Compile $file -> $output_dir/$(basename "$file" .hlsl).vert.spv"
-        "$dxc" -spirv -T vs_6_0 -E vert "$file" -Fo "$output_dir/$(basename "$file" .hlsl).vert.spv"
-
-        echo "Compile $file -> $output_dir/$(basename "$file" .hlsl).frag.spv"
-        "$dxc" -spirv -T ps_6_0 -E frag "$file" -Fo "$output_dir/$(basename "$file" .hlsl).frag.spv"
+        # Only the entry points the file defines, includes have none
+        for stage in vert:vs_6_0 frag:ps_6_0 comp:cs_6_0; do
+            entry="${stage%%:*}"
+            profile="${stage#*:}"
+            if ! grep -qE "\b$entry\s*\(" "$file"; then
+                continue
+            fi
+
+            output="$output_dir/$(basename "$file" .hlsl).$entry.spv"
+            echo "Compile $file -> $output"
+            "$dxc" -spirv -T "$profile" -E "$entry" "$file" -Fo "$output"
+        done
     done
 }
 
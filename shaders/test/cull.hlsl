@@ -0,0 +1,146 @@
+struct ObjectData
+{
+    float4x4 model;
+    float4 boundingSphere;
+    uint indexCount;
+    uint firstIndex;
+    int vertexOffset;
+    uint flags;
+};
+
+struct CullView
+{
+    float4 frustumPlanes[6];
+    float4x4 occlusionViewProj;
+    float2 pyramidSize;
+    uint requiredFlags;
+    uint occlusion;
+};
+
+struct DrawCommand
+{
+    uint indexCount;
+    uint instanceCount;
+    uint firstIndex;
+    int vertexOffset;
+    uint firstInstance;
+};
+
+static const uint OBJECT_INDEX32 = 1;
+
+[[vk::binding(0)]] StructuredBuffer<ObjectData> objects;
+[[vk::binding(1)]] StructuredBuffer<CullView> views;
+
+// Two buckets per view, 16-bit indexed draws first
+[[vk::binding(2)]] RWStructuredBuffer<DrawCommand> drawCommands;
+[[vk::binding(3)]] RWStructuredBuffer<uint> drawCounts;
+
+[[vk::combinedImageSampler]] [[vk::binding(4)]]
+Texture2D<float> depthPyramid;
+[[vk::combinedImageSampler]] [[vk::binding(4)]]
+SamplerState pyramidSampler;
+
+struct PushConstant
+{
+    uint viewIndex;
+    uint objectCount;
+    uint maxDrawCount;
+};
+
+[[vk::push_constant]] PushConstant pushConstants;
+
+bool isOccluded(CullView view, float3 center, float radius)
+{
+    // Screen bounds of the sphere's box in last frame's clip space
+    float2 uvMin = 1.0;
+    float2 uvMax = 0.0;
+    float nearestDepth = 1.0;
+    for (uint i = 0; i < 8; i++)
+    {
+        float3 corner = center + radius * float3(
+            (i & 1) ? 1.0 : -1.0,
+            (i & 2) ? 1.0 : -1.0,
+            (i & 4) ? 1.0 : -1.0);
+        float4 clip = mul(view.occlusionViewProj, float4(corner, 1.0));
+
+        // Crossing the near plane, the projection is meaningless
+        if (clip.w <= 0.0)
+        {
+            return false;
+        }
+
+        float3 ndc = clip.xyz / clip.w;
+        float2 uv = ndc.xy * 0.5 + 0.5;
+        uvMin = min(uvMin, uv);
+        uvMax = max(uvMax, uv);
+        nearestDepth = min(nearestDepth, ndc.z);
+    }
+
+    uvMin = saturate(uvMin);
+    uvMax = saturate(uvMax);
+
+    // Pick the level where the box spans at most one texel, the bilinear
+    // max footprint then covers it completely
+    float2 size = (uvMax - uvMin) * view.pyramidSize;
+    float level = ceil(log2(max(max(size.x, size.y), 1.0)));
+    float farthestDepth = depthPyramid.SampleLevel(
+        pyramidSampler, (uvMin + uvMax) * 0.5, level);
+
+    return nearestDepth > farthestDepth;
+}
+
+[numthreads(64, 1, 1)]
+void comp(uint3 id : SV_DispatchThreadID)
+{
+    uint objectIndex = id.x;
+    if (objectIndex >= pushConstants.objectCount)
+    {
+        return;
+    }
+
+    CullView view = views[pushConstants.viewIndex];
+    ObjectData object = objects[objectIndex];
+    if ((object.flags & view.requiredFlags) != view.requiredFlags)
+    {
+        return;
+    }
+
+    float3 center =
+        mul(object.model, float4(object.boundingSphere.xyz, 1.0)).xyz;
+    float scale = max(
+        max(length(mul(object.model, float4(1.0, 0.0, 0.0, 0.0)).xyz),
+            length(mul(object.model, float4(0.0, 1.0, 0.0, 0.0)).xyz)),
+        length(mul(object.model, float4(0.0, 0.0, 1.0, 0.0)).xyz));
+    float radius = object.boundingSphere.w * scale;
+
+    for (uint i = 0; i < 6; i++)
+    {
+        float4 plane = view.frustumPlanes[i];
+        if (dot(plane.xyz, center) + plane.w < -radius)
+        {
+            return;
+        }
+    }
+
+    if (view.occlusion != 0 && isOccluded(view, center, radius))
+    {
+        return;
+    }
+
+    uint bucket = pushConstants.viewIndex * 2 +
+                  ((object.flags & OBJECT_INDEX32) ? 1 : 0);
+    uint slot;
+    InterlockedAdd(drawCounts[bucket], 1, slot);
+    if (slot >= pushConstants.maxDrawCount)
+    {
+        return;
+    }
+
+    DrawCommand command;
+    command.indexCount = object.indexCount;
+    command.instanceCount = 1;
+    command.firstIndex = object.firstIndex;
+    command.vertexOffset = object.vertexOffset;
+    command.firstInstance = objectIndex;
+    drawCommands[bucket * pushConstants.maxDrawCount + slot] = command;
+}
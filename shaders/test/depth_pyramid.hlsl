@@ -0,0 +1,28 @@
+// One level of the depth pyramid, the sampler does a max reduction over the
+// 2x2 footprint of every destination texel
+[[vk::combinedImageSampler]] [[vk::binding(0)]]
+Texture2D<float> source;
+[[vk::combinedImageSampler]] [[vk::binding(0)]]
+SamplerState sourceSampler;
+
+[[vk::binding(1)]] [[vk::image_format("r32f")]]
+RWTexture2D<float> destination;
+
+struct PushConstant
+{
+    float2 size;
+};
+
+[[vk::push_constant]] PushConstant pushConstants;
+
+[numthreads(8, 8, 1)]
+void comp(uint3 id : SV_DispatchThreadID)
+{
+    if (any(float2(id.xy) >= pushConstants.size))
+    {
+        return;
+    }
+
+    float2 uv = (float2(id.xy) + 0.5) / pushConstants.size;
+    destination[id.xy] = source.SampleLevel(sourceSampler, uv, 0);
+}
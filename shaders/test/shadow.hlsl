@@ -4,6 +4,7 @@ struct VSInput
     [[vk::location(1)]] float3 normal : NORMAL0;
     [[vk::location(2)]] float2 uv : TEXCOORD0;
     [[vk::location(3)]] float4 color : COLOR0;
+    [[vk::location(4)]] uint objectIndex : OBJECTINDEX0;
 };
 
 struct VSOutput
@@ -11,30 +12,55 @@ struct VSOutput
     float4 pos : SV_Position;
     [[vk::location(0)]] float3 normal : NORMAL0;
     [[vk::location(1)]] float4 color : COLOR0;
-    [[vk::location(2)]] float4 shadowCoord : TEXCOORD1;
+    [[vk::location(2)]] float3 shadowPos : TEXCOORD1;
     [[vk::location(3)]] float3 lightDir : TEXCOORD2;
+    [[vk::location(4)]] float viewDepth : TEXCOORD3;
 };
 
-Texture2D shadowMap : register(t0, space1);
-SamplerState shadowSampler : register(s0, space1);
+#define MAX_SHADOW_CASCADES 4
+
+// One layer per cascade. The sampler compares, every tap returns the
+// bilinear weighted result of the 2x2 texels around it.
+Texture2DArray shadowMap : register(t0, space1);
+SamplerComparisonState shadowSampler : register(s0, space1);
+
+#define PCF_GRID 0
+#define PCF_POISSON 1
+
+// Feature toggles, baked into each pipeline permutation so the fragment
+// shader does not branch on them
+[[vk::constant_id(0)]] const bool enablePCF = true;
+[[vk::constant_id(1)]] const uint pcfPattern = PCF_POISSON;
 
 cbuffer UBO : register(b0)
 {
     float4x4 view;
     float4x4 projection;
-    float4x4 lightView;
-    float4x4 lightProjection;
+    float4x4 cascadeViewProj[MAX_SHADOW_CASCADES];
+    // View space distance where each cascade ends
+    float4 cascadeSplits;
     float3 lightPos;
     float shadowBias;
-    float enablePCF;
+    uint cascadeCount;
+    // Taps per side of the grid, the Poisson kernel takes the square
+    uint pcfKernelSize;
+    // In shadow map texels
+    float pcfRadius;
 };
 
-struct PushConstant
+// Mirrors GpuObject, the culling fields are only read by cull.hlsl
+struct ObjectData
 {
     float4x4 model;
+    float4 boundingSphere;
+    uint indexCount;
+    uint firstIndex;
+    int vertexOffset;
+    uint flags;
 };
 
-[[vk::push_constant]] PushConstant pushConstants;
+// One entry per scene object, indexed by the per instance stream
+StructuredBuffer<ObjectData> objects : register(t1);
 
 static const float4x4 biasMat = float4x4(
 	0.5, 0.0, 0.0, 0.5,
@@ -45,73 +71,110 @@ static const float4x4 biasMat = float4x4(
 VSOutput vert(VSInput input)
 {
     VSOutput output;
+    float4x4 model = objects[input.objectIndex].model;
     output.color = input.color;
     output.normal = input.normal;
 
-    float4 worldPos = mul(pushConstants.model, float4(input.pos, 1.0));
+    float4 worldPos = mul(model, float4(input.pos, 1.0));
     float4 viewPos = mul(view, worldPos);
     output.pos = mul(projection, viewPos);
+    output.viewDepth = -viewPos.z;
     
-    output.normal = mul((float3x3)pushConstants.model, input.normal);
+    output.normal = mul((float3x3)model, input.normal);
     output.lightDir = normalize(lightPos - worldPos.xyz);
     
     float slopeBias = clamp(max(0.005, 0.01 * (1.0 - dot(output.normal, output.lightDir))), 0.0, 0.02);
-    float4 shadowWorldPos = mul(pushConstants.model, float4(input.pos - input.normal * slopeBias, 1.0));
-    float4 shadowCoord = mul(lightProjection, mul(lightView, shadowWorldPos));
-    output.shadowCoord = mul(biasMat, shadowCoord);
+    float4 shadowWorldPos = mul(model, float4(input.pos - input.normal * slopeBias, 1.0));
+    output.shadowPos = shadowWorldPos.xyz;
 
     return output;
 }
 
-float SampleShadow(float4 shadowCoord, float2 offset = float2(0, 0))
+static const float2 poissonDisk[16] = {
+    float2(-0.94201624, -0.39906216), float2(0.94558609, -0.76890725),
+    float2(-0.09418410, -0.92938870), float2(0.34495938, 0.29387760),
+    float2(-0.91588581, 0.45771432), float2(-0.81544232, -0.87912464),
+    float2(-0.38277543, 0.27676845), float2(0.97484398, 0.75648379),
+    float2(0.44323325, -0.97511554), float2(0.53742981, -0.47373420),
+    float2(-0.26496911, -0.41893023), float2(0.79197514, 0.19090188),
+    float2(-0.24188840, 0.99706507), float2(-0.81409955, 0.91437590),
+    float2(0.19984126, 0.78641367), float2(0.14383161, -0.14100790)
+};
+
+// Lit fraction of the 2x2 texels around the tap
+float SampleShadow(float4 shadowCoord, uint cascade, float2 offset = float2(0, 0))
 {
-    float shadow = 1.0f;
     float2 uv = shadowCoord.xy / shadowCoord.w;
-    float shadowDepth = shadowMap.Sample(shadowSampler, uv + offset).r;
-
-    float bias = shadowBias;
-    if (shadowDepth < shadowCoord.z - bias)
-    {
-        shadow = 0.0f;
-    }
+    return shadowMap.SampleCmpLevelZero(shadowSampler, float3(uv + offset, cascade),
+                                        shadowCoord.z - shadowBias);
+}
 
-    return shadow;
+// Interleaved gradient noise, decorrelates the kernel rotation of
+// neighbouring pixels so the banding of few taps turns into fine noise
+float InterleavedGradientNoise(float2 pixel)
+{
+    return frac(52.9829189 * frac(dot(pixel, float2(0.06711056, 0.00583715))));
 }
 
-float filterPCF(float4 shadowCoord)
+float filterPCF(float4 shadowCoord, uint cascade, float2 pixel)
 {
-    int2 texDim;
-    shadowMap.GetDimensions(texDim.x, texDim.y);
-
-    float scale = 1.5;
-	float dx = scale * 1.0 / float(texDim.x);
-	float dy = scale * 1.0 / float(texDim.y);
-
-	float shadowFactor = 0.0;
-	int count = 0;
-	int range = 1;
-
-	for (int x = -range; x <= range; x++)
-	{
-		for (int y = -range; y <= range; y++)
-		{
-			shadowFactor += SampleShadow(shadowCoord, float2(dx*x, dy*y));
-			count++;
-		}
-
-	}
-	return shadowFactor / count;
+    int3 texDim;
+    shadowMap.GetDimensions(texDim.x, texDim.y, texDim.z);
+    float2 texel = pcfRadius / float2(texDim.xy);
+
+    uint size = clamp(pcfKernelSize, 1u, 4u);
+    float shadowFactor = 0.0;
+    if (pcfPattern == PCF_POISSON)
+    {
+        float angle = 6.28318530 * InterleavedGradientNoise(pixel);
+        float s = sin(angle);
+        float c = cos(angle);
+        float2x2 rotation = float2x2(c, -s, s, c);
+
+        uint count = size * size;
+        for (uint i = 0; i < count; i++)
+        {
+            shadowFactor += SampleShadow(shadowCoord, cascade, mul(rotation, poissonDisk[i]) * texel);
+        }
+        return shadowFactor / count;
+    }
+
+    // Evenly spread over [-radius, radius]
+    float spacing = size > 1 ? 2.0 / (size - 1) : 0.0;
+    for (uint x = 0; x < size; x++)
+    {
+        for (uint y = 0; y < size; y++)
+        {
+            float2 offset = (float2(x, y) * spacing - (size > 1 ? 1.0 : 0.0)) * texel;
+            shadowFactor += SampleShadow(shadowCoord, cascade, offset);
+        }
+    }
+    return shadowFactor / (size * size);
 }
 
 float4 frag(
+    float4 fragCoord : SV_Position,
     [[vk::location(0)]] float3 normal : NORMAL0,
     [[vk::location(1)]] float4 color : COLOR0,
-    [[vk::location(2)]] float4 shadowCoord : TEXCOORD1,
-    [[vk::location(3)]] float3 lightDir : TEXCOORD2) : SV_TARGET
+    [[vk::location(2)]] float3 shadowPos : TEXCOORD1,
+    [[vk::location(3)]] float3 lightDir : TEXCOORD2,
+    [[vk::location(4)]] float viewDepth : TEXCOORD3) : SV_TARGET
 {
     float ambient = 0.1;
-    
-    float visibility = (enablePCF == 0.0f) ? SampleShadow(shadowCoord) : filterPCF(shadowCoord);
+
+    // The first cascade reaching past the pixel, lit beyond the last one
+    uint cascade = 0;
+    while (cascade < cascadeCount && viewDepth > cascadeSplits[cascade])
+    {
+        cascade++;
+    }
+
+    float visibility = 1.0;
+    if (cascade < cascadeCount)
+    {
+        float4 shadowCoord = mul(biasMat, mul(cascadeViewProj[cascade], float4(shadowPos, 1.0)));
+        visibility = enablePCF ? filterPCF(shadowCoord, cascade, fragCoord.xy) : SampleShadow(shadowCoord, cascade);
+    }
     visibility = 0.5 + 0.5 * visibility;
 
     float3 N = normalize(normal);
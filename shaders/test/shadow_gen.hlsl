@@ -1,9 +1,7 @@
 struct VSInput
 {
     [[vk::location(0)]] float3 pos : POSITION0;
-    [[vk::location(1)]] float3 normal : NORMAL0;
-    [[vk::location(2)]] float2 uv : TEXCOORD0;
-    [[vk::location(3)]] float4 color : COLOR0;
+    [[vk::location(4)]] uint objectIndex : OBJECTINDEX0;
 };
 
 struct VSOutput
@@ -11,30 +9,48 @@ struct VSOutput
     float4 pos : SV_Position;
 };
 
+#define MAX_SHADOW_CASCADES 4
+
 cbuffer UBO : register(b0)
 {
 	float4x4 view;
 	float4x4 projection;
-    float4x4 lightView;
-    float4x4 lightProjection;
+    float4x4 cascadeViewProj[MAX_SHADOW_CASCADES];
+    float4 cascadeSplits;
     float3 lightPos;
     float shadowBias;
-    float enablePCF;
+    uint cascadeCount;
+    uint pcfKernelSize;
+    float pcfRadius;
 };
 
 struct PushConstant
 {
-    float4x4 model;
+    uint cascade;
 };
 
 [[vk::push_constant]] PushConstant pushConstants;
 
+// Mirrors GpuObject, the culling fields are only read by cull.hlsl
+struct ObjectData
+{
+    float4x4 model;
+    float4 boundingSphere;
+    uint indexCount;
+    uint firstIndex;
+    int vertexOffset;
+    uint flags;
+};
+
+// One entry per scene object, indexed by the per instance stream
+StructuredBuffer<ObjectData> objects : register(t1);
+
 VSOutput vert(VSInput input)
 {
     VSOutput output;
-    float4 worldPos = mul(pushConstants.model, float4(input.pos, 1.0));
-    float4 viewPos = mul(lightView, worldPos);
-    output.pos = mul(lightProjection, viewPos);
+    float4x4 model = objects[input.objectIndex].model;
+    float4 worldPos = mul(model, float4(input.pos, 1.0));
+    output.pos = mul(cascadeViewProj[pushConstants.cascade], worldPos);
 
     return output;
 }
\ No newline at end of file
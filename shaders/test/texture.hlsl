@@ -1,4 +1,17 @@
-#include "base.hlsl"
+struct VSInput
+{
+    [[vk::location(0)]] float3 pos : POSITION0;
+    [[vk::location(1)]] float3 normal : NORMAL0;
+    [[vk::location(2)]] float2 uv : TEXCOORD0;
+    [[vk::location(3)]] float4 color : COLOR0;
+};
+
+struct VSOutput
+{
+    float4 pos : SV_Position;
+    [[vk::location(0)]] float2 uv : TEXCOORD0;
+    [[vk::location(1)]] float4 color : COLOR0;
+};
 
 Texture2D textureSampler : register(t0, space1);
 SamplerState textureSamplerState : register(s0, space1);
@@ -0,0 +1,173 @@
+#include "MeshCache.hpp"
+
+#include "core/Log.hpp"
+#include "core/MappedFile.hpp"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace {
+constexpr uint64_t BLOB_ALIGNMENT = 16;
+
+uint64_t alignUp(uint64_t value) {
+    return (value + BLOB_ALIGNMENT - 1) & ~(BLOB_ALIGNMENT - 1);
+}
+
+bool isRangeValid(uint64_t offset, uint64_t size, uint64_t fileSize) {
+    return offset <= fileSize && size <= fileSize - offset;
+}
+}  // namespace
+
+bool loadMeshCache(const std::string& path, uint64_t sourceHash, Mesh& mesh) {
+    if (!std::filesystem::exists(path)) {
+        return false;
+    }
+
+    Engine::MappedFile file(path);
+    auto data = file.data();
+    if (data.size() < sizeof(MeshCacheHeader)) {
+        return false;
+    }
+
+    MeshCacheHeader header;
+    std::memcpy(&header, data.data(), sizeof(MeshCacheHeader));
+
+    if (header.magic != MeshCacheHeader::MAGIC ||
+        header.version != MeshCacheHeader::VERSION ||
+        header.sourceHash != sourceHash ||
+        header.vertexStride != sizeof(Vertex) ||
+        (header.indexStride != sizeof(uint16_t) &&
+         header.indexStride != sizeof(uint32_t)) ||
+        header.lodStride != sizeof(MeshLod) ||
+        header.meshletStride != sizeof(Meshlet)) {
+        return false;
+    }
+
+    uint64_t vertexBytes = uint64_t(header.vertexCount) * header.vertexStride;
+    uint64_t indexBytes = uint64_t(header.indexCount) * header.indexStride;
+    uint64_t lodBytes = uint64_t(header.lodCount) * header.lodStride;
+    uint64_t meshletBytes =
+        uint64_t(header.meshletCount) * header.meshletStride;
+    if (!isRangeValid(header.vertexOffset, vertexBytes, data.size()) ||
+        !isRangeValid(header.indexOffset, indexBytes, data.size()) ||
+        !isRangeValid(header.lodOffset, lodBytes, data.size()) ||
+        !isRangeValid(header.meshletOffset, meshletBytes, data.size())) {
+        LOG_WARN("Mesh cache {} is truncated", path);
+        return false;
+    }
+
+    std::vector<MeshLod> lods(header.lodCount);
+    std::memcpy(lods.data(), data.data() + header.lodOffset, lodBytes);
+    for (const auto& lod : lods) {
+        if (uint64_t(lod.firstIndex) + lod.indexCount > header.indexCount) {
+            LOG_WARN("Mesh cache {} has an invalid LOD range", path);
+            return false;
+        }
+    }
+    if (lods.empty()) {
+        return false;
+    }
+
+    std::vector<Meshlet> meshlets(header.meshletCount);
+    std::memcpy(meshlets.data(), data.data() + header.meshletOffset,
+                meshletBytes);
+    for (const auto& meshlet : meshlets) {
+        if (uint64_t(meshlet.firstIndex) + meshlet.indexCount >
+            header.indexCount) {
+            LOG_WARN("Mesh cache {} has an invalid meshlet range", path);
+            return false;
+        }
+    }
+
+    mesh.vertices.resize(header.vertexCount);
+    std::memcpy(mesh.vertices.data(), data.data() + header.vertexOffset,
+                vertexBytes);
+    mesh.indices.resize(header.indexCount);
+    auto indexData = data.data() + header.indexOffset;
+    if (header.indexStride == sizeof(uint32_t)) {
+        mesh.indexType = vk::IndexType::eUint32;
+        std::memcpy(mesh.indices.data(), indexData, indexBytes);
+    } else {
+        mesh.indexType = vk::IndexType::eUint16;
+        for (uint32_t i = 0; i < header.indexCount; i++) {
+            uint16_t index;
+            std::memcpy(&index, indexData + i * sizeof(uint16_t),
+                        sizeof(uint16_t));
+            mesh.indices[i] = index;
+        }
+    }
+    mesh.lods = std::move(lods);
+    mesh.meshlets = std::move(meshlets);
+    mesh.boundingSphere =
+        glm::vec4(header.boundingSphere[0], header.boundingSphere[1],
+                  header.boundingSphere[2], header.boundingSphere[3]);
+
+    return true;
+}
+
+void saveMeshCache(const std::string& path, uint64_t sourceHash,
+                   const Mesh& mesh) {
+    MeshCacheHeader header{
+        .magic = MeshCacheHeader::MAGIC,
+        .version = MeshCacheHeader::VERSION,
+        .sourceHash = sourceHash,
+        .vertexStride = sizeof(Vertex),
+        .vertexCount = static_cast<uint32_t>(mesh.vertices.size()),
+        .indexStride = mesh.getIndexSize(),
+        .indexCount = static_cast<uint32_t>(mesh.indices.size()),
+        .boundingSphere = {mesh.boundingSphere.x, mesh.boundingSphere.y,
+                           mesh.boundingSphere.z, mesh.boundingSphere.w},
+        .lodStride = sizeof(MeshLod),
+        .lodCount = static_cast<uint32_t>(mesh.lods.size()),
+        .meshletStride = sizeof(Meshlet),
+        .meshletCount = static_cast<uint32_t>(mesh.meshlets.size()),
+    };
+    header.vertexOffset = alignUp(sizeof(MeshCacheHeader));
+    header.indexOffset = alignUp(header.vertexOffset +
+                                 uint64_t(header.vertexCount) * sizeof(Vertex));
+    header.lodOffset =
+        alignUp(header.indexOffset +
+                uint64_t(header.indexCount) * header.indexStride);
+    header.meshletOffset = alignUp(
+        header.lodOffset + uint64_t(header.lodCount) * sizeof(MeshLod));
+
+    auto writeBlob = [](std::ofstream& out, uint64_t offset, const void* data,
+                        uint64_t size) {
+        static const char padding[BLOB_ALIGNMENT] = {};
+        out.write(padding, offset - static_cast<uint64_t>(out.tellp()));
+        out.write(static_cast<const char*>(data), size);
+    };
+
+    std::filesystem::create_directories(
+        std::filesystem::path(path).parent_path());
+
+    // Write to a temporary file first so a crash never leaves a torn cache
+    // that would pass the header check
+    auto tempPath = path + ".tmp";
+    {
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) {
+            LOG_WARN("Failed to write mesh cache {}", path);
+            return;
+        }
+
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        writeBlob(out, header.vertexOffset, mesh.vertices.data(),
+                  uint64_t(header.vertexCount) * sizeof(Vertex));
+        std::vector<std::byte> indexData(uint64_t(header.indexCount) *
+                                         header.indexStride);
+        mesh.writeIndices(indexData.data());
+        writeBlob(out, header.indexOffset, indexData.data(), indexData.size());
+        writeBlob(out, header.lodOffset, mesh.lods.data(),
+                  uint64_t(header.lodCount) * sizeof(MeshLod));
+        writeBlob(out, header.meshletOffset, mesh.meshlets.data(),
+                  uint64_t(header.meshletCount) * sizeof(Meshlet));
+    }
+
+    std::error_code error;
+    std::filesystem::rename(tempPath, path, error);
+    if (error) {
+        LOG_WARN("Failed to write mesh cache {}: {}", path, error.message());
+    }
+}
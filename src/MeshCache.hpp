@@ -0,0 +1,42 @@
+#pragma once
+
+#include "Model.hpp"
+
+#include <string>
+
+// Binary mesh cache: a fixed header followed by the tightly packed vertex,
+// index, LOD and meshlet blobs, each 16 byte aligned so the file can be used
+// as mapped.
+struct MeshCacheHeader {
+    static constexpr uint32_t MAGIC = 0x4853454d;  // "MESH"
+    static constexpr uint32_t VERSION = 5;
+
+    uint32_t magic;
+    uint32_t version;
+    uint64_t sourceHash;
+
+    uint32_t vertexStride;
+    uint32_t vertexCount;
+    uint64_t vertexOffset;
+
+    // 2 or 4, indices are stored at the width they are drawn with
+    uint32_t indexStride;
+    uint32_t indexCount;
+    uint64_t indexOffset;
+
+    float boundingSphere[4];
+
+    uint32_t lodStride;
+    uint32_t lodCount;
+    uint64_t lodOffset;
+
+    uint32_t meshletStride;
+    uint32_t meshletCount;
+    uint64_t meshletOffset;
+};
+
+// Returns false when the cache is missing, stale or was written by another
+// format version, in which case the mesh is left untouched.
+bool loadMeshCache(const std::string& path, uint64_t sourceHash, Mesh& mesh);
+void saveMeshCache(const std::string& path, uint64_t sourceHash,
+                   const Mesh& mesh);
@@ -0,0 +1,362 @@
+#include "MeshOptimizer.hpp"
+
+#include "core/Hash.hpp"
+#include "core/Log.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <unordered_map>
+
+namespace {
+constexpr uint32_t INVALID_INDEX = ~0u;
+
+// Forsyth's tuning, see "Linear-Speed Vertex Cache Optimisation"
+constexpr size_t FORSYTH_CACHE_SIZE = 32;
+constexpr float FORSYTH_LAST_TRIANGLE_SCORE = 0.75f;
+constexpr float FORSYTH_CACHE_DECAY_POWER = 1.5f;
+constexpr float FORSYTH_VALENCE_BOOST_SCALE = 2.0f;
+constexpr float FORSYTH_VALENCE_BOOST_POWER = 0.5f;
+
+float forsythVertexScore(int cachePosition, uint32_t remainingTriangles) {
+    if (remainingTriangles == 0) {
+        return -1.0f;
+    }
+
+    float score = 0.0f;
+    if (cachePosition >= 0) {
+        if (cachePosition < 3) {
+            // The vertices of the last triangle get a fixed score so the
+            // next one does not simply reuse the same edge
+            score = FORSYTH_LAST_TRIANGLE_SCORE;
+        } else {
+            float scale = 1.0f / (FORSYTH_CACHE_SIZE - 3);
+            score = std::pow(1.0f - (cachePosition - 3) * scale,
+                             FORSYTH_CACHE_DECAY_POWER);
+        }
+    }
+
+    // Favour vertices with few triangles left so they are finished off
+    // instead of leaving isolated triangles behind
+    score += FORSYTH_VALENCE_BOOST_SCALE *
+             std::pow(static_cast<float>(remainingTriangles),
+                      -FORSYTH_VALENCE_BOOST_POWER);
+    return score;
+}
+
+struct VertexHasher {
+    const std::vector<Vertex>* vertices;
+
+    size_t operator()(uint32_t index) const {
+        return Engine::hashValue((*vertices)[index]);
+    }
+};
+
+struct VertexEqual {
+    const std::vector<Vertex>* vertices;
+
+    bool operator()(uint32_t lhs, uint32_t rhs) const {
+        return std::memcmp(&(*vertices)[lhs], &(*vertices)[rhs],
+                           sizeof(Vertex)) == 0;
+    }
+};
+}  // namespace
+
+float computeACMR(std::span<const uint32_t> indices, size_t vertexCount,
+                  uint32_t cacheSize) {
+    if (indices.size() < 3) {
+        return 0.0f;
+    }
+
+    // Each vertex remembers the miss counter value at which it entered the
+    // cache, which makes the FIFO test O(1)
+    std::vector<uint32_t> cacheTimestamps(vertexCount, 0);
+    uint32_t misses = 0;
+    for (auto index : indices) {
+        if (misses + 1 - cacheTimestamps[index] > cacheSize ||
+            cacheTimestamps[index] == 0) {
+            misses++;
+            cacheTimestamps[index] = misses;
+        }
+    }
+
+    return static_cast<float>(misses) / (indices.size() / 3);
+}
+
+void deduplicateVertices(Mesh& mesh) {
+    auto& vertices = mesh.vertices;
+    std::unordered_map<uint32_t, uint32_t, VertexHasher, VertexEqual> unique(
+        vertices.size(), VertexHasher{&vertices}, VertexEqual{&vertices});
+
+    std::vector<uint32_t> remap(vertices.size());
+    std::vector<Vertex> uniqueVertices;
+    uniqueVertices.reserve(vertices.size());
+
+    for (uint32_t i = 0; i < vertices.size(); i++) {
+        auto [it, inserted] =
+            unique.try_emplace(i, static_cast<uint32_t>(uniqueVertices.size()));
+        if (inserted) {
+            uniqueVertices.push_back(vertices[i]);
+        }
+        remap[i] = it->second;
+    }
+
+    for (auto& index : mesh.indices) {
+        index = remap[index];
+    }
+
+    // The hasher still points at the old array, so swap only at the end
+    unique.clear();
+    vertices = std::move(uniqueVertices);
+}
+
+void optimizeVertexCache(std::span<uint32_t> indices, size_t vertexCount) {
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0) {
+        return;
+    }
+
+    // Per vertex list of the triangles not emitted yet, compacted in place as
+    // triangles get emitted
+    std::vector<uint32_t> remaining(vertexCount, 0);
+    for (auto index : indices) {
+        remaining[index]++;
+    }
+
+    std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++) {
+        adjacencyOffsets[v + 1] = adjacencyOffsets[v] + remaining[v];
+    }
+
+    std::vector<uint32_t> adjacency(indices.size());
+    {
+        std::vector<uint32_t> fill(adjacencyOffsets.begin(),
+                                   adjacencyOffsets.end() - 1);
+        for (uint32_t t = 0; t < triangleCount; t++) {
+            for (int k = 0; k < 3; k++) {
+                adjacency[fill[indices[t * 3 + k]]++] = t;
+            }
+        }
+    }
+
+    std::vector<int> cachePositions(vertexCount, -1);
+    std::vector<float> vertexScores(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++) {
+        vertexScores[v] = forsythVertexScore(-1, remaining[v]);
+    }
+
+    std::vector<float> triangleScores(triangleCount);
+    std::vector<bool> emitted(triangleCount, false);
+    for (size_t t = 0; t < triangleCount; t++) {
+        triangleScores[t] = vertexScores[indices[t * 3 + 0]] +
+                            vertexScores[indices[t * 3 + 1]] +
+                            vertexScores[indices[t * 3 + 2]];
+    }
+
+    std::vector<uint32_t> result;
+    result.reserve(indices.size());
+
+    std::vector<uint32_t> cache;
+    std::vector<uint32_t> nextCache;
+    cache.reserve(FORSYTH_CACHE_SIZE + 3);
+    nextCache.reserve(FORSYTH_CACHE_SIZE + 3);
+
+    auto bestTriangle = static_cast<uint32_t>(std::distance(
+        triangleScores.begin(),
+        std::max_element(triangleScores.begin(), triangleScores.end())));
+    size_t scanCursor = 0;
+
+    for (size_t i = 0; i < triangleCount; i++) {
+        if (bestTriangle == INVALID_INDEX) {
+            // Nothing left around the cache, restart from the first triangle
+            // that has not been emitted yet
+            while (emitted[scanCursor]) {
+                scanCursor++;
+            }
+            bestTriangle = static_cast<uint32_t>(scanCursor);
+        }
+
+        emitted[bestTriangle] = true;
+        const uint32_t* triangle = &indices[bestTriangle * 3];
+        result.insert(result.end(), triangle, triangle + 3);
+
+        for (int k = 0; k < 3; k++) {
+            uint32_t v = triangle[k];
+            uint32_t* begin = &adjacency[adjacencyOffsets[v]];
+            uint32_t* end = begin + remaining[v];
+            *std::find(begin, end, bestTriangle) = *(end - 1);
+            remaining[v]--;
+        }
+
+        // The emitted triangle moves to the front of the LRU cache
+        nextCache.assign(triangle, triangle + 3);
+        for (auto v : cache) {
+            if (v != triangle[0] && v != triangle[1] && v != triangle[2]) {
+                nextCache.push_back(v);
+            }
+        }
+
+        for (size_t c = 0; c < nextCache.size(); c++) {
+            uint32_t v = nextCache[c];
+            cachePositions[v] =
+                c < FORSYTH_CACHE_SIZE ? static_cast<int>(c) : -1;
+            vertexScores[v] =
+                forsythVertexScore(cachePositions[v], remaining[v]);
+        }
+
+        // Only triangles touching the cache changed score, which also
+        // includes the ones of vertices that just fell out of it
+        bestTriangle = INVALID_INDEX;
+        float bestScore = -1.0f;
+        for (auto v : nextCache) {
+            uint32_t* begin = &adjacency[adjacencyOffsets[v]];
+            for (uint32_t a = 0; a < remaining[v]; a++) {
+                uint32_t t = begin[a];
+                float score = vertexScores[indices[t * 3 + 0]] +
+                              vertexScores[indices[t * 3 + 1]] +
+                              vertexScores[indices[t * 3 + 2]];
+                triangleScores[t] = score;
+                if (score > bestScore) {
+                    bestScore = score;
+                    bestTriangle = t;
+                }
+            }
+        }
+
+        if (nextCache.size() > FORSYTH_CACHE_SIZE) {
+            nextCache.resize(FORSYTH_CACHE_SIZE);
+        }
+        std::swap(cache, nextCache);
+    }
+
+    std::copy(result.begin(), result.end(), indices.begin());
+}
+
+void optimizeOverdraw(std::span<uint32_t> indices,
+                      const std::vector<Vertex>& vertices, float threshold) {
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount < 2) {
+        return;
+    }
+
+    float baseACMR = computeACMR(indices, vertices.size());
+
+    // Split into clusters at the triangles that miss the cache on all three
+    // vertices, reordering whole clusters then only costs a cold start that
+    // was already being paid
+    const uint32_t cacheSize = 16;
+    std::vector<uint32_t> clusterStarts;
+    std::vector<uint32_t> cacheTimestamps(vertices.size(), 0);
+    uint32_t misses = 0;
+    for (uint32_t t = 0; t < triangleCount; t++) {
+        int triangleMisses = 0;
+        for (int k = 0; k < 3; k++) {
+            uint32_t v = indices[t * 3 + k];
+            if (cacheTimestamps[v] == 0 ||
+                misses + 1 - cacheTimestamps[v] > cacheSize) {
+                misses++;
+                cacheTimestamps[v] = misses;
+                triangleMisses++;
+            }
+        }
+        if (t == 0 || triangleMisses == 3) {
+            clusterStarts.push_back(t);
+        }
+    }
+
+    if (clusterStarts.size() < 2) {
+        return;
+    }
+    clusterStarts.push_back(static_cast<uint32_t>(triangleCount));
+
+    // Area weighted mesh centroid
+    glm::vec3 meshCentroid(0.0f);
+    float meshArea = 0.0f;
+    for (size_t t = 0; t < triangleCount; t++) {
+        const auto& p0 = vertices[indices[t * 3 + 0]].pos;
+        const auto& p1 = vertices[indices[t * 3 + 1]].pos;
+        const auto& p2 = vertices[indices[t * 3 + 2]].pos;
+        float area = glm::length(glm::cross(p1 - p0, p2 - p0));
+        meshCentroid += (p0 + p1 + p2) * (area / 3.0f);
+        meshArea += area;
+    }
+    meshCentroid /= std::max(meshArea, 1e-12f);
+
+    // Clusters that face away from the mesh center sit on the outside and
+    // are likely to occlude the rest, so they go first
+    size_t clusterCount = clusterStarts.size() - 1;
+    std::vector<float> sortKeys(clusterCount);
+    for (size_t c = 0; c < clusterCount; c++) {
+        glm::vec3 centroid(0.0f);
+        glm::vec3 normal(0.0f);
+        float area = 0.0f;
+        for (uint32_t t = clusterStarts[c]; t < clusterStarts[c + 1]; t++) {
+            const auto& p0 = vertices[indices[t * 3 + 0]].pos;
+            const auto& p1 = vertices[indices[t * 3 + 1]].pos;
+            const auto& p2 = vertices[indices[t * 3 + 2]].pos;
+            glm::vec3 weightedNormal = glm::cross(p1 - p0, p2 - p0);
+            float triangleArea = glm::length(weightedNormal);
+            centroid += (p0 + p1 + p2) * (triangleArea / 3.0f);
+            normal += weightedNormal;
+            area += triangleArea;
+        }
+        centroid /= std::max(area, 1e-12f);
+        float normalLength = glm::length(normal);
+        if (normalLength > 0.0f) {
+            normal /= normalLength;
+        }
+        sortKeys[c] = glm::dot(centroid - meshCentroid, normal);
+    }
+
+    std::vector<uint32_t> order(clusterCount);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        return sortKeys[a] > sortKeys[b];
+    });
+
+    std::vector<uint32_t> result;
+    result.reserve(indices.size());
+    for (auto c : order) {
+        result.insert(result.end(), indices.begin() + clusterStarts[c] * 3,
+                      indices.begin() + clusterStarts[c + 1] * 3);
+    }
+
+    if (computeACMR(result, vertices.size()) <= baseACMR * threshold) {
+        std::copy(result.begin(), result.end(), indices.begin());
+    }
+}
+
+void optimizeVertexFetch(Mesh& mesh) {
+    std::vector<uint32_t> remap(mesh.vertices.size(), INVALID_INDEX);
+    std::vector<Vertex> vertices;
+    vertices.reserve(mesh.vertices.size());
+
+    for (auto& index : mesh.indices) {
+        if (remap[index] == INVALID_INDEX) {
+            remap[index] = static_cast<uint32_t>(vertices.size());
+            vertices.push_back(mesh.vertices[index]);
+        }
+        index = remap[index];
+    }
+
+    mesh.vertices = std::move(vertices);
+}
+
+void optimizeMesh(Mesh& mesh) {
+    size_t sourceVertexCount = mesh.vertices.size();
+    float sourceACMR = computeACMR(mesh.indices, sourceVertexCount);
+
+    deduplicateVertices(mesh);
+    float dedupACMR = computeACMR(mesh.indices, mesh.vertices.size());
+
+    optimizeVertexCache(mesh.indices, mesh.vertices.size());
+    optimizeOverdraw(mesh.indices, mesh.vertices);
+    optimizeVertexFetch(mesh);
+    mesh.updateIndexType();
+
+    LOG("Mesh optimized: {} -> {} vertices, ACMR {:.3f} -> {:.3f} "
+        "(deduplicated {:.3f})",
+        sourceVertexCount, mesh.vertices.size(), sourceACMR,
+        computeACMR(mesh.indices, mesh.vertices.size()), dedupACMR);
+}
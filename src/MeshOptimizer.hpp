@@ -0,0 +1,34 @@
+#pragma once
+
+#include "Model.hpp"
+
+#include <span>
+
+// Import time mesh optimization. The passes are meant to run in this order:
+// deduplicate, vertex cache, overdraw and finally vertex fetch, which is what
+// optimizeMesh() does.
+
+// Average cache miss ratio (transformed vertices per triangle) of a FIFO
+// post-transform cache. 3.0 means no reuse at all, 0.5 is the ideal for a
+// large regular grid.
+float computeACMR(std::span<const uint32_t> indices, size_t vertexCount,
+                  uint32_t cacheSize = 16);
+
+// Merges bitwise identical vertices and remaps the indices.
+void deduplicateVertices(Mesh& mesh);
+
+// Reorders triangles for post-transform cache locality using Forsyth's linear
+// speed vertex cache optimization.
+void optimizeVertexCache(std::span<uint32_t> indices, size_t vertexCount);
+
+// Reorders the clusters produced by optimizeVertexCache so outward facing
+// geometry is drawn first. A cluster starts wherever the FIFO cache would
+// miss all three vertices, so the cache efficiency is kept within threshold.
+void optimizeOverdraw(std::span<uint32_t> indices,
+                      const std::vector<Vertex>& vertices,
+                      float threshold = 1.05f);
+
+// Reorders vertices by first use in the index buffer and drops unused ones.
+void optimizeVertexFetch(Mesh& mesh);
+
+void optimizeMesh(Mesh& mesh);
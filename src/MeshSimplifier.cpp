@@ -0,0 +1,349 @@
+#include "MeshSimplifier.hpp"
+
+#include "MeshOptimizer.hpp"
+
+#include "core/Hash.hpp"
+#include "core/Log.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <unordered_map>
+
+namespace {
+// A level has to drop at least this share of the previous level's triangles
+// to be worth keeping
+constexpr float MIN_LOD_REDUCTION = 0.1f;
+
+// Symmetric 4x4 plane distance matrix, only the upper triangle is stored.
+// weight is the summed triangle area so the error can be normalized back to
+// a squared distance.
+struct Quadric {
+    double a00 = 0, a01 = 0, a02 = 0, a03 = 0;
+    double a11 = 0, a12 = 0, a13 = 0;
+    double a22 = 0, a23 = 0;
+    double a33 = 0;
+    double weight = 0;
+
+    static Quadric fromPlane(const glm::dvec3& n, double d, double weight) {
+        Quadric q;
+        q.a00 = n.x * n.x * weight;
+        q.a01 = n.x * n.y * weight;
+        q.a02 = n.x * n.z * weight;
+        q.a03 = n.x * d * weight;
+        q.a11 = n.y * n.y * weight;
+        q.a12 = n.y * n.z * weight;
+        q.a13 = n.y * d * weight;
+        q.a22 = n.z * n.z * weight;
+        q.a23 = n.z * d * weight;
+        q.a33 = d * d * weight;
+        q.weight = weight;
+        return q;
+    }
+
+    Quadric& operator+=(const Quadric& rhs) {
+        a00 += rhs.a00, a01 += rhs.a01, a02 += rhs.a02, a03 += rhs.a03;
+        a11 += rhs.a11, a12 += rhs.a12, a13 += rhs.a13;
+        a22 += rhs.a22, a23 += rhs.a23;
+        a33 += rhs.a33;
+        weight += rhs.weight;
+        return *this;
+    }
+
+    // Area weighted mean of the squared distances to the accumulated planes
+    double evaluate(const glm::vec3& p) const {
+        double x = p.x, y = p.y, z = p.z;
+        double error = a00 * x * x + 2 * a01 * x * y + 2 * a02 * x * z +
+                       2 * a03 * x + a11 * y * y + 2 * a12 * y * z +
+                       2 * a13 * y + a22 * z * z + 2 * a23 * z + a33;
+        return weight > 0 ? std::abs(error) / weight : 0.0;
+    }
+};
+
+struct Collapse {
+    uint32_t from;
+    uint32_t to;
+    double cost;
+};
+
+struct PositionHasher {
+    size_t operator()(const glm::vec3& p) const {
+        return Engine::hashValue(p);
+    }
+};
+
+uint64_t edgeKey(uint32_t a, uint32_t b) {
+    return a < b ? (uint64_t(a) << 32) | b : (uint64_t(b) << 32) | a;
+}
+
+glm::vec3 triangleNormal(const glm::vec3& p0, const glm::vec3& p1,
+                         const glm::vec3& p2) {
+    return glm::cross(p1 - p0, p2 - p0);
+}
+}  // namespace
+
+std::vector<uint32_t> simplifyMesh(std::span<const uint32_t> indices,
+                                   const std::vector<Vertex>& vertices,
+                                   size_t targetIndexCount, float& error) {
+    std::vector<uint32_t> result(indices.begin(), indices.end());
+    error = 0.0f;
+
+    size_t vertexCount = vertices.size();
+    if (result.size() <= targetIndexCount || vertexCount == 0) {
+        return result;
+    }
+
+    // Seam vertices share a position with differently attributed wedges, the
+    // topology is only meaningful in terms of these welded positions. The
+    // wedges of a position form a circular list through nextWedge.
+    std::vector<uint32_t> weld(vertexCount);
+    std::vector<uint32_t> nextWedge(vertexCount);
+    {
+        std::unordered_map<glm::vec3, uint32_t, PositionHasher> positions;
+        positions.reserve(vertexCount);
+        for (uint32_t i = 0; i < vertexCount; i++) {
+            auto [it, inserted] = positions.try_emplace(vertices[i].pos, i);
+            weld[i] = it->second;
+            if (inserted) {
+                nextWedge[i] = i;
+            } else {
+                nextWedge[i] = nextWedge[weld[i]];
+                nextWedge[weld[i]] = i;
+            }
+        }
+    }
+
+    // Open border edges belong to a single triangle, positions on them are
+    // never moved
+    std::vector<bool> locked(vertexCount, false);
+    {
+        std::unordered_map<uint64_t, uint32_t> edgeUses;
+        edgeUses.reserve(result.size());
+        for (size_t i = 0; i < result.size(); i += 3) {
+            for (int k = 0; k < 3; k++) {
+                uint32_t a = weld[result[i + k]];
+                uint32_t b = weld[result[i + (k + 1) % 3]];
+                edgeUses[edgeKey(a, b)]++;
+            }
+        }
+        for (const auto& [key, uses] : edgeUses) {
+            if (uses == 1) {
+                locked[key >> 32] = true;
+                locked[key & 0xffffffffu] = true;
+            }
+        }
+    }
+
+    std::vector<Quadric> quadrics(vertexCount);
+    for (size_t i = 0; i < result.size(); i += 3) {
+        const auto& p0 = vertices[result[i + 0]].pos;
+        const auto& p1 = vertices[result[i + 1]].pos;
+        const auto& p2 = vertices[result[i + 2]].pos;
+        glm::dvec3 normal = triangleNormal(p0, p1, p2);
+        double area = glm::length(normal);
+        if (area <= 0.0) {
+            continue;
+        }
+        normal /= area;
+        auto quadric = Quadric::fromPlane(
+            normal, -glm::dot(normal, glm::dvec3(p0)), area * 0.5);
+        for (int k = 0; k < 3; k++) {
+            quadrics[weld[result[i + k]]] += quadric;
+        }
+    }
+
+    std::vector<Collapse> candidates;
+    std::vector<uint32_t> triangleOffsets(vertexCount + 1);
+    std::vector<uint32_t> vertexTriangles;
+    std::vector<bool> touched(vertexCount);
+    std::vector<uint32_t> remap(vertexCount);
+    std::vector<std::pair<uint32_t, uint32_t>> wedgeCollapses;
+    double maxCost = 0.0;
+
+    while (result.size() > targetIndexCount) {
+        // Vertex to triangle adjacency of the current index list
+        std::fill(triangleOffsets.begin(), triangleOffsets.end(), 0);
+        for (auto index : result) {
+            triangleOffsets[index + 1]++;
+        }
+        std::partial_sum(triangleOffsets.begin(), triangleOffsets.end(),
+                         triangleOffsets.begin());
+        vertexTriangles.resize(result.size());
+        {
+            auto cursor = triangleOffsets;
+            for (size_t i = 0; i < result.size(); i++) {
+                vertexTriangles[cursor[result[i]]++] =
+                    static_cast<uint32_t>(i / 3);
+            }
+        }
+
+        candidates.clear();
+        for (size_t i = 0; i < result.size(); i += 3) {
+            for (int k = 0; k < 3; k++) {
+                uint32_t a = result[i + k];
+                uint32_t b = result[i + (k + 1) % 3];
+                for (auto [from, to] : {std::pair(a, b), std::pair(b, a)}) {
+                    if (locked[weld[from]]) {
+                        continue;
+                    }
+                    auto quadric = quadrics[weld[from]];
+                    quadric += quadrics[weld[to]];
+                    candidates.push_back(
+                        {from, to, quadric.evaluate(vertices[to].pos)});
+                }
+            }
+        }
+        std::sort(candidates.begin(), candidates.end(),
+                  [](const Collapse& lhs, const Collapse& rhs) {
+                      return lhs.cost < rhs.cost;
+                  });
+
+        // Every collapse removes about two triangles. Collapses within a
+        // pass must not share triangles, so the flip test below stays valid.
+        size_t collapseBudget = (result.size() - targetIndexCount) / 6 + 1;
+        size_t collapseCount = 0;
+        std::fill(touched.begin(), touched.end(), false);
+        std::iota(remap.begin(), remap.end(), 0);
+
+        for (const auto& collapse : candidates) {
+            if (collapseCount >= collapseBudget) {
+                break;
+            }
+
+            uint32_t fromPosition = weld[collapse.from];
+            uint32_t toPosition = weld[collapse.to];
+            auto isTarget = [&](uint32_t v) {
+                return weld[v] == toPosition;
+            };
+
+            // Every wedge of the position has to move onto a wedge it shares
+            // an edge with, so a seam vertex can only slide along its seam
+            // and the attributes on either side stay continuous
+            wedgeCollapses.clear();
+            bool valid = !touched[collapse.to];
+            uint32_t wedge = fromPosition;
+            do {
+                valid = valid && !touched[wedge];
+                uint32_t target = wedge;
+                for (uint32_t t = triangleOffsets[wedge];
+                     t < triangleOffsets[wedge + 1] && target == wedge; t++) {
+                    const uint32_t* triangle = &result[vertexTriangles[t] * 3];
+                    for (int k = 0; k < 3; k++) {
+                        if (isTarget(triangle[k])) {
+                            target = triangle[k];
+                        }
+                    }
+                }
+
+                // Wedges no triangle references any more can stay put
+                if (triangleOffsets[wedge] != triangleOffsets[wedge + 1]) {
+                    valid = valid && target != wedge;
+                    wedgeCollapses.push_back({wedge, target});
+                }
+                wedge = nextWedge[wedge];
+            } while (wedge != fromPosition && valid);
+
+            const auto& targetPos = vertices[collapse.to].pos;
+            for (size_t i = 0; i < wedgeCollapses.size() && valid; i++) {
+                uint32_t from = wedgeCollapses[i].first;
+                for (uint32_t t = triangleOffsets[from];
+                     t < triangleOffsets[from + 1] && valid; t++) {
+                    const uint32_t* triangle = &result[vertexTriangles[t] * 3];
+                    if (isTarget(triangle[0]) || isTarget(triangle[1]) ||
+                        isTarget(triangle[2])) {
+                        continue;
+                    }
+
+                    glm::vec3 p[3], moved[3];
+                    for (int k = 0; k < 3; k++) {
+                        p[k] = vertices[triangle[k]].pos;
+                        moved[k] = triangle[k] == from ? targetPos : p[k];
+                    }
+                    valid = glm::dot(triangleNormal(p[0], p[1], p[2]),
+                                     triangleNormal(moved[0], moved[1],
+                                                    moved[2])) > 0.0f;
+                }
+            }
+            if (!valid) {
+                continue;
+            }
+
+            for (auto [from, to] : wedgeCollapses) {
+                remap[from] = to;
+                touched[to] = true;
+                for (uint32_t t = triangleOffsets[from];
+                     t < triangleOffsets[from + 1]; t++) {
+                    for (int k = 0; k < 3; k++) {
+                        touched[result[vertexTriangles[t] * 3 + k]] = true;
+                    }
+                }
+            }
+            quadrics[toPosition] += quadrics[fromPosition];
+            maxCost = std::max(maxCost, collapse.cost);
+            collapseCount++;
+        }
+
+        if (collapseCount == 0) {
+            break;
+        }
+
+        // Drop triangles that became degenerate in terms of positions
+        size_t writeIndex = 0;
+        for (size_t i = 0; i < result.size(); i += 3) {
+            uint32_t a = remap[result[i + 0]];
+            uint32_t b = remap[result[i + 1]];
+            uint32_t c = remap[result[i + 2]];
+            if (weld[a] == weld[b] || weld[b] == weld[c] ||
+                weld[c] == weld[a]) {
+                continue;
+            }
+            result[writeIndex++] = a;
+            result[writeIndex++] = b;
+            result[writeIndex++] = c;
+        }
+        result.resize(writeIndex);
+    }
+
+    error = static_cast<float>(std::sqrt(maxCost));
+    return result;
+}
+
+void generateLods(Mesh& mesh, std::span<const float> ratios) {
+    mesh.resetLods();
+
+    std::vector<uint32_t> baseIndices = mesh.indices;
+    size_t baseTriangleCount = baseIndices.size() / 3;
+    float previousError = 0.0f;
+
+    for (auto ratio : ratios) {
+        size_t targetIndexCount =
+            static_cast<size_t>(baseTriangleCount * ratio) * 3;
+        float error = 0.0f;
+        auto lodIndices =
+            simplifyMesh(baseIndices, mesh.vertices, targetIndexCount, error);
+
+        size_t previousCount = mesh.lods.back().indexCount;
+        if (lodIndices.empty() ||
+            lodIndices.size() > previousCount * (1.0f - MIN_LOD_REDUCTION)) {
+            break;
+        }
+
+        optimizeVertexCache(lodIndices, mesh.vertices.size());
+
+        // Each level restarts from LOD 0, the error is kept monotonic so the
+        // selector can walk the chain in order
+        previousError = std::max(previousError, error);
+        mesh.lods.push_back({
+            .firstIndex = static_cast<uint32_t>(mesh.indices.size()),
+            .indexCount = static_cast<uint32_t>(lodIndices.size()),
+            .error = previousError,
+        });
+        mesh.indices.insert(mesh.indices.end(), lodIndices.begin(),
+                            lodIndices.end());
+    }
+
+    for (size_t i = 1; i < mesh.lods.size(); i++) {
+        LOG("LOD {}: {} triangles, error {:.5f}", i,
+            mesh.lods[i].indexCount / 3, mesh.lods[i].error);
+    }
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "Model.hpp"
+
+#include <array>
+#include <span>
+
+// Triangle ratios of LOD 0 used when import generates the LOD chain
+inline constexpr std::array<float, 3> DEFAULT_LOD_RATIOS = {0.5f, 0.25f,
+                                                            0.125f};
+
+// Quadric error metric edge-collapse simplification (Garland and Heckbert).
+// A vertex only ever collapses onto one of its neighbours, so the result
+// still indexes the unchanged vertex array and every LOD can share one vertex
+// buffer. Seam vertices only slide along their seam and vertices on open
+// borders never move, so open meshes may stop short of the target.
+// error receives the largest collapse error as a distance in model units.
+std::vector<uint32_t> simplifyMesh(std::span<const uint32_t> indices,
+                                   const std::vector<Vertex>& vertices,
+                                   size_t targetIndexCount, float& error);
+
+// Simplifies LOD 0 (the current mesh.indices) at each ratio and appends the
+// results to mesh.indices, recording them in mesh.lods. Meant to run after
+// optimizeMesh(), every LOD is vertex cache optimized on its own. Stops early
+// once a level no longer removes a meaningful number of triangles.
+void generateLods(Mesh& mesh,
+                  std::span<const float> ratios = DEFAULT_LOD_RATIOS);
@@ -0,0 +1,226 @@
+#include "Meshlet.hpp"
+
+#include "core/Hash.hpp"
+#include "core/Log.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <unordered_map>
+
+namespace {
+constexpr uint32_t INVALID_INDEX = ~0u;
+
+struct PositionHasher {
+    size_t operator()(const glm::vec3& p) const {
+        return Engine::hashValue(p);
+    }
+};
+
+void computeMeshletBounds(Meshlet& meshlet, std::span<const uint32_t> indices,
+                          const std::vector<Vertex>& vertices) {
+    // Bounds center first, then the farthest vertex gives the radius
+    glm::vec3 boundsMin = vertices[indices.front()].pos;
+    glm::vec3 boundsMax = boundsMin;
+    for (auto index : indices) {
+        boundsMin = glm::min(boundsMin, vertices[index].pos);
+        boundsMax = glm::max(boundsMax, vertices[index].pos);
+    }
+    glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+    float radius = 0.0f;
+    for (auto index : indices) {
+        radius = std::max(radius, glm::length(vertices[index].pos - center));
+    }
+    meshlet.boundingSphere = glm::vec4(center, radius);
+
+    // The cone axis is the average facing, the cutoff is the sine of the
+    // widest angle any triangle makes with it
+    std::vector<glm::vec3> normals;
+    normals.reserve(indices.size() / 3);
+    glm::vec3 axis(0.0f);
+    for (size_t i = 0; i < indices.size(); i += 3) {
+        const auto& p0 = vertices[indices[i + 0]].pos;
+        const auto& p1 = vertices[indices[i + 1]].pos;
+        const auto& p2 = vertices[indices[i + 2]].pos;
+        glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+        float length = glm::length(normal);
+        if (length > 0.0f) {
+            normals.push_back(normal / length);
+            axis += normals.back();
+        }
+    }
+
+    meshlet.coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+    meshlet.coneCutoff = 1.0f;
+    float axisLength = glm::length(axis);
+    if (normals.empty() || axisLength <= 0.0f) {
+        return;
+    }
+    axis /= axisLength;
+
+    float minDot = 1.0f;
+    for (const auto& normal : normals) {
+        minDot = std::min(minDot, glm::dot(axis, normal));
+    }
+
+    // Wider than a hemisphere means some triangle always faces the camera
+    if (minDot > 0.0f) {
+        meshlet.coneAxis = axis;
+        meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+    }
+}
+}  // namespace
+
+void buildMeshlets(Mesh& mesh, uint32_t maxVertices, uint32_t maxTriangles) {
+    mesh.meshlets.clear();
+    if (mesh.lods.empty()) {
+        mesh.resetLods();
+    }
+
+    const auto& lod = mesh.lods.front();
+    std::span<uint32_t> indices(mesh.indices.data() + lod.firstIndex,
+                                lod.indexCount);
+    size_t triangleCount = indices.size() / 3;
+    size_t vertexCount = mesh.vertices.size();
+    if (triangleCount == 0) {
+        return;
+    }
+
+    // Triangles are neighbours when they share a position, uv seams would
+    // otherwise cut textured meshes into tiny clusters
+    std::vector<uint32_t> weld(vertexCount);
+    {
+        std::unordered_map<glm::vec3, uint32_t, PositionHasher> positions;
+        positions.reserve(vertexCount);
+        for (uint32_t i = 0; i < vertexCount; i++) {
+            weld[i] = positions.try_emplace(mesh.vertices[i].pos, i)
+                          .first->second;
+        }
+    }
+
+    // Position to triangle adjacency
+    std::vector<uint32_t> triangleOffsets(vertexCount + 1, 0);
+    for (auto index : indices) {
+        triangleOffsets[weld[index] + 1]++;
+    }
+    std::partial_sum(triangleOffsets.begin(), triangleOffsets.end(),
+                     triangleOffsets.begin());
+    std::vector<uint32_t> vertexTriangles(indices.size());
+    {
+        auto cursor = triangleOffsets;
+        for (size_t i = 0; i < indices.size(); i++) {
+            vertexTriangles[cursor[weld[indices[i]]]++] =
+                static_cast<uint32_t>(i / 3);
+        }
+    }
+
+    // meshletSlot maps a vertex to the meshlet currently holding it
+    std::vector<uint32_t> meshletSlot(vertexCount, INVALID_INDEX);
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<uint32_t> meshletVertices;
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> result;
+    result.reserve(indices.size());
+
+    size_t seed = 0;
+    while (true) {
+        // Seeds follow the existing vertex cache order, so meshlets stay in
+        // roughly the order the triangles were optimized for
+        while (seed < triangleCount && emitted[seed]) {
+            seed++;
+        }
+        if (seed == triangleCount) {
+            break;
+        }
+
+        uint32_t meshletIndex = static_cast<uint32_t>(mesh.meshlets.size());
+        Meshlet meshlet{
+            .firstIndex =
+                lod.firstIndex + static_cast<uint32_t>(result.size()),
+        };
+        meshletVertices.clear();
+        candidates.assign(1, static_cast<uint32_t>(seed));
+
+        while (!candidates.empty()) {
+            // Pick the candidate that adds the fewest new vertices, earlier
+            // triangles win ties
+            size_t best = INVALID_INDEX;
+            int bestNewVertices = 4;
+            for (size_t c = 0; c < candidates.size(); c++) {
+                uint32_t t = candidates[c];
+                if (emitted[t]) {
+                    continue;
+                }
+                int newVertices = 0;
+                for (int k = 0; k < 3; k++) {
+                    newVertices += meshletSlot[indices[t * 3 + k]] !=
+                                   meshletIndex;
+                }
+                if (newVertices < bestNewVertices ||
+                    (newVertices == bestNewVertices &&
+                     t < candidates[best])) {
+                    best = c;
+                    bestNewVertices = newVertices;
+                }
+            }
+
+            if (best == INVALID_INDEX ||
+                meshletVertices.size() + bestNewVertices > maxVertices) {
+                break;
+            }
+
+            uint32_t t = candidates[best];
+            candidates[best] = candidates.back();
+            candidates.pop_back();
+
+            emitted[t] = true;
+            for (int k = 0; k < 3; k++) {
+                uint32_t v = indices[t * 3 + k];
+                result.push_back(v);
+                if (meshletSlot[v] == meshletIndex) {
+                    continue;
+                }
+                meshletSlot[v] = meshletIndex;
+                meshletVertices.push_back(v);
+                for (uint32_t i = triangleOffsets[weld[v]];
+                     i < triangleOffsets[weld[v] + 1]; i++) {
+                    if (!emitted[vertexTriangles[i]]) {
+                        candidates.push_back(vertexTriangles[i]);
+                    }
+                }
+            }
+
+            meshlet.indexCount += 3;
+            if (meshlet.indexCount / 3 == maxTriangles) {
+                break;
+            }
+
+            // Drop candidates emitted in the meantime so the scan above
+            // does not grow with the meshlet
+            std::erase_if(candidates, [&](uint32_t c) { return emitted[c]; });
+        }
+
+        meshlet.vertexCount = static_cast<uint32_t>(meshletVertices.size());
+        computeMeshletBounds(
+            meshlet,
+            std::span<const uint32_t>(result).subspan(
+                meshlet.firstIndex - lod.firstIndex, meshlet.indexCount),
+            mesh.vertices);
+        mesh.meshlets.push_back(meshlet);
+    }
+
+    std::copy(result.begin(), result.end(), indices.begin());
+
+    LOG("Built {} meshlets, {:.1f} triangles each", mesh.meshlets.size(),
+        static_cast<float>(triangleCount) / mesh.meshlets.size());
+}
+
+bool isMeshletBackfacing(const Meshlet& meshlet, const glm::vec3& cameraPos) {
+    // Conservative for the whole bounding sphere, see "Optimizing the
+    // Graphics Pipeline with Compute" (Wihlidal)
+    glm::vec3 center = glm::vec3(meshlet.boundingSphere);
+    glm::vec3 toCenter = center - cameraPos;
+    return glm::dot(toCenter, meshlet.coneAxis) >=
+           meshlet.coneCutoff * glm::length(toCenter) +
+               meshlet.boundingSphere.w;
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include "Model.hpp"
+
+// Partitions LOD 0 into meshlets by growing each one across neighbouring
+// triangles, preferring the ones that add the fewest new vertices. LOD 0 is
+// reordered so every meshlet is a contiguous index range. Run after
+// optimizeMesh(), the cluster order replaces the overdraw order.
+void buildMeshlets(Mesh& mesh, uint32_t maxVertices = MESHLET_MAX_VERTICES,
+                   uint32_t maxTriangles = MESHLET_MAX_TRIANGLES);
+
+// True when every triangle of the meshlet faces away from cameraPos, which
+// is given in model space.
+bool isMeshletBackfacing(const Meshlet& meshlet, const glm::vec3& cameraPos);
@@ -4,17 +4,74 @@
 #include "assimp/scene.h"
 #include "assimp/postprocess.h"
 
-void Model::loadFromFile(std::string fileName) {
+#include "MeshCache.hpp"
+#include "Meshlet.hpp"
+#include "MeshOptimizer.hpp"
+#include "MeshSimplifier.hpp"
+
+#include "core/Hash.hpp"
+#include "core/Log.hpp"
+#include "core/MappedFile.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+
+void Model::loadFromFile(std::string fileName,
+                         const ModelImportOptions &options) {
+    Engine::MappedFile file(RESOURCE_DIR + fileName);
+    auto fileData = file.data();
+
+    // The cache is keyed by the source contents and the import options, so
+    // editing the asset is enough to trigger a re-import
+    auto sourceHash = Engine::hashBytes(fileData);
+    sourceHash = Engine::hashValue(options.buildMeshlets, sourceHash);
+    sourceHash = Engine::hashValue(options.maxMeshletVertices, sourceHash);
+    sourceHash = Engine::hashValue(options.maxMeshletTriangles, sourceHash);
+    auto cachePath = CACHE_DIR + fileName + ".mesh";
+    if (loadMeshCache(cachePath, sourceHash, mesh)) {
+        return;
+    }
+
+    importMesh(fileData, std::filesystem::path(fileName).extension().string(),
+               options);
+    saveMeshCache(cachePath, sourceHash, mesh);
+    LOG("Imported {} ({} vertices, {} indices)", fileName,
+        mesh.vertices.size(), mesh.indices.size());
+}
+
+void Model::importMesh(std::span<const std::byte> fileData,
+                       std::string extension,
+                       const ModelImportOptions &options) {
+    // Assimp parses the mapped bytes in place, the extension is only a hint
+    // for picking the importer
+    if (!extension.empty() && extension.front() == '.') {
+        extension.erase(0, 1);
+    }
+
     auto importer = Assimp::Importer();
-    const aiScene *scene =
-        importer.ReadFile(RESOURCE_DIR + fileName, aiProcess_Triangulate);
+    const aiScene *scene = importer.ReadFileFromMemory(
+        fileData.data(), fileData.size(), aiProcess_Triangulate,
+        extension.c_str());
+    if (!scene) {
+        throw std::runtime_error(importer.GetErrorString());
+    }
 
     for (unsigned int i = 0; i < scene->mNumMeshes; i++) {
         aiMesh *mesh = scene->mMeshes[i];
+        auto baseVertex = static_cast<uint32_t>(this->mesh.vertices.size());
         for (unsigned int j = 0; j < mesh->mNumVertices; j++) {
             Vertex vertex;
             vertex.pos = glm::vec3(mesh->mVertices[j].x, mesh->mVertices[j].y,
                                    mesh->mVertices[j].z);
+            vertex.normal = mesh->mNormals
+                                ? glm::vec3(mesh->mNormals[j].x,
+                                            mesh->mNormals[j].y,
+                                            mesh->mNormals[j].z)
+                                : glm::vec3(0.0f, 0.0f, 1.0f);
             vertex.uv = mesh->mTextureCoords[0]
                             ? glm::vec2(mesh->mTextureCoords[0][j].x,
                                         mesh->mTextureCoords[0][j].y)
@@ -32,10 +89,19 @@ void Model::loadFromFile(std::string fileName) {
         for (unsigned int j = 0; j < mesh->mNumFaces; j++) {
             aiFace face = mesh->mFaces[j];
             for (unsigned int k = 0; k < face.mNumIndices; k++) {
-                this->mesh.indices.push_back(face.mIndices[k]);
+                this->mesh.indices.push_back(baseVertex + face.mIndices[k]);
             }
         }
     }
+
+    // Import is the cook step, so the optimized result is what gets cached
+    optimizeMesh(this->mesh);
+    generateLods(this->mesh);
+    this->mesh.updateBounds();
+    if (options.buildMeshlets) {
+        buildMeshlets(this->mesh, options.maxMeshletVertices,
+                      options.maxMeshletTriangles);
+    }
 }
 
 void Model::createPlane() {
@@ -61,6 +127,9 @@ void Model::createPlane() {
     };
 
     mesh.indices = {0, 2, 1, 0, 3, 2};
+    mesh.updateIndexType();
+    mesh.resetLods();
+    mesh.updateBounds();
 }
 
 void Model::createCube() {
@@ -188,4 +257,234 @@ void Model::createCube() {
                     16, 18, 17, 16, 19, 18,
                     // Bottom face (clockwise)
                     20, 22, 21, 20, 23, 22};
+    mesh.updateIndexType();
+    mesh.resetLods();
+    mesh.updateBounds();
+}
+
+std::vector<vk::VertexInputAttributeDescription>
+Vertex::getAttributeDescriptions(VertexLayout layout, VertexStreams streams,
+                                 bool positionOnly) {
+    std::vector<vk::VertexInputAttributeDescription> attributes;
+    if (layout == VertexLayout::eQuantized) {
+        attributes = {
+            vk::VertexInputAttributeDescription(
+                0, 0, vk::Format::eR16G16B16A16Unorm,
+                offsetof(QuantizedVertex, pos)),
+            vk::VertexInputAttributeDescription(
+                1, 0, vk::Format::eR16G16Snorm,
+                offsetof(QuantizedVertex, normal)),
+            vk::VertexInputAttributeDescription(
+                2, 0, vk::Format::eR16G16Sfloat, offsetof(QuantizedVertex, uv)),
+            vk::VertexInputAttributeDescription(
+                3, 0, vk::Format::eR8G8B8A8Unorm,
+                offsetof(QuantizedVertex, color)),
+        };
+    } else {
+        attributes = {
+            vk::VertexInputAttributeDescription(
+                0, 0, vk::Format::eR32G32B32Sfloat, offsetof(Vertex, pos)),
+            vk::VertexInputAttributeDescription(
+                1, 0, vk::Format::eR32G32B32Sfloat, offsetof(Vertex, normal)),
+            vk::VertexInputAttributeDescription(2, 0, vk::Format::eR32G32Sfloat,
+                                                offsetof(Vertex, uv)),
+            vk::VertexInputAttributeDescription(
+                3, 0, vk::Format::eR32G32B32A32Sfloat, offsetof(Vertex, color)),
+        };
+    }
+
+    if (positionOnly) {
+        attributes.resize(1);
+    }
+
+    if (streams == VertexStreams::eSplitPosition) {
+        uint32_t positionStride = getPositionStride(layout);
+        for (size_t i = 1; i < attributes.size(); i++) {
+            attributes[i].binding = 1;
+            attributes[i].offset -= positionStride;
+        }
+    }
+
+    return attributes;
+}
+
+std::vector<vk::VertexInputBindingDescription> Vertex::getBindingDescriptions(
+    VertexLayout layout, VertexStreams streams, bool positionOnly) {
+    if (streams == VertexStreams::eInterleaved) {
+        return {vk::VertexInputBindingDescription(
+            0, getStride(layout), vk::VertexInputRate::eVertex)};
+    }
+
+    uint32_t positionStride = getPositionStride(layout);
+    std::vector<vk::VertexInputBindingDescription> bindings = {
+        vk::VertexInputBindingDescription(0, positionStride,
+                                          vk::VertexInputRate::eVertex),
+    };
+    if (!positionOnly) {
+        bindings.push_back(vk::VertexInputBindingDescription(
+            1, getStride(layout) - positionStride,
+            vk::VertexInputRate::eVertex));
+    }
+    return bindings;
+}
+
+vk::VertexInputBindingDescription Vertex::getInstanceBindingDescription(
+    uint32_t binding) {
+    return vk::VertexInputBindingDescription(binding, sizeof(uint32_t),
+                                             vk::VertexInputRate::eInstance);
+}
+
+vk::VertexInputAttributeDescription Vertex::getInstanceAttributeDescription(
+    uint32_t binding) {
+    return vk::VertexInputAttributeDescription(
+        INSTANCE_ATTRIBUTE_LOCATION, binding, vk::Format::eR32Uint, 0);
+}
+
+void Mesh::writeVertexStreams(VertexLayout layout, void *positions,
+                              void *attributes) const {
+    auto source = getVertexData(layout);
+    size_t stride = Vertex::getStride(layout);
+    size_t positionStride = Vertex::getPositionStride(layout);
+    size_t attributeStride = stride - positionStride;
+
+    auto positionData = static_cast<std::byte *>(positions);
+    auto attributeData = static_cast<std::byte *>(attributes);
+    for (size_t i = 0; i < source.size() / stride; i++) {
+        std::memcpy(positionData + i * positionStride,
+                    source.data() + i * stride, positionStride);
+        std::memcpy(attributeData + i * attributeStride,
+                    source.data() + i * stride + positionStride,
+                    attributeStride);
+    }
+}
+
+void Mesh::updateIndexType() {
+    // Every index is below vertices.size(), so 16-bit is enough up to 65536
+    // vertices
+    indexType = vertices.size() <= 0x10000 ? vk::IndexType::eUint16
+                                           : vk::IndexType::eUint32;
+}
+
+void Mesh::resetLods() {
+    lods = {{
+        .firstIndex = 0,
+        .indexCount = static_cast<uint32_t>(indices.size()),
+        .error = 0.0f,
+    }};
+}
+
+void Mesh::updateBounds() {
+    if (vertices.empty()) {
+        boundingSphere = glm::vec4(0.0f);
+        return;
+    }
+
+    glm::vec3 boundsMin = vertices.front().pos;
+    glm::vec3 boundsMax = vertices.front().pos;
+    for (const auto &vertex : vertices) {
+        boundsMin = glm::min(boundsMin, vertex.pos);
+        boundsMax = glm::max(boundsMax, vertex.pos);
+    }
+
+    glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+    float radius = 0.0f;
+    for (const auto &vertex : vertices) {
+        radius = std::max(radius, glm::length(vertex.pos - center));
+    }
+    boundingSphere = glm::vec4(center, radius);
+}
+
+uint32_t Mesh::selectLod(const glm::mat4 &model, const glm::vec3 &cameraPos,
+                         float pixelsPerUnit, float maxPixelError) const {
+    if (lods.size() < 2) {
+        return 0;
+    }
+
+    float scale = std::max({glm::length(glm::vec3(model[0])),
+                            glm::length(glm::vec3(model[1])),
+                            glm::length(glm::vec3(model[2]))});
+    glm::vec3 center = model * glm::vec4(glm::vec3(boundingSphere), 1.0f);
+
+    // Distance to the nearest point of the bounds, so the error is never
+    // underestimated. Inside the bounds always means full resolution.
+    float distance =
+        glm::length(center - cameraPos) - boundingSphere.w * scale;
+    if (distance <= 0.0f) {
+        return 0;
+    }
+
+    for (uint32_t lod = static_cast<uint32_t>(lods.size()) - 1; lod > 0;
+         lod--) {
+        float projectedError = lods[lod].error * scale / distance;
+        if (projectedError * pixelsPerUnit <= maxPixelError) {
+            return lod;
+        }
+    }
+    return 0;
+}
+
+void Mesh::quantize() {
+    if (vertices.empty()) {
+        return;
+    }
+
+    glm::vec3 boundsMin = vertices.front().pos;
+    glm::vec3 boundsMax = vertices.front().pos;
+    for (const auto &vertex : vertices) {
+        boundsMin = glm::min(boundsMin, vertex.pos);
+        boundsMax = glm::max(boundsMax, vertex.pos);
+    }
+
+    // Flat axes keep a unit extent so the division below stays finite
+    glm::vec3 extent = boundsMax - boundsMin;
+    for (int axis = 0; axis < 3; axis++) {
+        if (extent[axis] <= 0.0f) {
+            extent[axis] = 1.0f;
+        }
+    }
+
+    dequantization = glm::scale(glm::translate(glm::mat4(1.0f), boundsMin),
+                                extent);
+
+    quantizedVertices.resize(vertices.size());
+    for (size_t i = 0; i < vertices.size(); i++) {
+        const auto &vertex = vertices[i];
+        auto &packed = quantizedVertices[i];
+
+        uint64_t pos = glm::packUnorm4x16(
+            glm::vec4((vertex.pos - boundsMin) / extent, 0.0f));
+        std::memcpy(packed.pos, &pos, sizeof(packed.pos));
+
+        // Octahedral mapping: project onto the L1 unit sphere and fold the
+        // lower hemisphere over the diagonals
+        glm::vec3 n = vertex.normal;
+        n /= std::max(std::abs(n.x) + std::abs(n.y) + std::abs(n.z), 1e-12f);
+        glm::vec2 octahedral(n.x, n.y);
+        if (n.z < 0.0f) {
+            float signX = n.x >= 0.0f ? 1.0f : -1.0f;
+            float signY = n.y >= 0.0f ? 1.0f : -1.0f;
+            octahedral.x = (1.0f - std::abs(n.y)) * signX;
+            octahedral.y = (1.0f - std::abs(n.x)) * signY;
+        }
+        uint32_t normal = glm::packSnorm2x16(octahedral);
+        std::memcpy(packed.normal, &normal, sizeof(packed.normal));
+
+        uint32_t uv = glm::packHalf2x16(vertex.uv);
+        std::memcpy(packed.uv, &uv, sizeof(packed.uv));
+
+        uint32_t color = glm::packUnorm4x8(vertex.color);
+        std::memcpy(packed.color, &color, sizeof(packed.color));
+    }
+}
+
+void Mesh::writeIndices(void *dst) const {
+    if (indexType == vk::IndexType::eUint32) {
+        std::memcpy(dst, indices.data(), sizeof(uint32_t) * indices.size());
+        return;
+    }
+
+    auto packed = static_cast<uint16_t *>(dst);
+    for (size_t i = 0; i < indices.size(); i++) {
+        packed[i] = static_cast<uint16_t>(indices[i]);
+    }
 }
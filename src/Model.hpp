@@ -1,38 +1,157 @@
 #pragma once
 
+#include <cstddef>
+#include <span>
+#include <string>
 #include <vector>
 #include <glm/glm.hpp>
 #include <vulkan/vulkan.hpp>
 
+enum class VertexLayout {
+    eFull,       // Vertex, 48 bytes
+    eQuantized,  // QuantizedVertex, 20 bytes
+};
+
+// Positions are unorm16 inside the mesh bounds and need Mesh::dequantization
+// applied, normals are octahedral snorm16, uvs are half floats.
+struct QuantizedVertex {
+    uint16_t pos[4];
+    int16_t normal[2];
+    uint16_t uv[2];
+    uint8_t color[4];
+};
+
+enum class VertexStreams {
+    eInterleaved,    // one binding with every attribute
+    eSplitPosition,  // binding 0 holds positions, binding 1 everything else
+};
+
 struct Vertex {
     glm::vec3 pos;
     glm::vec3 normal;
     glm::vec2 uv;
     glm::vec4 color;
 
-    static std::array<vk::VertexInputAttributeDescription, 4>
-    getAttributeDescriptions() {
-        return {
-            vk::VertexInputAttributeDescription(
-                0, 0, vk::Format::eR32G32B32Sfloat, offsetof(Vertex, pos)),
-            vk::VertexInputAttributeDescription(
-                1, 0, vk::Format::eR32G32B32Sfloat, offsetof(Vertex, normal)),
-            vk::VertexInputAttributeDescription(2, 0, vk::Format::eR32G32Sfloat,
-                                                offsetof(Vertex, uv)),
-            vk::VertexInputAttributeDescription(
-                3, 0, vk::Format::eR32G32B32A32Sfloat, offsetof(Vertex, color)),
-        };
-    }
+    // With split streams a position only pass binds just binding 0 and
+    // fetches 12 (or 8 quantized) bytes per vertex
+    static std::vector<vk::VertexInputAttributeDescription>
+    getAttributeDescriptions(
+        VertexLayout layout = VertexLayout::eFull,
+        VertexStreams streams = VertexStreams::eInterleaved,
+        bool positionOnly = false);
+    static std::vector<vk::VertexInputBindingDescription>
+    getBindingDescriptions(VertexLayout layout = VertexLayout::eFull,
+                           VertexStreams streams = VertexStreams::eInterleaved,
+                           bool positionOnly = false);
 
-    static vk::VertexInputBindingDescription getBindingDescription() {
-        return vk::VertexInputBindingDescription(0, sizeof(Vertex),
-                                                 vk::VertexInputRate::eVertex);
+    // Per instance stream of one uint32 object index for instanced draws, it
+    // goes in the binding after the vertex streams
+    static vk::VertexInputBindingDescription getInstanceBindingDescription(
+        uint32_t binding);
+    static vk::VertexInputAttributeDescription getInstanceAttributeDescription(
+        uint32_t binding);
+
+    // Position is the leading member of both layouts, so the attribute stream
+    // is simply the remainder of each vertex
+    static inline uint32_t getStride(VertexLayout layout) {
+        return layout == VertexLayout::eQuantized ? sizeof(QuantizedVertex)
+                                                  : sizeof(Vertex);
+    }
+    static inline uint32_t getPositionStride(VertexLayout layout) {
+        return layout == VertexLayout::eQuantized
+                   ? offsetof(QuantizedVertex, normal)
+                   : offsetof(Vertex, normal);
     }
 };
 
+// Past the four vertex attributes so every pass can use the same location
+const uint32_t INSTANCE_ATTRIBUTE_LOCATION = 4;
+
+struct MeshLod {
+    uint32_t firstIndex;
+    uint32_t indexCount;
+
+    // Largest deviation from LOD 0, in model units
+    float error;
+};
+
+// Limits that fit the common mesh shader output sizes. 124 triangles keeps
+// the primitive indices of a meshlet within 372 bytes.
+constexpr uint32_t MESHLET_MAX_VERTICES = 64;
+constexpr uint32_t MESHLET_MAX_TRIANGLES = 124;
+
+// A cluster of LOD 0 triangles, drawable on its own as an index range
+struct Meshlet {
+    // Model space center and radius
+    glm::vec4 boundingSphere;
+
+    // Normal cone for backface culling of the whole cluster. coneCutoff is
+    // the sine of the cone's half angle, 1 when the cone cannot be culled.
+    glm::vec3 coneAxis;
+    float coneCutoff;
+
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    uint32_t vertexCount;
+};
+
 struct Mesh {
     std::vector<Vertex> vertices;
-    std::vector<uint16_t> indices;
+
+    // Indices stay 32-bit on the CPU side, indexType is the narrowest width
+    // able to address every vertex and is what gets uploaded and drawn with
+    std::vector<uint32_t> indices;
+    vk::IndexType indexType = vk::IndexType::eUint16;
+
+    // Every LOD is a range of indices, LOD 0 is the full resolution mesh and
+    // always first. All of them index the same vertices.
+    std::vector<MeshLod> lods;
+
+    // Model space center and radius
+    glm::vec4 boundingSphere = glm::vec4(0.0f);
+
+    // Empty unless requested through ModelImportOptions
+    std::vector<Meshlet> meshlets;
+
+    // Filled by quantize(). dequantization maps the unorm positions back to
+    // model space and is meant to be folded into the model matrix.
+    std::vector<QuantizedVertex> quantizedVertices;
+    glm::mat4 dequantization = glm::mat4(1.0f);
+
+    void updateIndexType();
+    void writeIndices(void* dst) const;
+    void quantize();
+    void resetLods();
+    void updateBounds();
+
+    // Picks the coarsest LOD whose error projects to at most maxPixelError.
+    // pixelsPerUnit is the size in pixels of one unit at distance one, i.e.
+    // proj[1][1] * viewportHeight / 2.
+    uint32_t selectLod(const glm::mat4& model, const glm::vec3& cameraPos,
+                       float pixelsPerUnit, float maxPixelError = 1.0f) const;
+
+    // De-interleaves into the two VertexStreams::eSplitPosition buffers
+    void writeVertexStreams(VertexLayout layout, void* positions,
+                            void* attributes) const;
+
+    inline std::span<const std::byte> getVertexData(
+        VertexLayout layout = VertexLayout::eFull) const {
+        if (layout == VertexLayout::eQuantized) {
+            return std::as_bytes(std::span(quantizedVertices));
+        }
+        return std::as_bytes(std::span(vertices));
+    }
+
+    inline uint32_t getIndexSize() const {
+        return indexType == vk::IndexType::eUint16 ? sizeof(uint16_t)
+                                                   : sizeof(uint32_t);
+    }
+};
+
+struct ModelImportOptions {
+    bool buildMeshlets = false;
+    uint32_t maxMeshletVertices = MESHLET_MAX_VERTICES;
+    uint32_t maxMeshletTriangles = MESHLET_MAX_TRIANGLES;
 };
 
 struct Model {
@@ -40,14 +159,22 @@ struct Model {
 
     Mesh mesh;
 
-    void loadFromFile(std::string fileName);
+    // Imports through assimp on first use and from the binary mesh cache in
+    // CACHE_DIR afterwards. The options are part of the cache key.
+    void loadFromFile(std::string fileName,
+                      const ModelImportOptions& options = {});
     void createPlane();
     void createCube();
 
-    inline uint32_t getTotalVerticesSize() const {
-        return sizeof(Vertex) * mesh.vertices.size();
+    inline uint32_t getTotalVerticesSize(
+        VertexLayout layout = VertexLayout::eFull) const {
+        return static_cast<uint32_t>(mesh.getVertexData(layout).size());
     }
     inline uint32_t getTotalIndicesSize() const {
-        return sizeof(uint16_t) * mesh.indices.size();
+        return mesh.getIndexSize() * mesh.indices.size();
     }
+
+   private:
+    void importMesh(std::span<const std::byte> fileData, std::string extension,
+                    const ModelImportOptions& options);
 };
\ No newline at end of file
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <array>
+#include <glm/glm.hpp>
+
+namespace Engine {
+// Six planes with inward facing normals, ax + by + cz + d >= 0 is inside
+struct Frustum {
+    enum Plane { eLeft, eRight, eBottom, eTop, eNear, eFar };
+
+    std::array<glm::vec4, 6> planes;
+
+    // Gribb/Hartmann extraction for a [0, 1] depth range, the planes come
+    // out in whatever space viewProj transforms from
+    static Frustum fromMatrix(const glm::mat4& viewProj) {
+        auto row = [&](int i) {
+            return glm::vec4(viewProj[0][i], viewProj[1][i], viewProj[2][i],
+                             viewProj[3][i]);
+        };
+
+        Frustum frustum;
+        frustum.planes[eLeft] = row(3) + row(0);
+        frustum.planes[eRight] = row(3) - row(0);
+        frustum.planes[eBottom] = row(3) + row(1);
+        frustum.planes[eTop] = row(3) - row(1);
+        frustum.planes[eNear] = row(2);
+        frustum.planes[eFar] = row(3) - row(2);
+        for (auto& plane : frustum.planes) {
+            plane /= glm::length(glm::vec3(plane));
+        }
+        return frustum;
+    }
+
+    bool intersectsSphere(const glm::vec3& center, float radius) const {
+        for (const auto& plane : planes) {
+            if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+}  // namespace Engine
@@ -0,0 +1,270 @@
+#include "core/FrustumCuller.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || \
+    defined(_M_IX86)
+#define CULLER_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// MSVC compiles AVX2 intrinsics anywhere, GCC and Clang need the function
+// marked so the rest of the file stays at the baseline ISA
+#if defined(CULLER_X86) && (defined(__GNUC__) || defined(__clang__))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_AVX2
+#endif
+
+namespace Engine {
+namespace {
+constexpr uint32_t LANE_PADDING = 8;
+
+enum class SimdLevel { eScalar, eSse, eAvx2 };
+
+struct SoaBounds {
+    const float* centerX;
+    const float* centerY;
+    const float* centerZ;
+    const float* extentX;
+    const float* extentY;
+    const float* extentZ;
+    const float* radius;
+    uint32_t count;
+};
+
+SimdLevel detectSimdLevel() {
+#if defined(CULLER_X86)
+#if defined(_MSC_VER)
+    // AVX2 needs the CPU bit and the OS saving the ymm registers
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] >= 7) {
+        __cpuid(info, 1);
+        bool osxsave = (info[2] & (1 << 27)) != 0;
+        bool avx = (info[2] & (1 << 28)) != 0;
+        __cpuidex(info, 7, 0);
+        bool avx2 = (info[1] & (1 << 5)) != 0;
+        if (osxsave && avx && avx2 && (_xgetbv(0) & 0x6) == 0x6) {
+            return SimdLevel::eAvx2;
+        }
+    }
+#else
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return SimdLevel::eAvx2;
+    }
+#endif
+    return SimdLevel::eSse;
+#else
+    return SimdLevel::eScalar;
+#endif
+}
+
+const SimdLevel simdLevel = detectSimdLevel();
+
+void appendVisible(uint32_t mask, uint32_t base, uint32_t count,
+                   std::vector<uint32_t>& visible) {
+    while (mask != 0) {
+        uint32_t index = base + std::countr_zero(mask);
+        if (index < count) {
+            visible.push_back(index);
+        }
+        mask &= mask - 1;
+    }
+}
+
+// An object is outside a plane when its signed distance is below minus the
+// smaller of its sphere radius and the AABB's projected radius
+void cullScalar(const Frustum& frustum, const SoaBounds& bounds,
+                std::vector<uint32_t>& visible) {
+    for (uint32_t i = 0; i < bounds.count; i++) {
+        bool inside = true;
+        for (const auto& plane : frustum.planes) {
+            float distance = plane.x * bounds.centerX[i] +
+                             plane.y * bounds.centerY[i] +
+                             plane.z * bounds.centerZ[i] + plane.w;
+            float boxRadius = std::abs(plane.x) * bounds.extentX[i] +
+                              std::abs(plane.y) * bounds.extentY[i] +
+                              std::abs(plane.z) * bounds.extentZ[i];
+            if (distance < -std::min(bounds.radius[i], boxRadius)) {
+                inside = false;
+                break;
+            }
+        }
+        if (inside) {
+            visible.push_back(i);
+        }
+    }
+}
+
+#if defined(CULLER_X86)
+void cullSse(const Frustum& frustum, const SoaBounds& bounds,
+             std::vector<uint32_t>& visible) {
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+
+    for (uint32_t i = 0; i < bounds.count; i += 4) {
+        __m128 centerX = _mm_loadu_ps(bounds.centerX + i);
+        __m128 centerY = _mm_loadu_ps(bounds.centerY + i);
+        __m128 centerZ = _mm_loadu_ps(bounds.centerZ + i);
+        __m128 extentX = _mm_loadu_ps(bounds.extentX + i);
+        __m128 extentY = _mm_loadu_ps(bounds.extentY + i);
+        __m128 extentZ = _mm_loadu_ps(bounds.extentZ + i);
+        __m128 radius = _mm_loadu_ps(bounds.radius + i);
+
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (const auto& plane : frustum.planes) {
+            __m128 normalX = _mm_set1_ps(plane.x);
+            __m128 normalY = _mm_set1_ps(plane.y);
+            __m128 normalZ = _mm_set1_ps(plane.z);
+
+            __m128 distance = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(normalX, centerX),
+                           _mm_mul_ps(normalY, centerY)),
+                _mm_add_ps(_mm_mul_ps(normalZ, centerZ),
+                           _mm_set1_ps(plane.w)));
+            __m128 boxRadius = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(_mm_andnot_ps(signMask, normalX),
+                                      extentX),
+                           _mm_mul_ps(_mm_andnot_ps(signMask, normalY),
+                                      extentY)),
+                _mm_mul_ps(_mm_andnot_ps(signMask, normalZ), extentZ));
+            __m128 limit = _mm_xor_ps(_mm_min_ps(radius, boxRadius), signMask);
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, limit));
+        }
+
+        appendVisible(_mm_movemask_ps(inside), i, bounds.count, visible);
+    }
+}
+
+TARGET_AVX2 void cullAvx2(const Frustum& frustum, const SoaBounds& bounds,
+                          std::vector<uint32_t>& visible) {
+    const __m256 signMask = _mm256_set1_ps(-0.0f);
+
+    for (uint32_t i = 0; i < bounds.count; i += 8) {
+        __m256 centerX = _mm256_loadu_ps(bounds.centerX + i);
+        __m256 centerY = _mm256_loadu_ps(bounds.centerY + i);
+        __m256 centerZ = _mm256_loadu_ps(bounds.centerZ + i);
+        __m256 extentX = _mm256_loadu_ps(bounds.extentX + i);
+        __m256 extentY = _mm256_loadu_ps(bounds.extentY + i);
+        __m256 extentZ = _mm256_loadu_ps(bounds.extentZ + i);
+        __m256 radius = _mm256_loadu_ps(bounds.radius + i);
+
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (const auto& plane : frustum.planes) {
+            __m256 normalX = _mm256_set1_ps(plane.x);
+            __m256 normalY = _mm256_set1_ps(plane.y);
+            __m256 normalZ = _mm256_set1_ps(plane.z);
+
+            __m256 distance = _mm256_add_ps(
+                _mm256_add_ps(_mm256_mul_ps(normalX, centerX),
+                              _mm256_mul_ps(normalY, centerY)),
+                _mm256_add_ps(_mm256_mul_ps(normalZ, centerZ),
+                              _mm256_set1_ps(plane.w)));
+            __m256 boxRadius = _mm256_add_ps(
+                _mm256_add_ps(
+                    _mm256_mul_ps(_mm256_andnot_ps(signMask, normalX),
+                                  extentX),
+                    _mm256_mul_ps(_mm256_andnot_ps(signMask, normalY),
+                                  extentY)),
+                _mm256_mul_ps(_mm256_andnot_ps(signMask, normalZ), extentZ));
+            __m256 limit =
+                _mm256_xor_ps(_mm256_min_ps(radius, boxRadius), signMask);
+            inside = _mm256_and_ps(inside,
+                                   _mm256_cmp_ps(distance, limit, _CMP_GE_OQ));
+        }
+
+        appendVisible(_mm256_movemask_ps(inside), i, bounds.count, visible);
+    }
+}
+#endif
+}  // namespace
+
+FrustumCuller::FrustumCuller() { resize(0); }
+
+void FrustumCuller::resize(uint32_t count) {
+    this->count = count;
+
+    size_t padded = (count + LANE_PADDING - 1) / LANE_PADDING * LANE_PADDING;
+    for (auto* array : {&centerX, &centerY, &centerZ, &extentX, &extentY,
+                        &extentZ, &radius}) {
+        array->resize(std::max<size_t>(padded, LANE_PADDING), 0.0f);
+    }
+}
+
+void FrustumCuller::setBounds(uint32_t index, const glm::vec3& center,
+                              const glm::vec3& extent, float radius) {
+    centerX[index] = center.x;
+    centerY[index] = center.y;
+    centerZ[index] = center.z;
+    extentX[index] = extent.x;
+    extentY[index] = extent.y;
+    extentZ[index] = extent.z;
+    this->radius[index] = radius;
+}
+
+void FrustumCuller::setTransformedSphere(uint32_t index,
+                                         const glm::vec4& sphere,
+                                         const glm::mat4& transform) {
+    glm::vec3 center =
+        glm::vec3(transform * glm::vec4(glm::vec3(sphere), 1.0f));
+
+    // The sphere's cube through the absolute linear part (Arvo), and the
+    // sphere itself scaled by the largest axis
+    glm::vec3 extent(0.0f);
+    float maxScale = 0.0f;
+    for (int axis = 0; axis < 3; axis++) {
+        glm::vec3 column = glm::vec3(transform[axis]);
+        extent += glm::abs(column) * sphere.w;
+        maxScale = std::max(maxScale, glm::length(column));
+    }
+
+    setBounds(index, center, extent, sphere.w * maxScale);
+}
+
+void FrustumCuller::cull(const Frustum& frustum,
+                         std::vector<uint32_t>& visible) const {
+    visible.clear();
+
+    SoaBounds bounds{
+        .centerX = centerX.data(),
+        .centerY = centerY.data(),
+        .centerZ = centerZ.data(),
+        .extentX = extentX.data(),
+        .extentY = extentY.data(),
+        .extentZ = extentZ.data(),
+        .radius = radius.data(),
+        .count = count,
+    };
+
+    switch (simdLevel) {
+#if defined(CULLER_X86)
+        case SimdLevel::eAvx2:
+            cullAvx2(frustum, bounds, visible);
+            break;
+        case SimdLevel::eSse:
+            cullSse(frustum, bounds, visible);
+            break;
+#endif
+        default:
+            cullScalar(frustum, bounds, visible);
+            break;
+    }
+}
+
+const char* FrustumCuller::getSimdName() const {
+    switch (simdLevel) {
+        case SimdLevel::eAvx2:
+            return "avx2";
+        case SimdLevel::eSse:
+            return "sse";
+        default:
+            return "scalar";
+    }
+}
+}  // namespace Engine
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "core/Frustum.hpp"
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace Engine {
+// World space bounds of many objects in SoA arrays, culled against a
+// frustum 8 (AVX2) or 4 (SSE) objects at a time. Slot i belongs to
+// object i. Every object keeps an AABB and a bounding sphere, and it is
+// culled when either of them is outside one of the planes.
+class FrustumCuller {
+   public:
+    FrustumCuller();
+
+    void resize(uint32_t count);
+    uint32_t size() const { return count; }
+
+    void setBounds(uint32_t index, const glm::vec3& center,
+                   const glm::vec3& extent, float radius);
+
+    // Derives both bounds from an object space sphere and its transform
+    void setTransformedSphere(uint32_t index, const glm::vec4& sphere,
+                              const glm::mat4& transform);
+
+    // Replaces visible with the ascending indices of the objects that
+    // intersect the frustum
+    void cull(const Frustum& frustum, std::vector<uint32_t>& visible) const;
+
+    // "avx2", "sse" or "scalar", picked once from the running CPU
+    const char* getSimdName() const;
+
+   private:
+    uint32_t count = 0;
+
+    // Padded to a multiple of 8, the padding is never reported visible
+    std::vector<float> centerX, centerY, centerZ;
+    std::vector<float> extentX, extentY, extentZ;
+    std::vector<float> radius;
+};
+}  // namespace Engine
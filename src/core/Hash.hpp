@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace Engine {
+constexpr uint64_t HASH_SEED = 14695981039346656037ull;
+
+// 64-bit FNV-1a. Cheap and stable across runs, which is all the on-disk caches
+// need to detect a changed source file.
+inline uint64_t hashBytes(std::span<const std::byte> bytes,
+                          uint64_t seed = HASH_SEED) {
+    uint64_t hash = seed;
+    for (auto byte : bytes) {
+        hash ^= static_cast<uint64_t>(byte);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+template <typename T>
+inline uint64_t hashValue(const T& value, uint64_t seed = HASH_SEED) {
+    return hashBytes(std::as_bytes(std::span<const T>(&value, 1)), seed);
+}
+}  // namespace Engine
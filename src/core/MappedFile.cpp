@@ -0,0 +1,141 @@
+#include "core/MappedFile.hpp"
+
+#include <stdexcept>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Engine {
+MappedFile::MappedFile(MappedFile&& other) noexcept {
+    *this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        close();
+        mapped = std::exchange(other.mapped, nullptr);
+        size = std::exchange(other.size, 0);
+        opened = std::exchange(other.opened, false);
+#ifdef _WIN32
+        fileHandle = std::exchange(other.fileHandle, nullptr);
+        mappingHandle = std::exchange(other.mappingHandle, nullptr);
+#endif
+    }
+    return *this;
+}
+
+#ifdef _WIN32
+void MappedFile::open(const std::string& filename) {
+    close();
+
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                              nullptr, OPEN_EXISTING,
+                              FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("failed to open file");
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize)) {
+        CloseHandle(file);
+        throw std::runtime_error("failed to query file size");
+    }
+
+    fileHandle = file;
+    size = static_cast<size_t>(fileSize.QuadPart);
+    opened = true;
+
+    // Mapping a zero-length file is an error on Windows, an empty span is not
+    if (size == 0) {
+        return;
+    }
+
+    HANDLE mapping =
+        CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr) {
+        close();
+        throw std::runtime_error("failed to map file");
+    }
+    mappingHandle = mapping;
+
+    mapped = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (mapped == nullptr) {
+        close();
+        throw std::runtime_error("failed to map file");
+    }
+}
+
+void MappedFile::close() {
+    if (mapped) {
+        UnmapViewOfFile(mapped);
+    }
+    if (mappingHandle) {
+        CloseHandle(mappingHandle);
+    }
+    if (fileHandle) {
+        CloseHandle(fileHandle);
+    }
+
+    mapped = nullptr;
+    mappingHandle = nullptr;
+    fileHandle = nullptr;
+    size = 0;
+    opened = false;
+}
+#else
+void MappedFile::open(const std::string& filename) {
+    close();
+
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("failed to open file");
+    }
+
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0) {
+        ::close(fd);
+        throw std::runtime_error("failed to query file size");
+    }
+
+    size = static_cast<size_t>(fileStat.st_size);
+    opened = true;
+
+    // mmap rejects zero-length mappings, an empty span is fine for callers
+    if (size == 0) {
+        ::close(fd);
+        return;
+    }
+
+    void* view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping keeps its own reference to the file
+    ::close(fd);
+
+    if (view == MAP_FAILED) {
+        size = 0;
+        opened = false;
+        throw std::runtime_error("failed to map file");
+    }
+
+    madvise(view, size, MADV_SEQUENTIAL);
+    mapped = view;
+}
+
+void MappedFile::close() {
+    if (mapped) {
+        munmap(mapped, size);
+    }
+
+    mapped = nullptr;
+    size = 0;
+    opened = false;
+}
+#endif
+}  // namespace Engine
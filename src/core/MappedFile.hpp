@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+#include <string>
+
+namespace Engine {
+// Read-only memory mapping of a whole file. The span returned by data() points
+// straight into the page cache and stays valid until close() or destruction.
+class MappedFile {
+   public:
+    MappedFile() = default;
+    explicit MappedFile(const std::string& filename) { open(filename); }
+    ~MappedFile() { close(); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    void open(const std::string& filename);
+    void close();
+
+    inline bool isOpen() const { return opened; }
+    inline size_t getSize() const { return size; }
+    inline std::span<const std::byte> data() const {
+        return {static_cast<const std::byte*>(mapped), size};
+    }
+
+   private:
+    void* mapped = nullptr;
+    size_t size = 0;
+    bool opened = false;
+
+#ifdef _WIN32
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+#endif
+};
+}  // namespace Engine
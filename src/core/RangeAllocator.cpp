@@ -0,0 +1,102 @@
+#include "core/RangeAllocator.hpp"
+
+#include <iterator>
+#include <stdexcept>
+
+namespace Engine {
+void RangeAllocator::init(uint64_t size) {
+    this->size = size;
+    usedSize = 0;
+    freeByOffset.clear();
+    freeBySize.clear();
+    allocations.clear();
+
+    if (size > 0) {
+        insertFreeRange(0, size);
+    }
+}
+
+std::optional<uint64_t> RangeAllocator::allocate(uint64_t size,
+                                                 uint64_t alignment) {
+    if (size == 0) {
+        return std::nullopt;
+    }
+
+    // Smallest free range first, alignment padding can push a candidate
+    // over so keep walking up until one fits
+    for (auto it = freeBySize.lower_bound(size); it != freeBySize.end();
+         ++it) {
+        uint64_t rangeOffset = it->second;
+        uint64_t rangeSize = it->first;
+        uint64_t alignedOffset =
+            (rangeOffset + alignment - 1) & ~(alignment - 1);
+        uint64_t padding = alignedOffset - rangeOffset;
+        if (padding + size > rangeSize) {
+            continue;
+        }
+
+        eraseFreeRange(freeByOffset.find(rangeOffset));
+
+        // The padding in front stays free, only the tail is split off
+        if (padding > 0) {
+            insertFreeRange(rangeOffset, padding);
+        }
+        if (padding + size < rangeSize) {
+            insertFreeRange(alignedOffset + size, rangeSize - padding - size);
+        }
+
+        allocations[alignedOffset] = size;
+        usedSize += size;
+        return alignedOffset;
+    }
+
+    return std::nullopt;
+}
+
+void RangeAllocator::free(uint64_t offset) {
+    auto allocation = allocations.find(offset);
+    if (allocation == allocations.end()) {
+        throw std::runtime_error("freeing an unallocated range");
+    }
+
+    uint64_t rangeOffset = offset;
+    uint64_t rangeSize = allocation->second;
+    usedSize -= rangeSize;
+    allocations.erase(allocation);
+
+    auto next = freeByOffset.lower_bound(rangeOffset);
+    if (next != freeByOffset.end() && next->first == rangeOffset + rangeSize) {
+        rangeSize += next->second;
+        next = std::next(next);
+        eraseFreeRange(std::prev(next));
+    }
+
+    if (next != freeByOffset.begin()) {
+        auto previous = std::prev(next);
+        if (previous->first + previous->second == rangeOffset) {
+            rangeOffset = previous->first;
+            rangeSize += previous->second;
+            eraseFreeRange(previous);
+        }
+    }
+
+    insertFreeRange(rangeOffset, rangeSize);
+}
+
+void RangeAllocator::insertFreeRange(uint64_t offset, uint64_t size) {
+    freeByOffset.emplace(offset, size);
+    freeBySize.emplace(size, offset);
+}
+
+void RangeAllocator::eraseFreeRange(
+    std::map<uint64_t, uint64_t>::iterator it) {
+    auto [begin, end] = freeBySize.equal_range(it->second);
+    for (auto sizeIt = begin; sizeIt != end; ++sizeIt) {
+        if (sizeIt->second == it->first) {
+            freeBySize.erase(sizeIt);
+            break;
+        }
+    }
+    freeByOffset.erase(it);
+}
+}  // namespace Engine
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <unordered_map>
+
+namespace Engine {
+// Best fit free-list allocator over an abstract [0, size) range. It only
+// hands out offsets, the memory itself lives elsewhere (e.g. a GPU buffer).
+// Freed ranges are merged with their free neighbours right away.
+class RangeAllocator {
+   public:
+    RangeAllocator() = default;
+    explicit RangeAllocator(uint64_t size) { init(size); }
+
+    void init(uint64_t size);
+
+    // Returns the offset of the new range, or nothing when no free range is
+    // large enough. alignment must be a power of two.
+    std::optional<uint64_t> allocate(uint64_t size, uint64_t alignment = 1);
+    void free(uint64_t offset);
+
+    inline uint64_t getSize() const { return size; }
+    inline uint64_t getUsedSize() const { return usedSize; }
+    inline size_t getFreeRangeCount() const { return freeByOffset.size(); }
+
+   private:
+    uint64_t size = 0;
+    uint64_t usedSize = 0;
+
+    std::map<uint64_t, uint64_t> freeByOffset;
+    std::multimap<uint64_t, uint64_t> freeBySize;
+
+    // Aligned offset to requested size, the padding in front went back to
+    // the free ranges
+    std::unordered_map<uint64_t, uint64_t> allocations;
+
+    void insertFreeRange(uint64_t offset, uint64_t size);
+    void eraseFreeRange(std::map<uint64_t, uint64_t>::iterator it);
+};
+}  // namespace Engine
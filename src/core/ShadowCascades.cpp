@@ -0,0 +1,67 @@
+#include "core/ShadowCascades.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace Engine {
+std::vector<float> computeCascadeSplits(uint32_t cascadeCount, float near,
+                                        float far, float lambda) {
+    std::vector<float> splits(cascadeCount);
+    for (uint32_t i = 0; i < cascadeCount; i++) {
+        float p = float(i + 1) / cascadeCount;
+        float logSplit = near * std::pow(far / near, p);
+        float uniformSplit = near + (far - near) * p;
+        splits[i] = lambda * logSplit + (1.0f - lambda) * uniformSplit;
+    }
+    return splits;
+}
+
+glm::mat4 fitShadowCascade(const CascadeCamera& camera, float splitNear,
+                           float splitFar, const glm::vec3& lightDir,
+                           uint32_t resolution, float casterDistance) {
+    // Corners of the slice in world space
+    auto invView = glm::inverse(camera.view);
+    float tanHalfFov = std::tan(camera.fovY * 0.5f);
+    std::array<glm::vec3, 8> corners;
+    for (int i = 0; i < 8; i++) {
+        float distance = (i & 4) ? splitFar : splitNear;
+        float y = distance * tanHalfFov * ((i & 2) ? 1.0f : -1.0f);
+        float x = y * camera.aspect * ((i & 1) ? 1.0f : -1.0f);
+        corners[i] = glm::vec3(invView * glm::vec4(x, y, -distance, 1.0f));
+    }
+
+    glm::vec3 center(0.0f);
+    for (const auto& corner : corners) {
+        center += corner;
+    }
+    center /= float(corners.size());
+    float radius = 0.0f;
+    for (const auto& corner : corners) {
+        radius = std::max(radius, glm::length(corner - center));
+    }
+    // Rounded up so the size stays put under float noise
+    radius = std::ceil(radius * 16.0f) / 16.0f;
+
+    auto direction = glm::normalize(lightDir);
+    auto up = std::abs(direction.z) > 0.99f ? glm::vec3(0.0f, 1.0f, 0.0f)
+                                            : glm::vec3(0.0f, 0.0f, 1.0f);
+    auto lightView = glm::lookAt(
+        center - direction * (radius + casterDistance), center, up);
+    auto lightProj = glm::ortho(-radius, radius, -radius, radius, 0.0f,
+                                2.0f * radius + casterDistance);
+    lightProj[1][1] *= -1;
+
+    // Shifts the projection so the world origin lands on a texel corner,
+    // every other point then moves in whole texels as well
+    glm::vec4 origin = lightProj * lightView * glm::vec4(0, 0, 0, 1);
+    glm::vec2 texelOrigin = glm::vec2(origin) * (resolution * 0.5f);
+    glm::vec2 offset = (glm::round(texelOrigin) - texelOrigin) *
+                       (2.0f / resolution);
+    lightProj[3][0] += offset.x;
+    lightProj[3][1] += offset.y;
+
+    return lightProj * lightView;
+}
+}  // namespace Engine
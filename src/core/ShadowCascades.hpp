@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace Engine {
+constexpr uint32_t MAX_SHADOW_CASCADES = 4;
+
+// Perspective camera the cascades are fitted to, view is its world to view
+// transform
+struct CascadeCamera {
+    glm::mat4 view;
+    float fovY;
+    float aspect;
+};
+
+// Far distance of each cascade along the view direction. The practical
+// split scheme blends the logarithmic splits (lambda 1), which keep the
+// texel to pixel ratio even, with uniform ones (lambda 0), which do not
+// crowd every cascade right in front of the camera.
+std::vector<float> computeCascadeSplits(uint32_t cascadeCount, float near,
+                                        float far, float lambda);
+
+// Light view projection of the slice [splitNear, splitFar] of the camera
+// frustum for a directional light shining along lightDir. The projection
+// covers the bounding sphere of the slice, so its size does not change as
+// the camera turns, and its origin is snapped to whole shadow map texels,
+// so moving the camera does not make the edges shimmer. casterDistance
+// pulls the near plane towards the light for casters outside the slice.
+// Y is flipped like the camera projections.
+glm::mat4 fitShadowCascade(const CascadeCamera& camera, float splitNear,
+                           float splitFar, const glm::vec3& lightDir,
+                           uint32_t resolution, float casterDistance);
+}  // namespace Engine
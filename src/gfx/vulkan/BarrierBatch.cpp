@@ -0,0 +1,80 @@
+#include "gfx/vulkan/BarrierBatch.hpp"
+
+namespace Engine {
+BarrierBatch& BarrierBatch::addImage(vk::Image image,
+                                     const vk::ImageSubresourceRange& range,
+                                     vk::PipelineStageFlags2 srcStageMask,
+                                     vk::AccessFlags2 srcAccessMask,
+                                     vk::PipelineStageFlags2 dstStageMask,
+                                     vk::AccessFlags2 dstAccessMask,
+                                     vk::ImageLayout oldLayout,
+                                     vk::ImageLayout newLayout) {
+    imageBarriers.push_back({
+        .srcStageMask = srcStageMask,
+        .srcAccessMask = srcAccessMask,
+        .dstStageMask = dstStageMask,
+        .dstAccessMask = dstAccessMask,
+        .oldLayout = oldLayout,
+        .newLayout = newLayout,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = image,
+        .subresourceRange = range,
+    });
+    return *this;
+}
+
+BarrierBatch& BarrierBatch::addBuffer(vk::Buffer buffer,
+                                      vk::PipelineStageFlags2 srcStageMask,
+                                      vk::AccessFlags2 srcAccessMask,
+                                      vk::PipelineStageFlags2 dstStageMask,
+                                      vk::AccessFlags2 dstAccessMask,
+                                      vk::DeviceSize offset,
+                                      vk::DeviceSize size) {
+    bufferBarriers.push_back({
+        .srcStageMask = srcStageMask,
+        .srcAccessMask = srcAccessMask,
+        .dstStageMask = dstStageMask,
+        .dstAccessMask = dstAccessMask,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .buffer = buffer,
+        .offset = offset,
+        .size = size,
+    });
+    return *this;
+}
+
+BarrierBatch& BarrierBatch::addMemory(vk::PipelineStageFlags2 srcStageMask,
+                                      vk::AccessFlags2 srcAccessMask,
+                                      vk::PipelineStageFlags2 dstStageMask,
+                                      vk::AccessFlags2 dstAccessMask) {
+    memoryBarriers.push_back({
+        .srcStageMask = srcStageMask,
+        .srcAccessMask = srcAccessMask,
+        .dstStageMask = dstStageMask,
+        .dstAccessMask = dstAccessMask,
+    });
+    return *this;
+}
+
+void BarrierBatch::record(vk::CommandBuffer cmdBuffer) {
+    if (empty()) {
+        return;
+    }
+
+    cmdBuffer.pipelineBarrier2({
+        .memoryBarrierCount = static_cast<uint32_t>(memoryBarriers.size()),
+        .pMemoryBarriers = memoryBarriers.data(),
+        .bufferMemoryBarrierCount =
+            static_cast<uint32_t>(bufferBarriers.size()),
+        .pBufferMemoryBarriers = bufferBarriers.data(),
+        .imageMemoryBarrierCount = static_cast<uint32_t>(imageBarriers.size()),
+        .pImageMemoryBarriers = imageBarriers.data(),
+    });
+
+    memoryBarriers.clear();
+    bufferBarriers.clear();
+    imageBarriers.clear();
+}
+}  // namespace Engine
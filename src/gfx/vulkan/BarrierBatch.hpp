@@ -0,0 +1,58 @@
+#pragma once
+
+#include "gfx/vulkan/VulkanUsage.hpp"
+
+#include <vector>
+
+namespace Engine {
+// Every mip level and array layer of the aspect
+inline vk::ImageSubresourceRange wholeImageRange(vk::ImageAspectFlags aspect) {
+    return {
+        .aspectMask = aspect,
+        .baseMipLevel = 0,
+        .levelCount = VK_REMAINING_MIP_LEVELS,
+        .baseArrayLayer = 0,
+        .layerCount = VK_REMAINING_ARRAY_LAYERS,
+    };
+}
+
+// Collects synchronization2 barriers and records them with a single
+// vkCmdPipelineBarrier2. Each barrier carries its own stage masks, so
+// batching unrelated barriers does not widen any of them.
+class BarrierBatch {
+   public:
+    BarrierBatch& addImage(vk::Image image,
+                           const vk::ImageSubresourceRange& range,
+                           vk::PipelineStageFlags2 srcStageMask,
+                           vk::AccessFlags2 srcAccessMask,
+                           vk::PipelineStageFlags2 dstStageMask,
+                           vk::AccessFlags2 dstAccessMask,
+                           vk::ImageLayout oldLayout,
+                           vk::ImageLayout newLayout);
+    BarrierBatch& addBuffer(vk::Buffer buffer,
+                            vk::PipelineStageFlags2 srcStageMask,
+                            vk::AccessFlags2 srcAccessMask,
+                            vk::PipelineStageFlags2 dstStageMask,
+                            vk::AccessFlags2 dstAccessMask,
+                            vk::DeviceSize offset = 0,
+                            vk::DeviceSize size = vk::WholeSize);
+    BarrierBatch& addMemory(vk::PipelineStageFlags2 srcStageMask,
+                            vk::AccessFlags2 srcAccessMask,
+                            vk::PipelineStageFlags2 dstStageMask,
+                            vk::AccessFlags2 dstAccessMask);
+
+    bool empty() const {
+        return memoryBarriers.empty() && bufferBarriers.empty() &&
+               imageBarriers.empty();
+    }
+
+    // Records every gathered barrier and starts over, an empty batch
+    // records nothing
+    void record(vk::CommandBuffer cmdBuffer);
+
+   private:
+    std::vector<vk::MemoryBarrier2> memoryBarriers;
+    std::vector<vk::BufferMemoryBarrier2> bufferBarriers;
+    std::vector<vk::ImageMemoryBarrier2> imageBarriers;
+};
+}  // namespace Engine
@@ -0,0 +1,254 @@
+#include "gfx/vulkan/DepthPyramid.hpp"
+#include "gfx/vulkan/BarrierBatch.hpp"
+#include "gfx/vulkan/Device.hpp"
+#include "gfx/vulkan/Pipeline.hpp"
+#include "gfx/vulkan/Utils.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <glm/glm.hpp>
+
+namespace Engine {
+namespace {
+constexpr uint32_t MAX_PYRAMID_LEVELS = 16;
+constexpr uint32_t GROUP_SIZE = 8;
+
+struct PyramidPushConstant {
+    glm::vec2 size;
+};
+}  // namespace
+
+void DepthPyramid::init(Device* device) {
+    this->device = device;
+    supported = device->getEnabledFeatures12().samplerFilterMinmax;
+
+    auto logicalDevice = device->getLogicalDevice();
+
+    vk::SamplerReductionModeCreateInfo reductionCI{
+        .reductionMode = vk::SamplerReductionMode::eMax,
+    };
+    reductionSampler = logicalDevice.createSampler({
+        .pNext = supported ? &reductionCI : nullptr,
+        .magFilter = vk::Filter::eLinear,
+        .minFilter = vk::Filter::eLinear,
+        .mipmapMode = vk::SamplerMipmapMode::eNearest,
+        .addressModeU = vk::SamplerAddressMode::eClampToEdge,
+        .addressModeV = vk::SamplerAddressMode::eClampToEdge,
+        .addressModeW = vk::SamplerAddressMode::eClampToEdge,
+        .minLod = 0.0f,
+        .maxLod = static_cast<float>(MAX_PYRAMID_LEVELS),
+    });
+
+    vk::DescriptorSetLayoutBinding bindings[2] = {
+        {
+            .binding = 0,
+            .descriptorType = vk::DescriptorType::eCombinedImageSampler,
+            .descriptorCount = 1,
+            .stageFlags = vk::ShaderStageFlagBits::eCompute,
+        },
+        {
+            .binding = 1,
+            .descriptorType = vk::DescriptorType::eStorageImage,
+            .descriptorCount = 1,
+            .stageFlags = vk::ShaderStageFlagBits::eCompute,
+        },
+    };
+    descriptorSetLayout = logicalDevice.createDescriptorSetLayout(
+        {.bindingCount = 2, .pBindings = bindings});
+
+    // One set per level, reallocated on every resize
+    std::vector<vk::DescriptorPoolSize> poolSizes{
+        {
+            .type = vk::DescriptorType::eCombinedImageSampler,
+            .descriptorCount = MAX_PYRAMID_LEVELS,
+        },
+        {
+            .type = vk::DescriptorType::eStorageImage,
+            .descriptorCount = MAX_PYRAMID_LEVELS,
+        },
+    };
+    descriptorPool = logicalDevice.createDescriptorPool({
+        .maxSets = MAX_PYRAMID_LEVELS,
+        .poolSizeCount = static_cast<uint32_t>(poolSizes.size()),
+        .pPoolSizes = poolSizes.data(),
+    });
+
+    vk::PushConstantRange pushConstantRange{
+        .stageFlags = vk::ShaderStageFlagBits::eCompute,
+        .offset = 0,
+        .size = sizeof(PyramidPushConstant),
+    };
+    pipelineLayout = logicalDevice.createPipelineLayout({
+        .setLayoutCount = 1,
+        .pSetLayouts = &descriptorSetLayout,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &pushConstantRange,
+    });
+
+    auto shader = device->createShaderModule("test/depth_pyramid.comp.spv");
+    pipeline = buildComputePipeline(logicalDevice, pipelineLayout, shader);
+    logicalDevice.destroyShaderModule(shader);
+}
+
+void DepthPyramid::destroy() {
+    destroyImage();
+
+    auto logicalDevice = device->getLogicalDevice();
+    logicalDevice.destroyPipeline(pipeline);
+    logicalDevice.destroyPipelineLayout(pipelineLayout);
+    logicalDevice.destroyDescriptorPool(descriptorPool);
+    logicalDevice.destroyDescriptorSetLayout(descriptorSetLayout);
+    logicalDevice.destroySampler(reductionSampler);
+}
+
+void DepthPyramid::destroyImage() {
+    if (mipLevels == 0) {
+        return;
+    }
+
+    auto logicalDevice = device->getLogicalDevice();
+    for (auto view : mipViews) {
+        logicalDevice.destroyImageView(view);
+    }
+    mipViews.clear();
+    descriptorSets.clear();
+    logicalDevice.resetDescriptorPool(descriptorPool);
+    texture.destroy();
+    mipLevels = 0;
+}
+
+void DepthPyramid::resize(const Texture& depthTexture,
+                          vk::Extent2D depthExtent) {
+    destroyImage();
+
+    // Rounding up keeps every level an exact 2x reduction of the previous.
+    // A level 0 texel then covers at most one depth texel, so the 2x2
+    // footprint of its sample always includes every texel under it, right
+    // and bottom edges included. Rounding down would skip texels.
+    extent = {
+        std::max(std::bit_ceil(depthExtent.width), 1u),
+        std::max(std::bit_ceil(depthExtent.height), 1u),
+    };
+    mipLevels = std::min<uint32_t>(
+        std::bit_width(std::max(extent.width, extent.height)),
+        MAX_PYRAMID_LEVELS);
+
+    texture = device->createTexture();
+    texture.mipLevels = mipLevels;
+    texture.allocate(extent, mipLevels, vk::Format::eR32Sfloat,
+                     vk::ImageUsageFlagBits::eStorage |
+                         vk::ImageUsageFlagBits::eSampled,
+                     vk::ImageAspectFlagBits::eColor);
+
+    auto logicalDevice = device->getLogicalDevice();
+    for (uint32_t i = 0; i < mipLevels; i++) {
+        mipViews.push_back(logicalDevice.createImageView({
+            .image = texture.image,
+            .viewType = vk::ImageViewType::e2D,
+            .format = vk::Format::eR32Sfloat,
+            .subresourceRange =
+                {
+                    .aspectMask = vk::ImageAspectFlagBits::eColor,
+                    .baseMipLevel = i,
+                    .levelCount = 1,
+                    .baseArrayLayer = 0,
+                    .layerCount = 1,
+                },
+        }));
+    }
+
+    std::vector<vk::DescriptorSetLayout> setLayouts(mipLevels,
+                                                    descriptorSetLayout);
+    descriptorSets = logicalDevice.allocateDescriptorSets({
+        .descriptorPool = descriptorPool,
+        .descriptorSetCount = mipLevels,
+        .pSetLayouts = setLayouts.data(),
+    });
+
+    // Level i reads level i - 1, level 0 reads the depth buffer
+    for (uint32_t i = 0; i < mipLevels; i++) {
+        vk::DescriptorImageInfo sourceInfo{
+            .sampler = reductionSampler,
+            .imageView = i == 0 ? depthTexture.imageView : mipViews[i - 1],
+            .imageLayout = i == 0 ? vk::ImageLayout::eDepthReadOnlyOptimal
+                                  : vk::ImageLayout::eGeneral,
+        };
+        vk::DescriptorImageInfo destinationInfo{
+            .imageView = mipViews[i],
+            .imageLayout = vk::ImageLayout::eGeneral,
+        };
+
+        std::array<vk::WriteDescriptorSet, 2> writes = {{
+            {
+                .dstSet = descriptorSets[i],
+                .dstBinding = 0,
+                .descriptorCount = 1,
+                .descriptorType = vk::DescriptorType::eCombinedImageSampler,
+                .pImageInfo = &sourceInfo,
+            },
+            {
+                .dstSet = descriptorSets[i],
+                .dstBinding = 1,
+                .descriptorCount = 1,
+                .descriptorType = vk::DescriptorType::eStorageImage,
+                .pImageInfo = &destinationInfo,
+            },
+        }};
+        logicalDevice.updateDescriptorSets(writes, {});
+    }
+
+    // Culling may sample the pyramid before it is first built
+    auto cmdBuffer = device->allocateCommandBuffer();
+    imageLayoutTransition(cmdBuffer, vk::ImageAspectFlagBits::eColor,
+                          vk::PipelineStageFlagBits2::eNone,
+                          vk::PipelineStageFlagBits2::eComputeShader,
+                          vk::AccessFlagBits2::eNone,
+                          vk::AccessFlagBits2::eShaderSampledRead,
+                          vk::ImageLayout::eUndefined,
+                          vk::ImageLayout::eGeneral, texture.image);
+    device->flushCommandBuffer(cmdBuffer);
+}
+
+void DepthPyramid::build(vk::CommandBuffer cmdBuffer) {
+    cmdBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, pipeline);
+
+    for (uint32_t i = 0; i < mipLevels; i++) {
+        uint32_t width = std::max(extent.width >> i, 1u);
+        uint32_t height = std::max(extent.height >> i, 1u);
+
+        cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute,
+                                     pipelineLayout, 0, descriptorSets[i],
+                                     {});
+        PyramidPushConstant pushConstant{
+            .size = glm::vec2(width, height),
+        };
+        cmdBuffer.pushConstants(pipelineLayout,
+                                vk::ShaderStageFlagBits::eCompute, 0,
+                                sizeof(PyramidPushConstant), &pushConstant);
+        cmdBuffer.dispatch((width + GROUP_SIZE - 1) / GROUP_SIZE,
+                           (height + GROUP_SIZE - 1) / GROUP_SIZE, 1);
+
+        // The next level samples this one, the last level is ordered
+        // against the culling by the caller
+        if (i + 1 == mipLevels) {
+            break;
+        }
+        BarrierBatch()
+            .addImage(texture.image,
+                      {
+                          .aspectMask = vk::ImageAspectFlagBits::eColor,
+                          .baseMipLevel = i,
+                          .levelCount = 1,
+                          .baseArrayLayer = 0,
+                          .layerCount = 1,
+                      },
+                      vk::PipelineStageFlagBits2::eComputeShader,
+                      vk::AccessFlagBits2::eShaderStorageWrite,
+                      vk::PipelineStageFlagBits2::eComputeShader,
+                      vk::AccessFlagBits2::eShaderSampledRead,
+                      vk::ImageLayout::eGeneral, vk::ImageLayout::eGeneral)
+            .record(cmdBuffer);
+    }
+}
+}  // namespace Engine
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "gfx/vulkan/VulkanUsage.hpp"
+#include "gfx/vulkan/Resource.hpp"
+
+namespace Engine {
+class Device;
+
+// Max reduced mip chain of a depth buffer for occlusion culling. Level 0 is
+// the depth extent rounded up to powers of two and every texel holds the
+// farthest depth of the area it covers. The image stays in eGeneral.
+class DepthPyramid {
+   public:
+    void init(Device* device);
+    void destroy();
+
+    // Recreates the image for a new depth buffer, the device must be idle
+    void resize(const Texture& depthTexture, vk::Extent2D depthExtent);
+
+    // The depth buffer has to be in eDepthReadOnlyOptimal and the culling
+    // reads of the previous pyramid done, only the barriers between levels
+    // are recorded here
+    void build(vk::CommandBuffer cmdBuffer);
+
+    // Reduction needs samplerFilterMinmax, without it the pyramid is not
+    // conservative and must not be used for culling
+    bool isSupported() const { return supported; }
+
+    vk::Image getImage() const { return texture.image; }
+    vk::ImageView getImageView() const { return texture.imageView; }
+    vk::Sampler getSampler() const { return reductionSampler; }
+    vk::Extent2D getExtent() const { return extent; }
+
+   private:
+    Device* device;
+    bool supported;
+
+    Texture texture{};
+    vk::Extent2D extent;
+    uint32_t mipLevels = 0;
+    std::vector<vk::ImageView> mipViews;
+
+    vk::Sampler reductionSampler;
+    vk::DescriptorPool descriptorPool;
+    vk::DescriptorSetLayout descriptorSetLayout;
+    std::vector<vk::DescriptorSet> descriptorSets;
+    vk::PipelineLayout pipelineLayout;
+    vk::Pipeline pipeline;
+
+    void destroyImage();
+};
+}  // namespace Engine
@@ -4,6 +4,7 @@
 #include "gfx/vulkan/Device.hpp"
 #include "gfx/vulkan/Utils.hpp"
 #include "core/Log.hpp"
+#include "core/MappedFile.hpp"
 
 namespace Engine {
 void Device::init(void* window) {
@@ -65,17 +66,46 @@ void Device::init(void* window) {
     if (!physicalDevicefeatures.samplerAnisotropy) {
         LOG_ERROR("Physical device does not support sampler anisotropy");
     }
+    if (!physicalDevicefeatures.drawIndirectFirstInstance) {
+        LOG_ERROR("Physical device does not support indirect first instance");
+    }
+    if (!physicalDevicefeatures.multiDrawIndirect) {
+        LOG_WARN("Physical device does not support multi draw indirect");
+    }
+
+    enabledFeatures = vk::PhysicalDeviceFeatures{
+        .sampleRateShading = vk::True,
+        .multiDrawIndirect = physicalDevicefeatures.multiDrawIndirect,
+        .drawIndirectFirstInstance = vk::True,
+        .samplerAnisotropy = vk::True,
+    };
+
+    auto supportedFeatures12 =
+        physicalDevice
+            .getFeatures2<vk::PhysicalDeviceFeatures2,
+                          vk::PhysicalDeviceVulkan12Features>()
+            .get<vk::PhysicalDeviceVulkan12Features>();
+    if (!supportedFeatures12.drawIndirectCount) {
+        LOG_WARN("Physical device does not support draw indirect count");
+    }
+    if (!supportedFeatures12.samplerFilterMinmax) {
+        LOG_WARN("Physical device does not support min/max samplers");
+    }
+
+    enabledFeatures12 = vk::PhysicalDeviceVulkan12Features{
+        .drawIndirectCount = supportedFeatures12.drawIndirectCount,
+        .samplerFilterMinmax = supportedFeatures12.samplerFilterMinmax,
+    };
 
-    vk::PhysicalDeviceDynamicRenderingFeatures drFeatures{
+    // Both are core in 1.3 and required there
+    vk::PhysicalDeviceVulkan13Features features13{
+        .pNext = &enabledFeatures12,
+        .synchronization2 = vk::True,
         .dynamicRendering = vk::True,
     };
     vk::PhysicalDeviceFeatures2 features2{
-        .pNext = &drFeatures,
-        .features =
-            {
-                .sampleRateShading = vk::True,
-                .samplerAnisotropy = vk::True,
-            },
+        .pNext = &features13,
+        .features = enabledFeatures,
     };
 
     vk::DeviceCreateInfo dci{
@@ -98,10 +128,18 @@ void Device::init(void* window) {
             .type = vk::DescriptorType::eUniformBuffer,
             .descriptorCount = 10,
         },
+        {
+            .type = vk::DescriptorType::eUniformBufferDynamic,
+            .descriptorCount = 10,
+        },
         {
             .type = vk::DescriptorType::eCombinedImageSampler,
             .descriptorCount = 10,
         },
+        {
+            .type = vk::DescriptorType::eStorageBuffer,
+            .descriptorCount = 10,
+        },
     };
     descriptorPool = device.createDescriptorPool({
         .maxSets = 10,
@@ -109,6 +147,8 @@ void Device::init(void* window) {
         .pPoolSizes = poolSizes.data(),
     });
 
+    layoutCache.init(device);
+
     cmdPool = device.createCommandPool({
         .flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
         .queueFamilyIndex = queueFamilyIndex,
@@ -135,6 +175,7 @@ void Device::destroy() {
 
     uiLayout.reset();
 
+    layoutCache.destroy();
     device.destroyCommandPool(cmdPool);
     device.destroyDescriptorPool(descriptorPool);
 
@@ -180,14 +221,22 @@ void Device::flushCommandBuffer(vk::CommandBuffer cmdBuffer) {
     device.freeCommandBuffers(cmdPool, cmdBuffer);
 }
 
-vk::ShaderModule Device::createShaderModule(const char* filename) {
+vk::ShaderModule Device::createShaderModule(const char* filename,
+                                            ShaderReflection* reflection) {
     std::string fullPath = SHADER_DIR + std::string(filename);
 
-    auto fileBinary = readFile(fullPath);
+    // SPIR-V is handed to the driver straight from the mapped pages
+    MappedFile fileBinary(fullPath);
+    auto code = fileBinary.data();
+    if (reflection) {
+        *reflection = reflectShader(
+            {reinterpret_cast<const uint32_t*>(code.data()),
+             code.size() / sizeof(uint32_t)});
+    }
 
     vk::ShaderModuleCreateInfo shaderModuleCI{
-        .codeSize = fileBinary.size(),
-        .pCode = reinterpret_cast<uint32_t*>(fileBinary.data()),
+        .codeSize = code.size(),
+        .pCode = reinterpret_cast<const uint32_t*>(code.data()),
     };
 
     return device.createShaderModule(shaderModuleCI);
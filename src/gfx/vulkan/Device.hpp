@@ -1,6 +1,7 @@
 #pragma once
 
 #include "gfx/vulkan/VulkanUsage.hpp"
+#include "gfx/vulkan/PipelineLayoutCache.hpp"
 #include "gfx/vulkan/Resource.hpp"
 #include "gfx/vulkan/UiLayout.hpp"
 
@@ -27,13 +28,22 @@ class Device {
     vk::CommandPool getCommandPool() const { return cmdPool; }
     vk::DescriptorPool getDescriptorPool() const { return descriptorPool; }
     UiLayout* getUiLayout() const { return uiLayout.get(); }
+    PipelineLayoutCache& getLayoutCache() { return layoutCache; }
+    const vk::PhysicalDeviceFeatures& getEnabledFeatures() const {
+        return enabledFeatures;
+    }
+    const vk::PhysicalDeviceVulkan12Features& getEnabledFeatures12() const {
+        return enabledFeatures12;
+    }
 
     void* getWindowHandle() const { return windowHandle; }
 
     vk::CommandBuffer allocateCommandBuffer(bool begin = true);
     void flushCommandBuffer(vk::CommandBuffer cmdBuffer);
 
-    vk::ShaderModule createShaderModule(const char* filename);
+    // Fills reflection from the same SPIR-V when given
+    vk::ShaderModule createShaderModule(const char* filename,
+                                        ShaderReflection* reflection = nullptr);
     Buffer createBuffer();
     Texture createTexture();
 
@@ -46,6 +56,10 @@ class Device {
     vk::CommandPool cmdPool;
     vk::Queue queue;
     uint32_t queueFamilyIndex;
+    vk::PhysicalDeviceFeatures enabledFeatures;
+    vk::PhysicalDeviceVulkan12Features enabledFeatures12;
+
+    PipelineLayoutCache layoutCache;
 
     std::unique_ptr<UiLayout> uiLayout;
 
@@ -67,6 +81,4 @@ class Device {
 
     void* windowHandle;
 };
-
-std::vector<char> readFile(const std::string& filename);
 }  // namespace Engine
\ No newline at end of file
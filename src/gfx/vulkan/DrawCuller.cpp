@@ -0,0 +1,254 @@
+#include "gfx/vulkan/DrawCuller.hpp"
+#include "gfx/vulkan/BarrierBatch.hpp"
+#include "gfx/vulkan/DepthPyramid.hpp"
+#include "gfx/vulkan/Pipeline.hpp"
+
+#include "core/Frustum.hpp"
+
+#include <algorithm>
+#include <numeric>
+
+namespace Engine {
+namespace {
+constexpr uint32_t GROUP_SIZE = 64;
+
+// Mirrors CullView in cull.hlsl
+struct GpuCullView {
+    glm::vec4 frustumPlanes[6];
+    glm::mat4 occlusionViewProj;
+    glm::vec2 pyramidSize;
+    uint32_t requiredFlags;
+    uint32_t occlusion;
+};
+
+struct CullPushConstant {
+    uint32_t viewIndex;
+    uint32_t objectCount;
+    uint32_t maxDrawCount;
+};
+
+constexpr vk::DescriptorType BINDING_TYPES[] = {
+    vk::DescriptorType::eStorageBuffer,
+    vk::DescriptorType::eStorageBuffer,
+    vk::DescriptorType::eStorageBuffer,
+    vk::DescriptorType::eStorageBuffer,
+    vk::DescriptorType::eCombinedImageSampler,
+};
+}  // namespace
+
+void DrawCuller::init(Device* device, uint32_t maxObjectCount,
+                      uint32_t viewCount) {
+    this->device = device;
+    this->maxObjectCount = maxObjectCount;
+    this->viewCount = viewCount;
+    supported = device->getEnabledFeatures12().drawIndirectCount;
+
+    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        objectBuffers[i] = device->createBuffer();
+        objectBuffers[i].allocate(sizeof(GpuObject) * maxObjectCount,
+                                  vk::BufferUsageFlagBits::eStorageBuffer,
+                                  true);
+        viewBuffers[i] = device->createBuffer();
+        viewBuffers[i].allocate(sizeof(GpuCullView) * viewCount,
+                                vk::BufferUsageFlagBits::eStorageBuffer, true);
+    }
+
+    // Every view has a bucket of maxObjectCount commands per index type
+    drawCommandBuffer = device->createBuffer();
+    drawCommandBuffer.allocate(sizeof(vk::DrawIndexedIndirectCommand) *
+                                   maxObjectCount * viewCount * 2,
+                               vk::BufferUsageFlagBits::eStorageBuffer |
+                                   vk::BufferUsageFlagBits::eIndirectBuffer);
+    drawCountBuffer = device->createBuffer();
+    drawCountBuffer.allocate(sizeof(uint32_t) * viewCount * 2,
+                             vk::BufferUsageFlagBits::eStorageBuffer |
+                                 vk::BufferUsageFlagBits::eIndirectBuffer |
+                                 vk::BufferUsageFlagBits::eTransferDst);
+
+    instanceBuffer = device->createBuffer();
+    instanceBuffer.allocate(sizeof(uint32_t) * maxObjectCount,
+                            vk::BufferUsageFlagBits::eVertexBuffer, true);
+    auto objectIndices =
+        static_cast<uint32_t*>(instanceBuffer.allocationInfo.pMappedData);
+    std::iota(objectIndices, objectIndices + maxObjectCount, 0u);
+
+    auto logicalDevice = device->getLogicalDevice();
+
+    std::array<vk::DescriptorSetLayoutBinding, std::size(BINDING_TYPES)>
+        bindings;
+    for (uint32_t i = 0; i < bindings.size(); i++) {
+        bindings[i] = {
+            .binding = i,
+            .descriptorType = BINDING_TYPES[i],
+            .descriptorCount = 1,
+            .stageFlags = vk::ShaderStageFlagBits::eCompute,
+        };
+    }
+    descriptorSetLayout = logicalDevice.createDescriptorSetLayout(
+        {.bindingCount = static_cast<uint32_t>(bindings.size()),
+         .pBindings = bindings.data()});
+
+    std::vector<vk::DescriptorPoolSize> poolSizes{
+        {
+            .type = vk::DescriptorType::eStorageBuffer,
+            .descriptorCount = 4 * MAX_FRAMES_IN_FLIGHT,
+        },
+        {
+            .type = vk::DescriptorType::eCombinedImageSampler,
+            .descriptorCount = MAX_FRAMES_IN_FLIGHT,
+        },
+    };
+    descriptorPool = logicalDevice.createDescriptorPool({
+        .maxSets = MAX_FRAMES_IN_FLIGHT,
+        .poolSizeCount = static_cast<uint32_t>(poolSizes.size()),
+        .pPoolSizes = poolSizes.data(),
+    });
+
+    std::array<vk::DescriptorSetLayout, MAX_FRAMES_IN_FLIGHT> setLayouts;
+    setLayouts.fill(descriptorSetLayout);
+    auto sets = logicalDevice.allocateDescriptorSets({
+        .descriptorPool = descriptorPool,
+        .descriptorSetCount = MAX_FRAMES_IN_FLIGHT,
+        .pSetLayouts = setLayouts.data(),
+    });
+    std::copy(sets.begin(), sets.end(), descriptorSets.begin());
+
+    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        vk::DescriptorBufferInfo bufferInfos[4] = {
+            {objectBuffers[i].buffer, 0, vk::WholeSize},
+            {viewBuffers[i].buffer, 0, vk::WholeSize},
+            {drawCommandBuffer.buffer, 0, vk::WholeSize},
+            {drawCountBuffer.buffer, 0, vk::WholeSize},
+        };
+
+        std::array<vk::WriteDescriptorSet, 4> writes;
+        for (uint32_t binding = 0; binding < writes.size(); binding++) {
+            writes[binding] = {
+                .dstSet = descriptorSets[i],
+                .dstBinding = binding,
+                .descriptorCount = 1,
+                .descriptorType = vk::DescriptorType::eStorageBuffer,
+                .pBufferInfo = &bufferInfos[binding],
+            };
+        }
+        logicalDevice.updateDescriptorSets(writes, {});
+    }
+
+    vk::PushConstantRange pushConstantRange{
+        .stageFlags = vk::ShaderStageFlagBits::eCompute,
+        .offset = 0,
+        .size = sizeof(CullPushConstant),
+    };
+    pipelineLayout = logicalDevice.createPipelineLayout({
+        .setLayoutCount = 1,
+        .pSetLayouts = &descriptorSetLayout,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &pushConstantRange,
+    });
+
+    auto shader = device->createShaderModule("test/cull.comp.spv");
+    pipeline = buildComputePipeline(logicalDevice, pipelineLayout, shader);
+    logicalDevice.destroyShaderModule(shader);
+}
+
+void DrawCuller::destroy() {
+    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        objectBuffers[i].destroy();
+        viewBuffers[i].destroy();
+    }
+    drawCommandBuffer.destroy();
+    drawCountBuffer.destroy();
+    instanceBuffer.destroy();
+
+    auto logicalDevice = device->getLogicalDevice();
+    logicalDevice.destroyPipeline(pipeline);
+    logicalDevice.destroyPipelineLayout(pipelineLayout);
+    logicalDevice.destroyDescriptorPool(descriptorPool);
+    logicalDevice.destroyDescriptorSetLayout(descriptorSetLayout);
+}
+
+void DrawCuller::setDepthPyramid(const DepthPyramid& pyramid) {
+    pyramidExtent = pyramid.getExtent();
+
+    vk::DescriptorImageInfo imageInfo{
+        .sampler = pyramid.getSampler(),
+        .imageView = pyramid.getImageView(),
+        .imageLayout = vk::ImageLayout::eGeneral,
+    };
+
+    for (auto descriptorSet : descriptorSets) {
+        vk::WriteDescriptorSet write{
+            .dstSet = descriptorSet,
+            .dstBinding = 4,
+            .descriptorCount = 1,
+            .descriptorType = vk::DescriptorType::eCombinedImageSampler,
+            .pImageInfo = &imageInfo,
+        };
+        device->getLogicalDevice().updateDescriptorSets(write, {});
+    }
+}
+
+void DrawCuller::setView(uint32_t frameIndex, uint32_t viewIndex,
+                         const glm::mat4& viewProj, uint32_t requiredFlags,
+                         const glm::mat4* occlusionViewProj) {
+    auto frustum = Frustum::fromMatrix(viewProj);
+
+    auto& view = static_cast<GpuCullView*>(
+        viewBuffers[frameIndex].allocationInfo.pMappedData)[viewIndex];
+    std::copy(frustum.planes.begin(), frustum.planes.end(),
+              view.frustumPlanes);
+    view.occlusionViewProj =
+        occlusionViewProj ? *occlusionViewProj : glm::mat4(1.0f);
+    view.pyramidSize = glm::vec2(pyramidExtent.width, pyramidExtent.height);
+    view.requiredFlags = requiredFlags;
+    view.occlusion = occlusionViewProj != nullptr;
+}
+
+void DrawCuller::cull(vk::CommandBuffer cmdBuffer, uint32_t frameIndex,
+                      uint32_t objectCount, uint32_t activeViewCount) {
+    cmdBuffer.fillBuffer(drawCountBuffer.buffer, 0, vk::WholeSize, 0);
+
+    BarrierBatch()
+        .addBuffer(drawCountBuffer.buffer, vk::PipelineStageFlagBits2::eClear,
+                   vk::AccessFlagBits2::eTransferWrite,
+                   vk::PipelineStageFlagBits2::eComputeShader,
+                   vk::AccessFlagBits2::eShaderStorageRead |
+                       vk::AccessFlagBits2::eShaderStorageWrite)
+        .record(cmdBuffer);
+
+    cmdBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, pipeline);
+    cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute,
+                                 pipelineLayout, 0, descriptorSets[frameIndex],
+                                 {});
+
+    activeViewCount = std::min(activeViewCount, viewCount);
+    for (uint32_t viewIndex = 0; viewIndex < activeViewCount; viewIndex++) {
+        CullPushConstant pushConstant{
+            .viewIndex = viewIndex,
+            .objectCount = objectCount,
+            .maxDrawCount = maxObjectCount,
+        };
+        cmdBuffer.pushConstants(pipelineLayout,
+                                vk::ShaderStageFlagBits::eCompute, 0,
+                                sizeof(CullPushConstant), &pushConstant);
+        cmdBuffer.dispatch((objectCount + GROUP_SIZE - 1) / GROUP_SIZE, 1, 1);
+    }
+}
+
+void DrawCuller::draw(vk::CommandBuffer cmdBuffer, uint32_t viewIndex,
+                      vk::Buffer indexBuffer) const {
+    constexpr uint32_t stride = sizeof(vk::DrawIndexedIndirectCommand);
+
+    for (auto [bucket, indexType] :
+         {std::pair{0u, vk::IndexType::eUint16},
+          std::pair{1u, vk::IndexType::eUint32}}) {
+        uint32_t bucketIndex = viewIndex * 2 + bucket;
+        cmdBuffer.bindIndexBuffer(indexBuffer, 0, indexType);
+        cmdBuffer.drawIndexedIndirectCount(
+            drawCommandBuffer.buffer,
+            vk::DeviceSize(bucketIndex) * maxObjectCount * stride,
+            drawCountBuffer.buffer, bucketIndex * sizeof(uint32_t),
+            maxObjectCount, stride);
+    }
+}
+}  // namespace Engine
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "gfx/vulkan/VulkanUsage.hpp"
+#include "gfx/vulkan/Resource.hpp"
+#include "gfx/vulkan/Device.hpp"
+
+#include <array>
+#include <glm/glm.hpp>
+
+namespace Engine {
+class DepthPyramid;
+
+constexpr uint32_t GPU_OBJECT_INDEX32 = 1 << 0;
+constexpr uint32_t GPU_OBJECT_CASTS_SHADOW = 1 << 1;
+// Views can only require flags, objects set exactly one of these so a view
+// can pick either kind
+constexpr uint32_t GPU_OBJECT_STATIC = 1 << 2;
+constexpr uint32_t GPU_OBJECT_DYNAMIC = 1 << 3;
+
+// std430 element of the object buffer. The cull shader reads all of it, the
+// vertex shaders only the transform of the object their instance names.
+struct GpuObject {
+    glm::mat4 model;
+    glm::vec4 boundingSphere;
+    uint32_t indexCount;
+    uint32_t firstIndex;
+    int32_t vertexOffset;
+    uint32_t flags;
+};
+
+// Tests every object against the frustum of each view, and optionally
+// against last frame's depth pyramid, in a compute pass. Survivors are
+// compacted into per view indirect commands that draw() issues with
+// drawIndexedIndirectCount, one call per index type.
+class DrawCuller {
+   public:
+    void init(Device* device, uint32_t maxObjectCount, uint32_t viewCount);
+    void destroy();
+
+    // Points every frame's descriptor set at the pyramid, the device must be
+    // idle
+    void setDepthPyramid(const DepthPyramid& pyramid);
+
+    // Persistently mapped, fill it after the frame's fence has been waited on
+    GpuObject* getObjects(uint32_t frameIndex) const {
+        return static_cast<GpuObject*>(
+            objectBuffers[frameIndex].allocationInfo.pMappedData);
+    }
+    vk::Buffer getObjectBuffer(uint32_t frameIndex) const {
+        return objectBuffers[frameIndex].buffer;
+    }
+
+    // Only objects with all of requiredFlags set pass. occlusionViewProj is
+    // the matrix the depth pyramid was rendered with, nullptr skips the
+    // occlusion test.
+    void setView(uint32_t frameIndex, uint32_t viewIndex,
+                 const glm::mat4& viewProj, uint32_t requiredFlags,
+                 const glm::mat4* occlusionViewProj = nullptr);
+
+    // Records the cull dispatches for the first activeViewCount views,
+    // outside of rendering. The others draw nothing this frame. The caller
+    // orders the draw buffers against the previous draws and the next ones,
+    // the count reset inside is the only barrier recorded here.
+    void cull(vk::CommandBuffer cmdBuffer, uint32_t frameIndex,
+              uint32_t objectCount, uint32_t activeViewCount);
+
+    void draw(vk::CommandBuffer cmdBuffer, uint32_t viewIndex,
+              vk::Buffer indexBuffer) const;
+
+    // The culled commands draw one instance with firstInstance set to the
+    // object index. Bound as the per instance stream, this identity stream
+    // hands that index to the vertex shader.
+    vk::Buffer getInstanceBuffer() const { return instanceBuffer.buffer; }
+
+    vk::Buffer getDrawCommandBuffer() const {
+        return drawCommandBuffer.buffer;
+    }
+    vk::Buffer getDrawCountBuffer() const { return drawCountBuffer.buffer; }
+
+    // drawIndexedIndirectCount is core but optional
+    bool isSupported() const { return supported; }
+
+   private:
+    Device* device;
+    bool supported;
+    uint32_t maxObjectCount;
+    uint32_t viewCount;
+    vk::Extent2D pyramidExtent;
+
+    std::array<Buffer, MAX_FRAMES_IN_FLIGHT> objectBuffers;
+    std::array<Buffer, MAX_FRAMES_IN_FLIGHT> viewBuffers;
+
+    // Written and consumed on the GPU within a frame, so one copy suffices
+    Buffer drawCommandBuffer;
+    Buffer drawCountBuffer;
+    Buffer instanceBuffer;
+
+    vk::DescriptorPool descriptorPool;
+    vk::DescriptorSetLayout descriptorSetLayout;
+    std::array<vk::DescriptorSet, MAX_FRAMES_IN_FLIGHT> descriptorSets;
+    vk::PipelineLayout pipelineLayout;
+    vk::Pipeline pipeline;
+};
+}  // namespace Engine
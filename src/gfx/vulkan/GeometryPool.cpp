@@ -0,0 +1,149 @@
+#include "gfx/vulkan/GeometryPool.hpp"
+#include "gfx/vulkan/Device.hpp"
+
+#include <cstring>
+
+namespace Engine {
+namespace {
+constexpr uint64_t INDEX_RANGE_ALIGNMENT = 4;
+}
+
+void GeometryPool::init(Device* device, uint32_t maxVertexCount,
+                        vk::DeviceSize indexBufferSize, VertexLayout layout,
+                        VertexStreams streams) {
+    this->device = device;
+    this->layout = layout;
+    this->streams = streams;
+
+    uint32_t stride = Vertex::getStride(layout);
+    uint32_t positionStride = Vertex::getPositionStride(layout);
+    auto vertexUsage = vk::BufferUsageFlagBits::eVertexBuffer |
+                       vk::BufferUsageFlagBits::eTransferDst;
+
+    vertexBuffer = device->createBuffer();
+    if (streams == VertexStreams::eSplitPosition) {
+        vertexBuffer.allocate(vk::DeviceSize(maxVertexCount) * positionStride,
+                              vertexUsage);
+        attributeBuffer = device->createBuffer();
+        attributeBuffer.allocate(
+            vk::DeviceSize(maxVertexCount) * (stride - positionStride),
+            vertexUsage);
+    } else {
+        vertexBuffer.allocate(vk::DeviceSize(maxVertexCount) * stride,
+                              vertexUsage);
+    }
+
+    indexBuffer = device->createBuffer();
+    indexBuffer.allocate(indexBufferSize,
+                         vk::BufferUsageFlagBits::eIndexBuffer |
+                             vk::BufferUsageFlagBits::eTransferDst);
+
+    vertexAllocator.init(maxVertexCount);
+    indexAllocator.init(indexBufferSize);
+}
+
+void GeometryPool::destroy() {
+    vertexBuffer.destroy();
+    if (streams == VertexStreams::eSplitPosition) {
+        attributeBuffer.destroy();
+    }
+    indexBuffer.destroy();
+
+    ranges.clear();
+}
+
+GeometryHandle GeometryPool::add(const Mesh& mesh) {
+    auto vertexData = mesh.getVertexData(layout);
+    uint32_t stride = Vertex::getStride(layout);
+    uint32_t vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+    if (vertexData.size() != uint64_t(vertexCount) * stride) {
+        throw std::runtime_error("mesh is missing the pool's vertex layout");
+    }
+
+    uint32_t indexSize = mesh.getIndexSize();
+    uint64_t indexBytes = uint64_t(indexSize) * mesh.indices.size();
+
+    auto vertexOffset = vertexAllocator.allocate(vertexCount);
+    if (!vertexOffset) {
+        throw std::runtime_error("geometry pool is out of vertex space");
+    }
+    auto indexOffset = indexAllocator.allocate(indexBytes,
+                                               INDEX_RANGE_ALIGNMENT);
+    if (!indexOffset) {
+        vertexAllocator.free(*vertexOffset);
+        throw std::runtime_error("geometry pool is out of index space");
+    }
+
+    // One staging buffer, vertices first and indices right after
+    auto stagingBuffer = device->createBuffer();
+    stagingBuffer.allocate(vertexData.size() + indexBytes,
+                           vk::BufferUsageFlagBits::eTransferSrc, true);
+    auto stagingData =
+        static_cast<uint8_t*>(stagingBuffer.allocationInfo.pMappedData);
+    uint32_t positionStride = Vertex::getPositionStride(layout);
+    if (streams == VertexStreams::eSplitPosition) {
+        mesh.writeVertexStreams(layout, stagingData,
+                                stagingData + vertexCount * positionStride);
+    } else {
+        std::memcpy(stagingData, vertexData.data(), vertexData.size());
+    }
+    mesh.writeIndices(stagingData + vertexData.size());
+
+    auto cmdBuffer = device->allocateCommandBuffer();
+    if (streams == VertexStreams::eSplitPosition) {
+        uint32_t attributeStride = stride - positionStride;
+        cmdBuffer.copyBuffer(
+            stagingBuffer.buffer, vertexBuffer.buffer,
+            vk::BufferCopy{0, *vertexOffset * positionStride,
+                           vk::DeviceSize(vertexCount) * positionStride});
+        cmdBuffer.copyBuffer(
+            stagingBuffer.buffer, attributeBuffer.buffer,
+            vk::BufferCopy{vk::DeviceSize(vertexCount) * positionStride,
+                           *vertexOffset * attributeStride,
+                           vk::DeviceSize(vertexCount) * attributeStride});
+    } else {
+        cmdBuffer.copyBuffer(stagingBuffer.buffer, vertexBuffer.buffer,
+                             vk::BufferCopy{0, *vertexOffset * stride,
+                                            vertexData.size()});
+    }
+    cmdBuffer.copyBuffer(
+        stagingBuffer.buffer, indexBuffer.buffer,
+        vk::BufferCopy{vertexData.size(), *indexOffset, indexBytes});
+    device->flushCommandBuffer(cmdBuffer);
+    stagingBuffer.destroy();
+
+    GeometryRange range{
+        .vertexOffset = static_cast<int32_t>(*vertexOffset),
+        .vertexCount = vertexCount,
+        .firstIndex = static_cast<uint32_t>(*indexOffset / indexSize),
+        .indexType = mesh.indexType,
+        .boundingSphere = mesh.boundingSphere,
+        .lods = mesh.lods,
+    };
+    if (range.lods.empty()) {
+        range.lods.push_back({
+            .firstIndex = 0,
+            .indexCount = static_cast<uint32_t>(mesh.indices.size()),
+            .error = 0.0f,
+        });
+    }
+    for (auto& lod : range.lods) {
+        lod.firstIndex += range.firstIndex;
+    }
+    range.indexCount = range.lods.front().indexCount;
+
+    auto handle = static_cast<GeometryHandle>(ranges.size());
+    ranges.push_back(std::move(range));
+    return handle;
+}
+
+void GeometryPool::bindVertexBuffers(vk::CommandBuffer cmdBuffer,
+                                     bool positionOnly) const {
+    if (streams == VertexStreams::eSplitPosition && !positionOnly) {
+        cmdBuffer.bindVertexBuffers(
+            0, {vertexBuffer.buffer, attributeBuffer.buffer}, {0, 0});
+    } else {
+        cmdBuffer.bindVertexBuffers(0, {vertexBuffer.buffer}, {0});
+    }
+}
+}  // namespace Engine
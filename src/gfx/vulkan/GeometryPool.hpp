@@ -0,0 +1,73 @@
+#pragma once
+
+#include "gfx/vulkan/VulkanUsage.hpp"
+#include "gfx/vulkan/Resource.hpp"
+#include "core/RangeAllocator.hpp"
+
+#include "Model.hpp"
+
+namespace Engine {
+class Device;
+
+using GeometryHandle = uint32_t;
+
+// Where a mesh lives inside the pool, in the units drawIndexed expects
+struct GeometryRange {
+    int32_t vertexOffset;
+    uint32_t vertexCount;
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    vk::IndexType indexType;
+
+    // Object space, as in Mesh
+    glm::vec4 boundingSphere;
+    std::vector<MeshLod> lods;
+};
+
+// Scene wide vertex and index buffers that meshes are sub-allocated from.
+// Meshes of both index widths share the index buffer, every index range
+// starts 4 byte aligned so firstIndex is exact for either width.
+class GeometryPool {
+   public:
+    void init(Device* device, uint32_t maxVertexCount,
+              vk::DeviceSize indexBufferSize,
+              VertexLayout layout = VertexLayout::eFull,
+              VertexStreams streams = VertexStreams::eInterleaved);
+    void destroy();
+
+    // Uploads the mesh and returns a handle that stays valid until
+    // destroy(). The LOD ranges of the mesh are rebased onto the pool.
+    // Throws when the pool is out of space.
+    GeometryHandle add(const Mesh& mesh);
+
+    const GeometryRange& get(GeometryHandle handle) const {
+        return ranges[handle];
+    }
+
+    // Binds the vertex streams to bindings 0 (and 1 with split streams).
+    // positionOnly skips the attribute stream.
+    void bindVertexBuffers(vk::CommandBuffer cmdBuffer,
+                           bool positionOnly = false) const;
+    vk::Buffer getIndexBuffer() const { return indexBuffer.buffer; }
+
+    VertexLayout getVertexLayout() const { return layout; }
+    VertexStreams getVertexStreams() const { return streams; }
+
+   private:
+    Device* device;
+
+    VertexLayout layout;
+    VertexStreams streams;
+
+    // Holds every stream when interleaved, only positions when split
+    Buffer vertexBuffer;
+    Buffer attributeBuffer;
+    Buffer indexBuffer;
+
+    // The vertex allocator counts vertices, the index allocator bytes
+    RangeAllocator vertexAllocator;
+    RangeAllocator indexAllocator;
+
+    std::vector<GeometryRange> ranges;
+};
+}  // namespace Engine
@@ -0,0 +1,95 @@
+#include "gfx/vulkan/IndirectDraw.hpp"
+
+#include <cstring>
+
+namespace Engine {
+void IndirectDrawBuffer::init(Device* device, uint32_t maxDrawCount) {
+    this->device = device;
+    this->maxDrawCount = maxDrawCount;
+    multiDrawIndirect = device->getEnabledFeatures().multiDrawIndirect;
+
+    for (auto& buffer : buffers) {
+        buffer = device->createBuffer();
+        buffer.allocate(sizeof(vk::DrawIndexedIndirectCommand) * maxDrawCount,
+                        vk::BufferUsageFlagBits::eIndirectBuffer, true);
+    }
+}
+
+void IndirectDrawBuffer::destroy() {
+    for (auto& buffer : buffers) {
+        buffer.destroy();
+    }
+    commands16.clear();
+    commands32.clear();
+    batches.clear();
+}
+
+void IndirectDrawBuffer::begin(uint32_t frameIndex) {
+    this->frameIndex = frameIndex;
+    drawCount = 0;
+    commands16.clear();
+    commands32.clear();
+    batches.clear();
+}
+
+void IndirectDrawBuffer::add(const GeometryRange& geometry,
+                             uint32_t firstInstance, uint32_t instanceCount) {
+    if (commands16.size() + commands32.size() >= maxDrawCount) {
+        throw std::runtime_error("indirect draw buffer is full");
+    }
+
+    auto& commands = geometry.indexType == vk::IndexType::eUint16
+                         ? commands16
+                         : commands32;
+    commands.push_back({
+        .indexCount = geometry.indexCount,
+        .instanceCount = instanceCount,
+        .firstIndex = geometry.firstIndex,
+        .vertexOffset = geometry.vertexOffset,
+        .firstInstance = firstInstance,
+    });
+}
+
+void IndirectDrawBuffer::end() {
+    auto data = static_cast<vk::DrawIndexedIndirectCommand*>(
+        buffers[frameIndex].allocationInfo.pMappedData);
+
+    for (auto [indexType, commands] :
+         {std::pair{vk::IndexType::eUint16, &commands16},
+          std::pair{vk::IndexType::eUint32, &commands32}}) {
+        if (commands->empty()) {
+            continue;
+        }
+
+        std::memcpy(data + drawCount, commands->data(),
+                    commands->size() * sizeof(vk::DrawIndexedIndirectCommand));
+        batches.push_back({
+            .indexType = indexType,
+            .firstDraw = drawCount,
+            .drawCount = static_cast<uint32_t>(commands->size()),
+        });
+        drawCount += batches.back().drawCount;
+    }
+}
+
+void IndirectDrawBuffer::record(vk::CommandBuffer cmdBuffer,
+                                vk::Buffer indexBuffer) const {
+    constexpr uint32_t stride = sizeof(vk::DrawIndexedIndirectCommand);
+    auto buffer = buffers[frameIndex].buffer;
+
+    for (const auto& batch : batches) {
+        cmdBuffer.bindIndexBuffer(indexBuffer, 0, batch.indexType);
+        if (multiDrawIndirect) {
+            cmdBuffer.drawIndexedIndirect(buffer, batch.firstDraw * stride,
+                                          batch.drawCount, stride);
+            continue;
+        }
+
+        // Without multiDrawIndirect the draw count has to be 0 or 1
+        for (uint32_t i = 0; i < batch.drawCount; i++) {
+            cmdBuffer.drawIndexedIndirect(
+                buffer, (batch.firstDraw + i) * stride, 1, stride);
+        }
+    }
+}
+}  // namespace Engine
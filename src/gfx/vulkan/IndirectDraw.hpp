@@ -0,0 +1,53 @@
+#pragma once
+
+#include "gfx/vulkan/VulkanUsage.hpp"
+#include "gfx/vulkan/Resource.hpp"
+#include "gfx/vulkan/Device.hpp"
+#include "gfx/vulkan/GeometryPool.hpp"
+
+#include <array>
+
+namespace Engine {
+// Indexed draw commands written into a persistently mapped indirect buffer,
+// one copy per frame in flight. Commands are grouped by index type so every
+// group is issued with a single drawIndexedIndirect call.
+class IndirectDrawBuffer {
+   public:
+    void init(Device* device, uint32_t maxDrawCount);
+    void destroy();
+
+    // Starts over on the copy of frameIndex, the GPU must be done with it
+    void begin(uint32_t frameIndex);
+
+    // Draws LOD 0 of the geometry, the instances read the per instance
+    // stream from firstInstance on
+    void add(const GeometryRange& geometry, uint32_t firstInstance,
+             uint32_t instanceCount = 1);
+    void end();
+
+    // Binds the index buffer once per index type and issues the draws
+    void record(vk::CommandBuffer cmdBuffer, vk::Buffer indexBuffer) const;
+
+    uint32_t getDrawCount() const { return drawCount; }
+
+   private:
+    Device* device;
+    uint32_t maxDrawCount;
+    bool multiDrawIndirect;
+
+    std::array<Buffer, MAX_FRAMES_IN_FLIGHT> buffers;
+    uint32_t frameIndex = 0;
+    uint32_t drawCount = 0;
+
+    // Commands are gathered per index type and copied out in end()
+    std::vector<vk::DrawIndexedIndirectCommand> commands16;
+    std::vector<vk::DrawIndexedIndirectCommand> commands32;
+
+    struct Batch {
+        vk::IndexType indexType;
+        uint32_t firstDraw;
+        uint32_t drawCount;
+    };
+    std::vector<Batch> batches;
+};
+}  // namespace Engine
@@ -0,0 +1,68 @@
+#include "gfx/vulkan/InstanceBuffer.hpp"
+
+#include <algorithm>
+
+namespace Engine {
+void InstanceBuffer::init(Device* device, uint32_t maxInstanceCount) {
+    this->device = device;
+    this->maxInstanceCount = maxInstanceCount;
+
+    for (auto& buffer : buffers) {
+        buffer = device->createBuffer();
+        buffer.allocate(sizeof(uint32_t) * maxInstanceCount,
+                        vk::BufferUsageFlagBits::eVertexBuffer, true);
+    }
+}
+
+void InstanceBuffer::destroy() {
+    for (auto& buffer : buffers) {
+        buffer.destroy();
+    }
+    pending.clear();
+}
+
+void InstanceBuffer::begin(uint32_t frameIndex) {
+    this->frameIndex = frameIndex;
+    instanceCount = 0;
+    pending.clear();
+}
+
+void InstanceBuffer::add(GeometryHandle geometry, uint32_t objectIndex) {
+    pending.push_back({geometry, objectIndex});
+}
+
+void InstanceBuffer::flush(const GeometryPool& pool,
+                           IndirectDrawBuffer& draws) {
+    if (instanceCount + pending.size() > maxInstanceCount) {
+        throw std::runtime_error("instance buffer is full");
+    }
+
+    // Stable, so the instances of a group keep the order they were added in
+    std::stable_sort(pending.begin(), pending.end(),
+                     [](const PendingInstance& a, const PendingInstance& b) {
+                         return a.geometry < b.geometry;
+                     });
+
+    auto objectIndices = static_cast<uint32_t*>(
+        buffers[frameIndex].allocationInfo.pMappedData);
+    for (size_t first = 0; first < pending.size();) {
+        size_t last = first;
+        uint32_t firstInstance = instanceCount;
+        while (last < pending.size() &&
+               pending[last].geometry == pending[first].geometry) {
+            objectIndices[instanceCount++] = pending[last++].objectIndex;
+        }
+
+        draws.add(pool.get(pending[first].geometry), firstInstance,
+                  instanceCount - firstInstance);
+        first = last;
+    }
+
+    pending.clear();
+}
+
+void InstanceBuffer::bind(vk::CommandBuffer cmdBuffer,
+                          uint32_t binding) const {
+    cmdBuffer.bindVertexBuffers(binding, {buffers[frameIndex].buffer}, {0});
+}
+}  // namespace Engine
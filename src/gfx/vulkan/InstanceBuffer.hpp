@@ -0,0 +1,47 @@
+#pragma once
+
+#include "gfx/vulkan/VulkanUsage.hpp"
+#include "gfx/vulkan/Resource.hpp"
+#include "gfx/vulkan/Device.hpp"
+#include "gfx/vulkan/GeometryPool.hpp"
+#include "gfx/vulkan/IndirectDraw.hpp"
+
+#include <array>
+
+namespace Engine {
+// Per frame stream of object indices, read by instanced draws through the
+// per instance binding (see Vertex::getInstanceBindingDescription). Draws
+// of the same geometry are grouped into one command whose instances pick
+// their object from consecutive entries of the stream.
+class InstanceBuffer {
+   public:
+    void init(Device* device, uint32_t maxInstanceCount);
+    void destroy();
+
+    // Starts over on the copy of frameIndex, the GPU must be done with it
+    void begin(uint32_t frameIndex);
+
+    void add(GeometryHandle geometry, uint32_t objectIndex);
+
+    // Groups the draws added since the last flush by geometry, appends their
+    // object indices to the stream and adds one command per group. Several
+    // passes can flush into their own command lists within a frame.
+    void flush(const GeometryPool& pool, IndirectDrawBuffer& draws);
+
+    void bind(vk::CommandBuffer cmdBuffer, uint32_t binding) const;
+
+   private:
+    Device* device;
+    uint32_t maxInstanceCount;
+
+    std::array<Buffer, MAX_FRAMES_IN_FLIGHT> buffers;
+    uint32_t frameIndex = 0;
+    uint32_t instanceCount = 0;
+
+    struct PendingInstance {
+        GeometryHandle geometry;
+        uint32_t objectIndex;
+    };
+    std::vector<PendingInstance> pending;
+};
+}  // namespace Engine
@@ -0,0 +1,95 @@
+#include "gfx/vulkan/MsaaTargets.hpp"
+
+namespace Engine {
+namespace {
+vk::ImageAspectFlags getDepthAspect(vk::Format format) {
+    switch (format) {
+        case vk::Format::eD16UnormS8Uint:
+        case vk::Format::eD24UnormS8Uint:
+        case vk::Format::eD32SfloatS8Uint:
+            return vk::ImageAspectFlagBits::eDepth |
+                   vk::ImageAspectFlagBits::eStencil;
+        default:
+            return vk::ImageAspectFlagBits::eDepth;
+    }
+}
+}  // namespace
+
+MsaaTargets createMsaaTargets(RenderGraph& graph, RenderGraphHandle resolve,
+                              vk::Extent2D extent, vk::Format colorFormat,
+                              vk::Format depthFormat,
+                              vk::SampleCountFlagBits sampleCount) {
+    MsaaTargets targets{
+        .sampleCount = sampleCount,
+        .color = resolve,
+        .resolve = resolve,
+    };
+
+    // Neither is stored, they only ever need attachment usage
+    TransientImageDesc depthDesc{
+        .extent = extent,
+        .format = depthFormat,
+        .usage = vk::ImageUsageFlagBits::eDepthStencilAttachment,
+        .aspect = getDepthAspect(depthFormat),
+        .sampleCount = sampleCount,
+    };
+    targets.depth = graph.createImage("msaa depth", depthDesc);
+
+    if (targets.isMultisampled()) {
+        TransientImageDesc colorDesc{
+            .extent = extent,
+            .format = colorFormat,
+            .usage = vk::ImageUsageFlagBits::eColorAttachment,
+            .aspect = vk::ImageAspectFlagBits::eColor,
+            .sampleCount = sampleCount,
+        };
+        targets.color = graph.createImage("msaa color", colorDesc);
+    }
+    return targets;
+}
+
+void MsaaTargets::declareWrites(RenderGraph::PassBuilder& pass) const {
+    // The resolve writes at the color attachment stage as well
+    pass.write(resolve, RenderGraphUsage::eColorAttachment)
+        .write(depth, RenderGraphUsage::eDepthAttachment);
+    if (isMultisampled()) {
+        pass.write(color, RenderGraphUsage::eColorAttachment);
+    }
+}
+
+vk::RenderingAttachmentInfo MsaaTargets::getColorAttachment(
+    const RenderGraph& graph, vk::ImageView resolveView,
+    vk::ClearColorValue clearColor) const {
+    vk::RenderingAttachmentInfo attachmentInfo{
+        .imageView = resolveView,
+        .imageLayout = vk::ImageLayout::eColorAttachmentOptimal,
+        .loadOp = vk::AttachmentLoadOp::eClear,
+        .storeOp = vk::AttachmentStoreOp::eStore,
+        .clearValue = clearColor,
+    };
+    if (isMultisampled()) {
+        attachmentInfo.imageView = graph.getTexture(color).imageView;
+        attachmentInfo.storeOp = vk::AttachmentStoreOp::eDontCare;
+        attachmentInfo.resolveMode = vk::ResolveModeFlagBits::eAverage;
+        attachmentInfo.resolveImageView = resolveView;
+        attachmentInfo.resolveImageLayout =
+            vk::ImageLayout::eColorAttachmentOptimal;
+    }
+    return attachmentInfo;
+}
+
+vk::RenderingAttachmentInfo MsaaTargets::getDepthAttachment(
+    const RenderGraph& graph) const {
+    return vk::RenderingAttachmentInfo{
+        .imageView = graph.getTexture(depth).imageView,
+        .imageLayout = vk::ImageLayout::eDepthStencilAttachmentOptimal,
+        .loadOp = vk::AttachmentLoadOp::eClear,
+        .storeOp = vk::AttachmentStoreOp::eDontCare,
+        .clearValue = vk::ClearValue{.depthStencil =
+                                         {
+                                             .depth = 1.0f,
+                                             .stencil = 0,
+                                         }},
+    };
+}
+}  // namespace Engine
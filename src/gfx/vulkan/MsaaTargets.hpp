@@ -0,0 +1,40 @@
+#pragma once
+
+#include "gfx/vulkan/VulkanUsage.hpp"
+#include "gfx/vulkan/RenderGraph.hpp"
+
+namespace Engine {
+// Color and depth targets of a pass rendering with sampleCount samples,
+// resolved into a single sampled image by the color attachment itself.
+// Both are render graph transients, so each sample count gets its targets
+// the first time a frame asks for it and the targets of a count nobody
+// renders with anymore go away once the frames in flight are done, a
+// switch needs no waitIdle.
+struct MsaaTargets {
+    vk::SampleCountFlagBits sampleCount;
+    // The resolve target itself when single sampled
+    RenderGraphHandle color;
+    RenderGraphHandle depth;
+    RenderGraphHandle resolve;
+
+    bool isMultisampled() const {
+        return sampleCount != vk::SampleCountFlagBits::e1;
+    }
+
+    // The writes of the pass that renders to the targets
+    void declareWrites(RenderGraph::PassBuilder& pass) const;
+
+    // Only valid while the graph executes. Imported resolve targets have
+    // no texture in the graph, so their view is passed in.
+    vk::RenderingAttachmentInfo getColorAttachment(
+        const RenderGraph& graph, vk::ImageView resolveView,
+        vk::ClearColorValue clearColor) const;
+    vk::RenderingAttachmentInfo getDepthAttachment(
+        const RenderGraph& graph) const;
+};
+
+MsaaTargets createMsaaTargets(RenderGraph& graph, RenderGraphHandle resolve,
+                              vk::Extent2D extent, vk::Format colorFormat,
+                              vk::Format depthFormat,
+                              vk::SampleCountFlagBits sampleCount);
+}  // namespace Engine
@@ -42,6 +42,15 @@ vk::Pipeline PipelineBuilder::build() {
         .pColorAttachmentFormats = colorAttachmentFormats.data(),
     };
 
+    if (!vertexBindings.empty()) {
+        vertexInputCI.vertexBindingDescriptionCount =
+            static_cast<uint32_t>(vertexBindings.size());
+        vertexInputCI.pVertexBindingDescriptions = vertexBindings.data();
+        vertexInputCI.vertexAttributeDescriptionCount =
+            static_cast<uint32_t>(vertexAttributes.size());
+        vertexInputCI.pVertexAttributeDescriptions = vertexAttributes.data();
+    }
+
     if (depthAttachmentFormat != vk::Format::eUndefined) {
         pipelineRenderingCI.depthAttachmentFormat = depthAttachmentFormat;
     }
@@ -49,10 +58,43 @@ vk::Pipeline PipelineBuilder::build() {
         pipelineRenderingCI.stencilAttachmentFormat = stencilAttachmentFormat;
     }
 
+    // Copies of the stages, the specialization infos only live for this call
+    auto stages = shaderStages;
+    std::vector<vk::SpecializationInfo> specializationInfos(stages.size());
+    std::vector<std::vector<vk::SpecializationMapEntry>> specializationEntries(
+        stages.size());
+    std::vector<std::vector<uint32_t>> specializationData(stages.size());
+    for (size_t i = 0; i < stages.size(); i++) {
+        auto& entries = specializationEntries[i];
+        auto& data = specializationData[i];
+        for (const auto& constant : specializationConstants) {
+            if (constant.stage != stages[i].stage) {
+                continue;
+            }
+            entries.push_back({
+                .constantID = constant.constantId,
+                .offset = static_cast<uint32_t>(data.size() * sizeof(uint32_t)),
+                .size = sizeof(uint32_t),
+            });
+            data.push_back(constant.value);
+        }
+        if (entries.empty()) {
+            continue;
+        }
+
+        specializationInfos[i] = vk::SpecializationInfo{
+            .mapEntryCount = static_cast<uint32_t>(entries.size()),
+            .pMapEntries = entries.data(),
+            .dataSize = data.size() * sizeof(uint32_t),
+            .pData = data.data(),
+        };
+        stages[i].pSpecializationInfo = &specializationInfos[i];
+    }
+
     vk::GraphicsPipelineCreateInfo pipelineCI{
         .pNext = &pipelineRenderingCI,
-        .stageCount = static_cast<uint32_t>(shaderStages.size()),
-        .pStages = shaderStages.data(),
+        .stageCount = static_cast<uint32_t>(stages.size()),
+        .pStages = stages.data(),
         .pVertexInputState = &vertexInputCI,
         .pInputAssemblyState = &inputAssemblyCI,
         .pTessellationState = VK_NULL_HANDLE,
@@ -72,6 +114,30 @@ vk::Pipeline PipelineBuilder::build() {
     return resultValue.value;
 }
 
+void PipelineBuilder::setVertexInput(
+    std::span<const vk::VertexInputBindingDescription> bindings,
+    std::span<const vk::VertexInputAttributeDescription> attributes) {
+    vertexBindings.assign(bindings.begin(), bindings.end());
+    vertexAttributes.assign(attributes.begin(), attributes.end());
+}
+
+void PipelineBuilder::setSpecialization(vk::ShaderStageFlagBits stage,
+                                        uint32_t constantId, uint32_t value) {
+    for (auto& constant : specializationConstants) {
+        if (constant.stage == stage && constant.constantId == constantId) {
+            constant.value = value;
+            return;
+        }
+    }
+    specializationConstants.push_back({stage, constantId, value});
+}
+
+void PipelineBuilder::setSpecialization(vk::ShaderStageFlagBits stage,
+                                        uint32_t constantId, bool value) {
+    setSpecialization(stage, constantId,
+                      static_cast<uint32_t>(value ? VK_TRUE : VK_FALSE));
+}
+
 void PipelineBuilder::addColorAttachment(vk::Format format) {
     colorAttachmentFormats.push_back(format);
 
@@ -89,4 +155,52 @@ void PipelineBuilder::addColorAttachment(
     colorAttachmentFormats.push_back(format);
     colorBlendAttachmentStates.push_back(colorBlendState);
 }
+
+vk::Pipeline buildComputePipeline(vk::Device device, vk::PipelineLayout layout,
+                                  vk::ShaderModule shaderModule,
+                                  const char* entryPoint) {
+    vk::ComputePipelineCreateInfo computePipelineCI{
+        .stage =
+            {
+                .stage = vk::ShaderStageFlagBits::eCompute,
+                .module = shaderModule,
+                .pName = entryPoint,
+            },
+        .layout = layout,
+    };
+
+    auto resultValue =
+        device.createComputePipeline(VK_NULL_HANDLE, computePipelineCI);
+    return resultValue.value;
+}
+
+void PipelinePermutations::init(BuildFunc build) {
+    this->build = std::move(build);
+}
+
+vk::Pipeline PipelinePermutations::get(uint32_t mask) {
+    auto& pipeline = pipelines[mask];
+    if (!pipeline) {
+        pipeline = build(mask);
+    }
+    return pipeline;
+}
+
+std::vector<vk::Pipeline> PipelinePermutations::rebuild(uint32_t mask) {
+    auto pipeline = build(mask);
+    auto replaced = release();
+    pipelines[mask] = pipeline;
+    return replaced;
+}
+
+std::vector<vk::Pipeline> PipelinePermutations::release() {
+    std::vector<vk::Pipeline> released;
+    for (auto& [mask, pipeline] : pipelines) {
+        if (pipeline) {
+            released.push_back(pipeline);
+        }
+    }
+    pipelines.clear();
+    return released;
+}
 }  // namespace Engine
\ No newline at end of file
@@ -2,6 +2,10 @@
 
 #include "gfx/vulkan/VulkanUsage.hpp"
 
+#include <functional>
+#include <span>
+#include <unordered_map>
+
 namespace Engine {
 class PipelineBuilder {
    public:
@@ -10,6 +14,19 @@ class PipelineBuilder {
     vk::Pipeline build();
     inline void setLayout(vk::PipelineLayout layout) { this->layout = layout; }
 
+    // Copies the descriptions so callers can pass temporaries, build() points
+    // vertexInputCI at them
+    void setVertexInput(
+        std::span<const vk::VertexInputBindingDescription> bindings,
+        std::span<const vk::VertexInputAttributeDescription> attributes);
+
+    // Specialization constant of a stage by its constant_id, build() hands
+    // them to the stages. Constants are 32 bit, bools become VkBool32.
+    void setSpecialization(vk::ShaderStageFlagBits stage, uint32_t constantId,
+                           uint32_t value);
+    void setSpecialization(vk::ShaderStageFlagBits stage, uint32_t constantId,
+                           bool value);
+
     std::vector<vk::Format> colorAttachmentFormats;
 
     vk::Format colorFormat = vk::Format::eB8G8R8A8Srgb;
@@ -31,6 +48,8 @@ class PipelineBuilder {
     std::vector<vk::PipelineColorBlendAttachmentState>
         colorBlendAttachmentStates{};
     std::vector<vk::DynamicState> dynamicStates{};
+    std::vector<vk::VertexInputBindingDescription> vertexBindings{};
+    std::vector<vk::VertexInputAttributeDescription> vertexAttributes{};
 
     void addColorAttachment(vk::Format format);
     void addColorAttachment(
@@ -38,7 +57,39 @@ class PipelineBuilder {
         vk::PipelineColorBlendAttachmentState colorBlendState);
 
    private:
+    struct SpecializationConstant {
+        vk::ShaderStageFlagBits stage;
+        uint32_t constantId;
+        uint32_t value;
+    };
+
     vk::Device device;
     vk::PipelineLayout layout;
+    std::vector<SpecializationConstant> specializationConstants;
 };
+
+// The pipelines of one set of shaders, one per combination of the feature
+// toggles they bake in as specialization constants. A permutation is built
+// the first time its mask is asked for and kept from then on.
+class PipelinePermutations {
+   public:
+    using BuildFunc = std::function<vk::Pipeline(uint32_t mask)>;
+
+    void init(BuildFunc build);
+    vk::Pipeline get(uint32_t mask);
+    // Builds mask again and drops the other permutations, they are rebuilt
+    // on their next use. Returns the replaced pipelines, frames in flight
+    // may still use them. When the build throws nothing is dropped.
+    std::vector<vk::Pipeline> rebuild(uint32_t mask);
+    // Hands out every pipeline and empties the cache
+    std::vector<vk::Pipeline> release();
+
+   private:
+    BuildFunc build;
+    std::unordered_map<uint32_t, vk::Pipeline> pipelines;
+};
+
+vk::Pipeline buildComputePipeline(vk::Device device, vk::PipelineLayout layout,
+                                  vk::ShaderModule shaderModule,
+                                  const char* entryPoint = "comp");
 }  // namespace Engine
\ No newline at end of file
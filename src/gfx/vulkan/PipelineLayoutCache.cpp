@@ -0,0 +1,145 @@
+#include "gfx/vulkan/PipelineLayoutCache.hpp"
+#include "core/Hash.hpp"
+
+#include <algorithm>
+#include <string>
+
+namespace Engine {
+namespace {
+uint64_t hashBindings(std::span<const vk::DescriptorSetLayoutBinding> bindings,
+                      uint64_t seed = HASH_SEED) {
+    uint64_t hash = hashValue(bindings.size(), seed);
+    for (const auto& binding : bindings) {
+        hash = hashValue(binding.binding, hash);
+        hash = hashValue(binding.descriptorType, hash);
+        hash = hashValue(binding.descriptorCount, hash);
+        hash = hashValue(static_cast<VkShaderStageFlags>(binding.stageFlags),
+                         hash);
+    }
+    return hash;
+}
+
+bool sameBindings(std::span<const vk::DescriptorSetLayoutBinding> a,
+                  std::span<const vk::DescriptorSetLayoutBinding> b) {
+    return std::equal(a.begin(), a.end(), b.begin(), b.end(),
+                      [](const auto& x, const auto& y) {
+                          return x.binding == y.binding &&
+                                 x.descriptorType == y.descriptorType &&
+                                 x.descriptorCount == y.descriptorCount &&
+                                 x.stageFlags == y.stageFlags;
+                      });
+}
+}  // namespace
+
+void PipelineLayoutCache::init(vk::Device device) { this->device = device; }
+
+void PipelineLayoutCache::destroy() {
+    for (auto& [hash, cached] : pipelineLayouts) {
+        device.destroyPipelineLayout(cached.layout.pipelineLayout);
+    }
+    for (auto& [hash, cached] : setLayouts) {
+        device.destroyDescriptorSetLayout(cached.layout);
+    }
+    pipelineLayouts.clear();
+    setLayouts.clear();
+}
+
+const PipelineLayoutInfo& PipelineLayoutCache::getLayout(
+    std::span<const ShaderReflection> stages) {
+    // Bindings of all stages per set, a binding used by several stages
+    // once
+    std::vector<std::vector<vk::DescriptorSetLayoutBinding>> sets;
+    uint32_t pushConstantSize = 0;
+    vk::ShaderStageFlags pushConstantStages;
+    for (const auto& stage : stages) {
+        for (const auto& binding : stage.bindings) {
+            if (sets.size() <= binding.set) {
+                sets.resize(binding.set + 1);
+            }
+            auto& set = sets[binding.set];
+            auto existing = std::find_if(
+                set.begin(), set.end(), [&](const auto& setBinding) {
+                    return setBinding.binding == binding.binding;
+                });
+            if (existing == set.end()) {
+                set.push_back({
+                    .binding = binding.binding,
+                    .descriptorType = binding.type,
+                    .descriptorCount = binding.count,
+                    .stageFlags = vk::ShaderStageFlagBits::eAll,
+                });
+            } else if (existing->descriptorType != binding.type) {
+                throw std::runtime_error(
+                    "stages disagree on set " + std::to_string(binding.set) +
+                    " binding " + std::to_string(binding.binding));
+            }
+        }
+
+        if (stage.pushConstantSize > 0) {
+            pushConstantSize =
+                std::max(pushConstantSize, stage.pushConstantSize);
+            pushConstantStages |= stage.stage;
+        }
+    }
+
+    PipelineLayoutInfo layout;
+    uint64_t hash = hashValue(pushConstantSize);
+    hash =
+        hashValue(static_cast<VkShaderStageFlags>(pushConstantStages), hash);
+    for (auto& set : sets) {
+        std::sort(set.begin(), set.end(), [](const auto& a, const auto& b) {
+            return a.binding < b.binding;
+        });
+        layout.setLayouts.push_back(getSetLayout(set));
+        hash = hashBindings(set, hash);
+    }
+
+    // The set layouts are unique per binding list, comparing the handles
+    // compares the sets
+    auto [first, last] = pipelineLayouts.equal_range(hash);
+    for (auto it = first; it != last; ++it) {
+        const auto& cached = it->second;
+        if (cached.layout.setLayouts == layout.setLayouts &&
+            cached.pushConstantSize == pushConstantSize &&
+            cached.pushConstantStages == pushConstantStages) {
+            return cached.layout;
+        }
+    }
+
+    vk::PushConstantRange pushConstantRange{
+        .stageFlags = pushConstantStages,
+        .offset = 0,
+        .size = pushConstantSize,
+    };
+    layout.pipelineLayout = device.createPipelineLayout({
+        .setLayoutCount = static_cast<uint32_t>(layout.setLayouts.size()),
+        .pSetLayouts = layout.setLayouts.data(),
+        .pushConstantRangeCount = pushConstantSize > 0 ? 1u : 0u,
+        .pPushConstantRanges = &pushConstantRange,
+    });
+    return pipelineLayouts
+        .emplace(hash, CachedPipelineLayout{std::move(layout),
+                                            pushConstantSize,
+                                            pushConstantStages})
+        ->second.layout;
+}
+
+vk::DescriptorSetLayout PipelineLayoutCache::getSetLayout(
+    std::span<const vk::DescriptorSetLayoutBinding> bindings) {
+    auto hash = hashBindings(bindings);
+    auto [first, last] = setLayouts.equal_range(hash);
+    for (auto it = first; it != last; ++it) {
+        if (sameBindings(it->second.bindings, bindings)) {
+            return it->second.layout;
+        }
+    }
+
+    auto layout = device.createDescriptorSetLayout({
+        .bindingCount = static_cast<uint32_t>(bindings.size()),
+        .pBindings = bindings.data(),
+    });
+    setLayouts.emplace(
+        hash, CachedSetLayout{{bindings.begin(), bindings.end()}, layout});
+    return layout;
+}
+}  // namespace Engine
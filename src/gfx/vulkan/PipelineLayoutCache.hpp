@@ -0,0 +1,49 @@
+#pragma once
+
+#include "gfx/vulkan/VulkanUsage.hpp"
+#include "gfx/vulkan/ShaderReflection.hpp"
+
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+namespace Engine {
+struct PipelineLayoutInfo {
+    vk::PipelineLayout pipelineLayout;
+    // Indexed by set, sets no stage uses are empty layouts
+    std::vector<vk::DescriptorSetLayout> setLayouts;
+};
+
+// Layouts derived from the reflected stages of a pipeline, created once per
+// distinct interface and owned by the cache. Set layout bindings are visible
+// to every stage, so pipelines declaring the same set get the same set
+// layout and can share descriptor sets. Push constants keep the stages
+// that declare them, vkCmdPushConstants passes the same flags.
+class PipelineLayoutCache {
+   public:
+    void init(vk::Device device);
+    void destroy();
+
+    const PipelineLayoutInfo& getLayout(
+        std::span<const ShaderReflection> stages);
+    vk::DescriptorSetLayout getSetLayout(
+        std::span<const vk::DescriptorSetLayoutBinding> bindings);
+
+   private:
+    // Keyed by hash, the entries keep what they were created from so a
+    // collision never hands out a layout of another interface
+    struct CachedSetLayout {
+        std::vector<vk::DescriptorSetLayoutBinding> bindings;
+        vk::DescriptorSetLayout layout;
+    };
+    struct CachedPipelineLayout {
+        PipelineLayoutInfo layout;
+        uint32_t pushConstantSize;
+        vk::ShaderStageFlags pushConstantStages;
+    };
+
+    vk::Device device;
+    std::unordered_multimap<uint64_t, CachedSetLayout> setLayouts;
+    std::unordered_multimap<uint64_t, CachedPipelineLayout> pipelineLayouts;
+};
+}  // namespace Engine
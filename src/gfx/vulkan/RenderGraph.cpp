@@ -0,0 +1,428 @@
+#include "gfx/vulkan/RenderGraph.hpp"
+#include "gfx/vulkan/BarrierBatch.hpp"
+#include "gfx/vulkan/Device.hpp"
+
+#include <algorithm>
+
+namespace Engine {
+namespace {
+constexpr uint32_t INVALID_INDEX = ~0u;
+
+constexpr vk::AccessFlags2 WRITE_ACCESS =
+    vk::AccessFlagBits2::eShaderStorageWrite |
+    vk::AccessFlagBits2::eColorAttachmentWrite |
+    vk::AccessFlagBits2::eDepthStencilAttachmentWrite |
+    vk::AccessFlagBits2::eTransferWrite | vk::AccessFlagBits2::eHostWrite |
+    vk::AccessFlagBits2::eMemoryWrite;
+
+struct UsageState {
+    vk::PipelineStageFlags2 stages;
+    vk::AccessFlags2 access;
+    vk::ImageLayout layout;
+};
+
+UsageState getUsageState(RenderGraphUsage usage,
+                         vk::ImageAspectFlags aspect) {
+    // Depth images are sampled in the read only depth layouts
+    vk::ImageLayout readLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+    if (aspect & vk::ImageAspectFlagBits::eStencil) {
+        readLayout = vk::ImageLayout::eDepthStencilReadOnlyOptimal;
+    } else if (aspect & vk::ImageAspectFlagBits::eDepth) {
+        readLayout = vk::ImageLayout::eDepthReadOnlyOptimal;
+    }
+
+    switch (usage) {
+        case RenderGraphUsage::eColorAttachment:
+            return {vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+                    vk::AccessFlagBits2::eColorAttachmentRead |
+                        vk::AccessFlagBits2::eColorAttachmentWrite,
+                    vk::ImageLayout::eColorAttachmentOptimal};
+        case RenderGraphUsage::eDepthAttachment:
+            return {vk::PipelineStageFlagBits2::eEarlyFragmentTests |
+                        vk::PipelineStageFlagBits2::eLateFragmentTests,
+                    vk::AccessFlagBits2::eDepthStencilAttachmentRead |
+                        vk::AccessFlagBits2::eDepthStencilAttachmentWrite,
+                    vk::ImageLayout::eDepthStencilAttachmentOptimal};
+        case RenderGraphUsage::eFragmentSampled:
+            return {vk::PipelineStageFlagBits2::eFragmentShader,
+                    vk::AccessFlagBits2::eShaderSampledRead, readLayout};
+        case RenderGraphUsage::eComputeSampled:
+            return {vk::PipelineStageFlagBits2::eComputeShader,
+                    vk::AccessFlagBits2::eShaderSampledRead, readLayout};
+        case RenderGraphUsage::eComputeStorageRead:
+            return {vk::PipelineStageFlagBits2::eComputeShader,
+                    vk::AccessFlagBits2::eShaderStorageRead,
+                    vk::ImageLayout::eGeneral};
+        case RenderGraphUsage::eComputeStorageWrite:
+            return {vk::PipelineStageFlagBits2::eComputeShader,
+                    vk::AccessFlagBits2::eShaderStorageWrite,
+                    vk::ImageLayout::eGeneral};
+        case RenderGraphUsage::eIndirectRead:
+            return {vk::PipelineStageFlagBits2::eDrawIndirect,
+                    vk::AccessFlagBits2::eIndirectCommandRead,
+                    vk::ImageLayout::eUndefined};
+        case RenderGraphUsage::eTransferRead:
+            return {vk::PipelineStageFlagBits2::eAllTransfer,
+                    vk::AccessFlagBits2::eTransferRead,
+                    vk::ImageLayout::eTransferSrcOptimal};
+        case RenderGraphUsage::eTransferWrite:
+            return {vk::PipelineStageFlagBits2::eAllTransfer,
+                    vk::AccessFlagBits2::eTransferWrite,
+                    vk::ImageLayout::eTransferDstOptimal};
+        case RenderGraphUsage::ePresent:
+            // The present semaphore does the waiting, nothing follows
+            return {vk::PipelineStageFlagBits2::eNone,
+                    vk::AccessFlagBits2::eNone,
+                    vk::ImageLayout::ePresentSrcKHR};
+    }
+
+    throw std::runtime_error("unknown render graph usage");
+}
+}  // namespace
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::read(
+    RenderGraphHandle resource, RenderGraphUsage usage) {
+    graph->passes[passIndex].accesses.push_back({resource, usage, false});
+    return *this;
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::write(
+    RenderGraphHandle resource, RenderGraphUsage usage) {
+    graph->passes[passIndex].accesses.push_back({resource, usage, true});
+    return *this;
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::setSideEffect() {
+    graph->passes[passIndex].sideEffect = true;
+    return *this;
+}
+
+void RenderGraph::init(Device* device) {
+    this->device = device;
+    transientPool.init(device);
+}
+
+void RenderGraph::destroy() {
+    transientPool.destroy();
+    imageStates.clear();
+    bufferStates.clear();
+    resources.clear();
+    passes.clear();
+}
+
+void RenderGraph::reset() {
+    resources.clear();
+    passes.clear();
+    frame++;
+    releaseTransients();
+}
+
+RenderGraphHandle RenderGraph::importImage(const char* name, vk::Image image,
+                                           vk::ImageAspectFlags aspect,
+                                           vk::ImageLayout fixedLayout) {
+    resources.push_back({
+        .name = name,
+        .isImage = true,
+        .image = image,
+        .aspect = aspect,
+        .fixedLayout = fixedLayout,
+    });
+    return static_cast<RenderGraphHandle>(resources.size() - 1);
+}
+
+RenderGraphHandle RenderGraph::importAcquiredImage(
+    const char* name, vk::Image image, vk::PipelineStageFlags2 waitStage) {
+    // Writes ordered behind the semaphore wait chain onto it
+    imageStates[image] = {
+        .layout = vk::ImageLayout::eUndefined,
+        .writeStages = waitStage,
+    };
+    return importImage(name, image, vk::ImageAspectFlagBits::eColor);
+}
+
+RenderGraphHandle RenderGraph::importBuffer(const char* name,
+                                            vk::Buffer buffer) {
+    resources.push_back({
+        .name = name,
+        .isImage = false,
+        .buffer = buffer,
+    });
+    return static_cast<RenderGraphHandle>(resources.size() - 1);
+}
+
+RenderGraphHandle RenderGraph::createImage(const char* name,
+                                           const TransientImageDesc& desc) {
+    resources.push_back({
+        .name = name,
+        .isImage = true,
+        .aspect = desc.aspect,
+        .transient = true,
+        .desc = desc,
+        .transientIndex = INVALID_INDEX,
+    });
+    return static_cast<RenderGraphHandle>(resources.size() - 1);
+}
+
+const Texture& RenderGraph::getTexture(RenderGraphHandle resource) const {
+    const auto& transient = resources[resource];
+    if (!transient.transient || transient.transientIndex == INVALID_INDEX) {
+        throw std::runtime_error("render graph image has no texture");
+    }
+    return transientPool.getTexture(transient.transientIndex);
+}
+
+void RenderGraph::markOutput(RenderGraphHandle resource) {
+    resources[resource].output = true;
+}
+
+void RenderGraph::markOutput(RenderGraphHandle resource,
+                             RenderGraphUsage finalUsage) {
+    resources[resource].output = true;
+    resources[resource].hasFinalUsage = true;
+    resources[resource].finalUsage = finalUsage;
+}
+
+RenderGraph::PassBuilder RenderGraph::addPass(const char* name,
+                                              ExecuteFunc execute) {
+    passes.push_back({.name = name, .execute = std::move(execute)});
+    return PassBuilder(this, static_cast<uint32_t>(passes.size() - 1));
+}
+
+void RenderGraph::execute(vk::CommandBuffer cmdBuffer) {
+    cullPasses();
+    placeTransients();
+
+    // The UI records inside the graph, so the counts it shows are the
+    // previous frame's
+    uint32_t executedPassCount = 0;
+    uint32_t recordedBarrierCount = 0;
+    for (const auto& pass : passes) {
+        if (pass.culled) {
+            continue;
+        }
+        recordedBarrierCount += recordBarriers(cmdBuffer, pass.accesses);
+        pass.execute(cmdBuffer);
+        executedPassCount++;
+    }
+    recordedBarrierCount += recordFinalBarriers(cmdBuffer);
+
+    passCount = executedPassCount;
+    barrierCount = recordedBarrierCount;
+}
+
+void RenderGraph::forget(vk::Image image) { imageStates.erase(image); }
+
+void RenderGraph::forget(vk::Buffer buffer) { bufferStates.erase(buffer); }
+
+void RenderGraph::cullPasses() {
+    // Walk back from the outputs, a write is taken to replace the contents
+    // so passes that keep them declare a read as well
+    std::vector<bool> needed(resources.size());
+    for (size_t i = 0; i < resources.size(); i++) {
+        needed[i] = resources[i].output;
+    }
+
+    culledPassCount = 0;
+    for (auto pass = passes.rbegin(); pass != passes.rend(); ++pass) {
+        bool used = pass->sideEffect ||
+                    std::any_of(pass->accesses.begin(), pass->accesses.end(),
+                                [&](const Access& access) {
+                                    return access.write &&
+                                           needed[access.resource];
+                                });
+        pass->culled = !used;
+        if (!used) {
+            culledPassCount++;
+            continue;
+        }
+
+        for (const auto& access : pass->accesses) {
+            if (access.write) {
+                needed[access.resource] = false;
+            }
+        }
+        for (const auto& access : pass->accesses) {
+            if (!access.write) {
+                needed[access.resource] = true;
+            }
+        }
+    }
+}
+
+void RenderGraph::placeTransients() {
+    std::vector<uint32_t> firstPass(resources.size(), INVALID_INDEX);
+    std::vector<uint32_t> lastPass(resources.size(), 0);
+    for (uint32_t i = 0; i < passes.size(); i++) {
+        if (passes[i].culled) {
+            continue;
+        }
+        for (const auto& access : passes[i].accesses) {
+            firstPass[access.resource] =
+                std::min(firstPass[access.resource], i);
+            lastPass[access.resource] = i;
+        }
+    }
+
+    std::vector<TransientImageRequest> requests;
+    for (uint32_t i = 0; i < resources.size(); i++) {
+        auto& resource = resources[i];
+        if (!resource.transient || firstPass[i] == INVALID_INDEX) {
+            continue;
+        }
+        resource.transientIndex = static_cast<uint32_t>(requests.size());
+        resource.firstUse = true;
+        requests.push_back({resource.desc, firstPass[i], lastPass[i]});
+    }
+    if (requests.empty()) {
+        return;
+    }
+
+    transientPool.place(requests, frame);
+    for (const auto& resource : resources) {
+        if (resource.transient && resource.transientIndex != INVALID_INDEX) {
+            // Nothing of the previous contents is kept, the stages of the
+            // last use still have to be waited on
+            imageStates[getImage(resource)].layout =
+                vk::ImageLayout::eUndefined;
+        }
+    }
+}
+
+void RenderGraph::releaseTransients() {
+    for (auto image : transientPool.releaseUnused(frame)) {
+        imageStates.erase(image);
+    }
+}
+
+vk::Image RenderGraph::getImage(const Resource& resource) const {
+    if (resource.transient) {
+        return transientPool.getTexture(resource.transientIndex).image;
+    }
+    return resource.image;
+}
+
+RenderGraph::ResourceState& RenderGraph::getState(const Resource& resource) {
+    if (resource.isImage) {
+        return imageStates[getImage(resource)];
+    }
+    return bufferStates[resource.buffer];
+}
+
+bool RenderGraph::recordBarriers(vk::CommandBuffer cmdBuffer,
+                                 const std::vector<Access>& accesses) {
+    // Accesses of one resource are merged, a pass may e.g. clear a buffer
+    // and then write it from a shader
+    struct MergedAccess {
+        RenderGraphHandle resource;
+        UsageState state;
+        bool write;
+    };
+    std::vector<MergedAccess> merged;
+    for (const auto& access : accesses) {
+        const auto& resource = resources[access.resource];
+        auto state = getUsageState(access.usage, resource.aspect);
+        if (!resource.isImage) {
+            state.layout = vk::ImageLayout::eUndefined;
+        } else if (resource.fixedLayout != vk::ImageLayout::eUndefined) {
+            state.layout = resource.fixedLayout;
+        }
+
+        auto it = std::find_if(merged.begin(), merged.end(),
+                               [&](const MergedAccess& m) {
+                                   return m.resource == access.resource;
+                               });
+        if (it == merged.end()) {
+            merged.push_back({access.resource, state, access.write});
+            continue;
+        }
+        if (it->state.layout != state.layout) {
+            throw std::runtime_error(
+                std::string("render graph resource used in two layouts: ") +
+                resource.name);
+        }
+        it->state.stages |= state.stages;
+        it->state.access |= state.access;
+        it->write |= access.write;
+    }
+
+    BarrierBatch barriers;
+    for (const auto& access : merged) {
+        auto& resource = resources[access.resource];
+        auto& state = getState(resource);
+        if (resource.transient && resource.firstUse) {
+            // Whatever last used the memory under another image has to be
+            // done before this one takes it over
+            const auto& aliases =
+                transientPool.getAliases(resource.transientIndex);
+            for (auto alias : aliases) {
+                const auto& aliasState = imageStates[alias];
+                state.writeStages |=
+                    aliasState.writeStages | aliasState.readStages;
+                state.writeAccess |= aliasState.writeAccess;
+            }
+            resource.firstUse = false;
+        }
+        const auto& usage = access.state;
+        bool layoutChange = resource.isImage && state.layout != usage.layout;
+
+        vk::PipelineStageFlags2 waitStages;
+        vk::AccessFlags2 waitAccess;
+        if (layoutChange || access.write) {
+            // Waits on the last write and on every read since
+            waitStages = state.writeStages | state.readStages;
+            waitAccess = state.writeAccess;
+        } else if (state.writeStages &&
+                   ((usage.stages & ~state.readStages) ||
+                    (usage.access & ~state.readAccess))) {
+            waitStages = state.writeStages;
+            waitAccess = state.writeAccess;
+        }
+
+        // First uses wait on nothing, eNone replaces TOP_OF_PIPE here
+        if (resource.isImage && (layoutChange || waitStages)) {
+            barriers.addImage(getImage(resource),
+                              wholeImageRange(resource.aspect), waitStages,
+                              waitAccess, usage.stages, usage.access,
+                              state.layout, usage.layout);
+        } else if (waitStages) {
+            // Buffers are ordered with a global barrier, which is what
+            // drivers turn buffer barriers into anyway
+            barriers.addMemory(waitStages, waitAccess, usage.stages,
+                               usage.access);
+        }
+
+        if (access.write) {
+            state.writeStages = usage.stages;
+            state.writeAccess = usage.access & WRITE_ACCESS;
+            state.readStages = {};
+            state.readAccess = {};
+        } else if (layoutChange) {
+            // The transition counts as a write the readers here already see
+            state.writeStages = usage.stages;
+            state.writeAccess = {};
+            state.readStages = usage.stages;
+            state.readAccess = usage.access;
+        } else {
+            state.readStages |= usage.stages;
+            state.readAccess |= usage.access;
+        }
+        state.layout = usage.layout;
+    }
+
+    if (barriers.empty()) {
+        return false;
+    }
+    barriers.record(cmdBuffer);
+    return true;
+}
+
+bool RenderGraph::recordFinalBarriers(vk::CommandBuffer cmdBuffer) {
+    std::vector<Access> finalAccesses;
+    for (uint32_t i = 0; i < resources.size(); i++) {
+        if (resources[i].hasFinalUsage) {
+            finalAccesses.push_back({i, resources[i].finalUsage, false});
+        }
+    }
+    return recordBarriers(cmdBuffer, finalAccesses);
+}
+}  // namespace Engine
@@ -0,0 +1,170 @@
+#pragma once
+
+#include "gfx/vulkan/VulkanUsage.hpp"
+#include "gfx/vulkan/Resource.hpp"
+#include "gfx/vulkan/TransientAttachmentPool.hpp"
+
+#include <functional>
+#include <unordered_map>
+
+namespace Engine {
+class Device;
+
+using RenderGraphHandle = uint32_t;
+
+// How a pass touches a resource. Each usage maps to the pipeline stages,
+// access mask and, for images, the layout the barriers are derived from.
+enum class RenderGraphUsage {
+    eColorAttachment,
+    eDepthAttachment,
+    eFragmentSampled,
+    eComputeSampled,
+    eComputeStorageRead,
+    eComputeStorageWrite,
+    eIndirectRead,
+    eTransferRead,
+    eTransferWrite,
+    ePresent,
+};
+
+// Frame graph over a single command buffer. Passes declare what they read
+// and write, execute() drops the passes nothing consumes, places the
+// transients and records every pass behind one batch of synchronization2
+// barriers derived from the last use of each resource. The last use is
+// remembered across frames, so imported images keep their layout instead
+// of restarting from eUndefined every frame.
+class RenderGraph {
+   public:
+    using ExecuteFunc = std::function<void(vk::CommandBuffer)>;
+
+    class PassBuilder {
+       public:
+        PassBuilder& read(RenderGraphHandle resource, RenderGraphUsage usage);
+        PassBuilder& write(RenderGraphHandle resource,
+                           RenderGraphUsage usage);
+
+        // Keeps the pass even when nothing reads what it writes
+        PassBuilder& setSideEffect();
+
+       private:
+        friend class RenderGraph;
+        PassBuilder(RenderGraph* graph, uint32_t passIndex)
+            : graph(graph), passIndex(passIndex) {}
+
+        RenderGraph* graph;
+        uint32_t passIndex;
+    };
+
+    void init(Device* device);
+    void destroy();
+
+    // Drops the passes and resources of the previous frame
+    void reset();
+
+    // fixedLayout pins images that never change layout, like the depth
+    // pyramid in eGeneral, every usage then keeps it
+    RenderGraphHandle importImage(
+        const char* name, vk::Image image, vk::ImageAspectFlags aspect,
+        vk::ImageLayout fixedLayout = vk::ImageLayout::eUndefined);
+    // An image with undefined contents that becomes available at waitStage,
+    // like a swapchain image behind the acquire semaphore
+    RenderGraphHandle importAcquiredImage(const char* name, vk::Image image,
+                                          vk::PipelineStageFlags2 waitStage);
+    RenderGraphHandle importBuffer(const char* name, vk::Buffer buffer);
+    // Transients whose passes do not overlap share memory, see
+    // TransientAttachmentPool
+    RenderGraphHandle createImage(const char* name,
+                                  const TransientImageDesc& desc);
+
+    // The image behind a transient, only valid while the graph executes
+    const Texture& getTexture(RenderGraphHandle resource) const;
+
+    // Consumed after the graph, keeps its writers alive. A finalUsage with
+    // another layout, e.g. ePresent, is transitioned to after the last pass.
+    void markOutput(RenderGraphHandle resource);
+    void markOutput(RenderGraphHandle resource, RenderGraphUsage finalUsage);
+
+    PassBuilder addPass(const char* name, ExecuteFunc execute);
+
+    void execute(vk::CommandBuffer cmdBuffer);
+
+    // Call before an imported image or buffer is destroyed, a new one may
+    // reuse the handle
+    void forget(vk::Image image);
+    void forget(vk::Buffer buffer);
+
+    // Of the last execute()
+    uint32_t getPassCount() const { return passCount; }
+    uint32_t getCulledPassCount() const { return culledPassCount; }
+    uint32_t getBarrierCount() const { return barrierCount; }
+
+   private:
+    // Last use of a resource. Readers since the last write are gathered so
+    // the next write waits on all of them, and so a reader at a stage that
+    // already saw the write needs no barrier of its own.
+    struct ResourceState {
+        vk::ImageLayout layout = vk::ImageLayout::eUndefined;
+        vk::PipelineStageFlags2 writeStages;
+        vk::AccessFlags2 writeAccess;
+        vk::PipelineStageFlags2 readStages;
+        vk::AccessFlags2 readAccess;
+    };
+
+    struct Resource {
+        const char* name;
+        bool isImage;
+        vk::Image image;
+        vk::Buffer buffer;
+        vk::ImageAspectFlags aspect;
+        vk::ImageLayout fixedLayout = vk::ImageLayout::eUndefined;
+
+        bool transient = false;
+        TransientImageDesc desc;
+        uint32_t transientIndex;
+        // Set until the first pass of the frame that touches it
+        bool firstUse = false;
+
+        bool output = false;
+        bool hasFinalUsage = false;
+        RenderGraphUsage finalUsage;
+    };
+
+    struct Access {
+        RenderGraphHandle resource;
+        RenderGraphUsage usage;
+        bool write;
+    };
+
+    struct Pass {
+        const char* name;
+        ExecuteFunc execute;
+        std::vector<Access> accesses;
+        bool sideEffect = false;
+        bool culled = false;
+    };
+
+    Device* device;
+    uint64_t frame = 0;
+
+    std::vector<Resource> resources;
+    std::vector<Pass> passes;
+    TransientAttachmentPool transientPool;
+
+    std::unordered_map<vk::Image, ResourceState> imageStates;
+    std::unordered_map<vk::Buffer, ResourceState> bufferStates;
+
+    uint32_t passCount = 0;
+    uint32_t culledPassCount = 0;
+    uint32_t barrierCount = 0;
+
+    void cullPasses();
+    void placeTransients();
+    void releaseTransients();
+    vk::Image getImage(const Resource& resource) const;
+    ResourceState& getState(const Resource& resource);
+    // Both return whether a barrier was recorded
+    bool recordBarriers(vk::CommandBuffer cmdBuffer,
+                        const std::vector<Access>& accesses);
+    bool recordFinalBarriers(vk::CommandBuffer cmdBuffer);
+};
+}  // namespace Engine
@@ -1,7 +1,19 @@
 #include "gfx/vulkan/Renderer.hpp"
 #include "gfx/vulkan/Utils.hpp"
 
+#include <bit>
+
 namespace Engine {
+namespace {
+// Past 4x the extra samples cost far more fill rate and memory than the
+// aliasing they remove, higher counts stay available on request
+constexpr vk::SampleCountFlagBits DEFAULT_MSAA_SAMPLES =
+    vk::SampleCountFlagBits::e4;
+
+// Per frame in flight, plenty for a handful of per view and per pass blocks
+constexpr vk::DeviceSize UNIFORM_RING_FRAME_SIZE = 64 * 1024;
+}  // namespace
+
 void Renderer::init(Device *device) {
     this->device = device;
 
@@ -41,24 +53,13 @@ void Renderer::init(Device *device) {
     }
 
     auto physicalDeviceProperties = physicalDevice.getProperties();
-    vk::SampleCountFlags counts =
-        physicalDeviceProperties.limits.framebufferColorSampleCounts |
-        physicalDeviceProperties.limits.framebufferDepthSampleCounts;
-
-    if (counts & vk::SampleCountFlagBits::e64)
-        msaaSamples = vk::SampleCountFlagBits::e64;
-    else if (counts & vk::SampleCountFlagBits::e32)
-        msaaSamples = vk::SampleCountFlagBits::e32;
-    else if (counts & vk::SampleCountFlagBits::e16)
-        msaaSamples = vk::SampleCountFlagBits::e16;
-    else if (counts & vk::SampleCountFlagBits::e8)
-        msaaSamples = vk::SampleCountFlagBits::e8;
-    else if (counts & vk::SampleCountFlagBits::e4)
-        msaaSamples = vk::SampleCountFlagBits::e4;
-    else if (counts & vk::SampleCountFlagBits::e2)
-        msaaSamples = vk::SampleCountFlagBits::e2;
-    else
-        msaaSamples = vk::SampleCountFlagBits::e1;
+    // Color and depth render together, a count has to work for both
+    auto counts = static_cast<uint32_t>(
+        physicalDeviceProperties.limits.framebufferColorSampleCounts &
+        physicalDeviceProperties.limits.framebufferDepthSampleCounts);
+    maxMsaaSamples =
+        static_cast<vk::SampleCountFlagBits>(std::bit_floor(counts));
+    msaaSamples = std::min(maxMsaaSamples, DEFAULT_MSAA_SAMPLES);
 
     queryPool = logicalDevice.createQueryPool({
         .queryType = vk::QueryType::eTimestamp,
@@ -72,12 +73,19 @@ void Renderer::init(Device *device) {
         .commandBufferCount = MAX_FRAMES_IN_FLIGHT,
     });
 
+    renderGraph.init(device);
+    shaderReloader.init(device);
+    uniformRing.init(device, UNIFORM_RING_FRAME_SIZE);
+
     onInit();
 }
 
 void Renderer::destroy() {
     onDestroy();
 
+    shaderReloader.destroy();
+    uniformRing.destroy();
+    renderGraph.destroy();
     getFinalColorTexture().destroy();
 
     auto logicalDevice = device->getLogicalDevice();
@@ -109,6 +117,14 @@ void Renderer::prepare() {
 }
 
 void Renderer::update() {
+    // onUpdate() writes the frame's uniforms, the frame that used this slot
+    // before has to be done reading them
+    auto logicalDevice = device->getLogicalDevice();
+    auto result = logicalDevice.waitForFences(fences.inFlight[currentFrame],
+                                              vk::True, UINT64_MAX);
+    assert(result == vk::Result::eSuccess);
+    uniformRing.begin(currentFrame);
+
     auto uiLayout = device->getUiLayout();
 
     if (uiLayout->getOffscreenSizeChanged()) {
@@ -119,6 +135,7 @@ void Renderer::update() {
         }
 
         auto &colorTexture = getFinalColorTexture();
+        renderGraph.forget(colorTexture.image);
         colorTexture.destroy();
         colorTexture.allocate(getFinalExtent(), 1, swapchain->format,
                               vk::ImageUsageFlagBits::eColorAttachment |
@@ -135,6 +152,8 @@ void Renderer::update() {
         uiLayout->setOffscreenSizeChanged(false);
     }
 
+    // Between frames, the pipelines a rebuild replaces are retired
+    shaderReloader.update();
     onUpdate();
 }
 
@@ -144,11 +163,12 @@ void Renderer::render() {
     submitFrame();
 }
 
+// The frame's fence was waited on in update()
 void Renderer::prepareFrame() {
     auto logicalDevice = device->getLogicalDevice();
-    auto result = logicalDevice.waitForFences(fences.inFlight[currentFrame],
-                                              vk::True, UINT64_MAX);
-    assert(result == vk::Result::eSuccess);
+    // The frame that used this slot before is done. Only counted for
+    // rendered frames, update() also runs while minimized.
+    shaderReloader.releaseRetired();
 
     imageIndex =
         swapchain->acquireNextImage(semaphores.imageAvailable[currentFrame]);
@@ -169,36 +189,45 @@ void Renderer::drawFrame() {
     cmdBuffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, queryPool,
                              0);
 
-    imageLayoutTransition(
-        cmdBuffer, vk::ImageAspectFlagBits::eColor,
-        vk::PipelineStageFlagBits::eTopOfPipe,
-        vk::PipelineStageFlagBits::eColorAttachmentOutput,
-        vk::AccessFlagBits::eNone, vk::AccessFlagBits::eColorAttachmentWrite,
-        vk::ImageLayout::eUndefined, vk::ImageLayout::eColorAttachmentOptimal,
-        swapchain->getImage(imageIndex));
-
-    if (device->getUiLayout()->isOffscreenRenderable()) {
-        imageLayoutTransition(cmdBuffer, vk::ImageAspectFlagBits::eColor,
-                              vk::PipelineStageFlagBits::eTopOfPipe,
-                              vk::PipelineStageFlagBits::eColorAttachmentOutput,
-                              vk::AccessFlagBits::eNone,
-                              vk::AccessFlagBits::eColorAttachmentWrite,
-                              vk::ImageLayout::eUndefined,
-                              vk::ImageLayout::eColorAttachmentOptimal,
-                              getFinalColorTexture().image);
-
-        draw();
-
-        imageLayoutTransition(cmdBuffer, vk::ImageAspectFlagBits::eColor,
-                              vk::PipelineStageFlagBits::eColorAttachmentOutput,
-                              vk::PipelineStageFlagBits::eFragmentShader,
-                              vk::AccessFlagBits::eColorAttachmentWrite,
-                              vk::AccessFlagBits::eShaderRead,
-                              vk::ImageLayout::eColorAttachmentOptimal,
-                              vk::ImageLayout::eShaderReadOnlyOptimal,
-                              getFinalColorTexture().image);
+    renderGraph.reset();
+
+    // The acquire semaphore is waited on at color attachment output
+    auto swapchainImage = renderGraph.importAcquiredImage(
+        "swapchain", swapchain->getImage(imageIndex),
+        vk::PipelineStageFlagBits2::eColorAttachmentOutput);
+
+    bool renderable = device->getUiLayout()->isOffscreenRenderable();
+    RenderGraphHandle finalColor;
+    if (renderable) {
+        finalColor =
+            renderGraph.importImage("final color", getFinalColorTexture().image,
+                                    vk::ImageAspectFlagBits::eColor);
+        setupRenderGraph(renderGraph, finalColor);
     }
 
+    auto uiPass = renderGraph.addPass(
+        "ui", [this](vk::CommandBuffer cmdBuffer) { recordUi(cmdBuffer); });
+    uiPass.write(swapchainImage, RenderGraphUsage::eColorAttachment);
+    if (renderable) {
+        uiPass.read(finalColor, RenderGraphUsage::eFragmentSampled);
+    }
+    declareUiReads(uiPass);
+    renderGraph.markOutput(swapchainImage, RenderGraphUsage::ePresent);
+
+    renderGraph.execute(cmdBuffer);
+
+    cmdBuffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe,
+                             queryPool, 1);
+    cmdBuffer.end();
+}
+
+void Renderer::setupRenderGraph(RenderGraph &graph,
+                                RenderGraphHandle finalColor) {
+    graph.addPass("scene", [this](vk::CommandBuffer) { draw(); })
+        .write(finalColor, RenderGraphUsage::eColorAttachment);
+}
+
+void Renderer::recordUi(vk::CommandBuffer cmdBuffer) {
     vk::RenderingAttachmentInfo swapChainAttachmentInfo{
         .imageView = swapchain->getImageView(imageIndex),
         .imageLayout = vk::ImageLayout::eColorAttachmentOptimal,
@@ -226,18 +255,6 @@ void Renderer::drawFrame() {
     drawUi();
     device->getUiLayout()->record(cmdBuffer);
     cmdBuffer.endRendering();
-
-    imageLayoutTransition(
-        cmdBuffer, vk::ImageAspectFlagBits::eColor,
-        vk::PipelineStageFlagBits::eColorAttachmentOutput,
-        vk::PipelineStageFlagBits::eBottomOfPipe,
-        vk::AccessFlagBits::eColorAttachmentWrite, vk::AccessFlagBits::eNone,
-        vk::ImageLayout::eColorAttachmentOptimal,
-        vk::ImageLayout::ePresentSrcKHR, swapchain->getImage(imageIndex));
-
-    cmdBuffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe,
-                             queryPool, 1);
-    cmdBuffer.end();
 }
 
 void Renderer::submitFrame() {
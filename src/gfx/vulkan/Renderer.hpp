@@ -1,6 +1,9 @@
 #pragma once
 
 #include "gfx/vulkan/Device.hpp"
+#include "gfx/vulkan/RenderGraph.hpp"
+#include "gfx/vulkan/ShaderReloader.hpp"
+#include "gfx/vulkan/UniformRing.hpp"
 #include "gfx/vulkan/UiLayout.hpp"
 #include "gfx/vulkan/Swapchain.hpp"
 
@@ -43,12 +46,19 @@ class Renderer {
     virtual void onWindowResize() {}
     virtual void onSceneResize() {}
 
-    virtual void draw() = 0;
+    // Adds the passes that render the final color texture. By default a
+    // single pass writes it as a color attachment and records draw().
+    virtual void setupRenderGraph(RenderGraph &graph,
+                                  RenderGraphHandle finalColor);
+    virtual void draw() {}
     virtual void drawUi() {}
+    // Resources of the graph that drawUi() samples, e.g. debug views
+    virtual void declareUiReads(RenderGraph::PassBuilder &pass) {}
 
     void prepareFrame();
     void drawFrame();
     void submitFrame();
+    void recordUi(vk::CommandBuffer cmdBuffer);
 
     Device *device;
 
@@ -57,10 +67,20 @@ class Renderer {
     uint64_t timestampPeriod;
 
     uint32_t imageIndex;
+    // Defaults to the highest supported count up to 4x. Changing it only
+    // changes what the next frame renders with, see MsaaTargets.
     vk::SampleCountFlagBits msaaSamples = vk::SampleCountFlagBits::e1;
+    vk::SampleCountFlagBits maxMsaaSamples = vk::SampleCountFlagBits::e1;
 
     std::vector<vk::CommandBuffer> drawCmdBuffers;
     std::unique_ptr<Swapchain> swapchain;
+    RenderGraph renderGraph;
+    // Register pipelines with watch() to rebuild them when their shaders
+    // are edited
+    ShaderReloader shaderReloader;
+    // Starts over on the current frame's region before onUpdate(), bind
+    // what is pushed there as eUniformBufferDynamic
+    UniformRing uniformRing;
 
     vk::AttachmentLoadOp swapchainLoadOp = vk::AttachmentLoadOp::eClear;
 
@@ -3,7 +3,9 @@
 
 #include "gfx/vulkan/Resource.hpp"
 #include "gfx/vulkan/Utils.hpp"
+#include "gfx/vulkan/BarrierBatch.hpp"
 #include "gfx/vulkan/Device.hpp"
+#include "core/MappedFile.hpp"
 
 namespace Engine {
 void Buffer::allocate(vk::DeviceSize size, vk::BufferUsageFlags usage,
@@ -42,9 +44,16 @@ void Buffer::destroy() {
 void Texture::loadFromFile(const char* filename) {
     std::string fullPath = RESOURCE_DIR + std::string(filename);
 
+    // Decode straight from the mapped pages rather than through stdio
+    MappedFile file(fullPath);
+    auto fileData = file.data();
+
     int texWidth, texHeight, texChannels;
-    stbi_uc* pixels = stbi_load(fullPath.c_str(), &texWidth, &texHeight,
-                                &texChannels, STBI_rgb_alpha);
+    stbi_uc* pixels = stbi_load_from_memory(
+        reinterpret_cast<const stbi_uc*>(fileData.data()),
+        static_cast<int>(fileData.size()), &texWidth, &texHeight,
+        &texChannels, STBI_rgb_alpha);
+    file.close();
     if (!pixels) {
         throw std::runtime_error("Failed to load texture image!");
     }
@@ -71,13 +80,16 @@ void Texture::loadFromFile(const char* filename) {
         vk::ImageAspectFlagBits::eColor);
     createSampler();
 
+    // Upload and mip generation share one submission. Level i - 1 turns
+    // into a blit source right before level i is blitted from it, all
+    // levels go to eShaderReadOnlyOptimal together at the end.
     auto cmdBuffer = device->allocateCommandBuffer();
     imageLayoutTransition(
         cmdBuffer, vk::ImageAspectFlagBits::eColor,
-        vk::PipelineStageFlagBits::eTopOfPipe,
-        vk::PipelineStageFlagBits::eTransfer, vk::AccessFlagBits::eNone,
-        vk::AccessFlagBits::eTransferWrite, vk::ImageLayout::eUndefined,
-        vk::ImageLayout::eTransferDstOptimal, image, mipLevels);
+        vk::PipelineStageFlagBits2::eNone, vk::PipelineStageFlagBits2::eCopy,
+        vk::AccessFlagBits2::eNone, vk::AccessFlagBits2::eTransferWrite,
+        vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal,
+        image);
 
     cmdBuffer.copyBufferToImage(
         stagingBuffer.buffer, image, vk::ImageLayout::eTransferDstOptimal,
@@ -97,39 +109,31 @@ void Texture::loadFromFile(const char* filename) {
                             static_cast<uint32_t>(texHeight), 1},
         }});
 
-    device->flushCommandBuffer(cmdBuffer);
-    stagingBuffer.destroy();
-
-    // Generate Mipmaps
-    cmdBuffer = device->allocateCommandBuffer();
-    vk::ImageMemoryBarrier barrier{
-        .oldLayout = vk::ImageLayout::eTransferDstOptimal,
-        .newLayout = vk::ImageLayout::eTransferSrcOptimal,
-        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-        .image = image,
-        .subresourceRange =
-            {
-                .aspectMask = vk::ImageAspectFlagBits::eColor,
-                .levelCount = 1,
-                .baseArrayLayer = 0,
-                .layerCount = 1,
-            },
+    auto mipRange = [](uint32_t baseMipLevel, uint32_t levelCount) {
+        return vk::ImageSubresourceRange{
+            .aspectMask = vk::ImageAspectFlagBits::eColor,
+            .baseMipLevel = baseMipLevel,
+            .levelCount = levelCount,
+            .baseArrayLayer = 0,
+            .layerCount = 1,
+        };
     };
 
     int32_t mipWidth = texWidth;
     int32_t mipHeight = texHeight;
+    BarrierBatch barriers;
 
     for (uint32_t i = 1; i < mipLevels; i++) {
-        barrier.subresourceRange.baseMipLevel = i - 1;
-        barrier.oldLayout = vk::ImageLayout::eTransferDstOptimal;
-        barrier.newLayout = vk::ImageLayout::eTransferSrcOptimal;
-        barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
-        barrier.dstAccessMask = vk::AccessFlagBits::eTransferRead;
-
-        cmdBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
-                                  vk::PipelineStageFlagBits::eTransfer, {},
-                                  nullptr, nullptr, barrier);
+        barriers
+            .addImage(image, mipRange(i - 1, 1),
+                      vk::PipelineStageFlagBits2::eCopy |
+                          vk::PipelineStageFlagBits2::eBlit,
+                      vk::AccessFlagBits2::eTransferWrite,
+                      vk::PipelineStageFlagBits2::eBlit,
+                      vk::AccessFlagBits2::eTransferRead,
+                      vk::ImageLayout::eTransferDstOptimal,
+                      vk::ImageLayout::eTransferSrcOptimal)
+            .record(cmdBuffer);
 
         vk::ImageBlit blit{
             .srcSubresource = {vk::ImageAspectFlagBits::eColor, i - 1, 0, 1},
@@ -153,28 +157,30 @@ void Texture::loadFromFile(const char* filename) {
         cmdBuffer.blitImage(image, vk::ImageLayout::eTransferSrcOptimal, image,
                             vk::ImageLayout::eTransferDstOptimal, blit,
                             vk::Filter::eLinear);
-
-        barrier.oldLayout = vk::ImageLayout::eTransferSrcOptimal;
-        barrier.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
-        barrier.srcAccessMask = vk::AccessFlagBits::eTransferRead;
-        barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
-
-        cmdBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
-                                  vk::PipelineStageFlagBits::eFragmentShader,
-                                  {}, nullptr, nullptr, barrier);
     }
 
-    barrier.subresourceRange.baseMipLevel = mipLevels - 1;
-    barrier.oldLayout = vk::ImageLayout::eTransferDstOptimal;
-    barrier.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
-    barrier.srcAccessMask = vk::AccessFlagBits::eTransferRead;
-    barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
-
-    cmdBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
-                              vk::PipelineStageFlagBits::eFragmentShader, {},
-                              nullptr, nullptr, barrier);
+    if (mipLevels > 1) {
+        barriers.addImage(image, mipRange(0, mipLevels - 1),
+                          vk::PipelineStageFlagBits2::eBlit,
+                          vk::AccessFlagBits2::eNone,
+                          vk::PipelineStageFlagBits2::eFragmentShader,
+                          vk::AccessFlagBits2::eShaderSampledRead,
+                          vk::ImageLayout::eTransferSrcOptimal,
+                          vk::ImageLayout::eShaderReadOnlyOptimal);
+    }
+    barriers
+        .addImage(image, mipRange(mipLevels - 1, 1),
+                  vk::PipelineStageFlagBits2::eCopy |
+                      vk::PipelineStageFlagBits2::eBlit,
+                  vk::AccessFlagBits2::eTransferWrite,
+                  vk::PipelineStageFlagBits2::eFragmentShader,
+                  vk::AccessFlagBits2::eShaderSampledRead,
+                  vk::ImageLayout::eTransferDstOptimal,
+                  vk::ImageLayout::eShaderReadOnlyOptimal)
+        .record(cmdBuffer);
 
     device->flushCommandBuffer(cmdBuffer);
+    stagingBuffer.destroy();
 }
 
 void Texture::allocate(vk::Extent2D extent, uint32_t mipLevels,
@@ -186,7 +192,7 @@ void Texture::allocate(vk::Extent2D extent, uint32_t mipLevels,
         .format = format,
         .extent = {extent.width, extent.height, 1},
         .mipLevels = mipLevels,
-        .arrayLayers = 1,
+        .arrayLayers = arrayLayers,
         .samples = sampleCount,
         .tiling = vk::ImageTiling::eOptimal,
         .usage = usage,
@@ -207,7 +213,8 @@ void Texture::allocate(vk::Extent2D extent, uint32_t mipLevels,
 
     auto imageViewCI = vk::ImageViewCreateInfo{
         .image = image,
-        .viewType = vk::ImageViewType::e2D,
+        .viewType = arrayLayers > 1 ? vk::ImageViewType::e2DArray
+                                    : vk::ImageViewType::e2D,
         .format = format,
         .subresourceRange =
             {
@@ -215,7 +222,7 @@ void Texture::allocate(vk::Extent2D extent, uint32_t mipLevels,
                 .baseMipLevel = 0,
                 .levelCount = mipLevels,
                 .baseArrayLayer = 0,
-                .layerCount = 1,
+                .layerCount = arrayLayers,
             },
     };
 
@@ -233,10 +240,14 @@ void Texture::createSampler() {
         .addressModeV = addressMode,
         .addressModeW = addressMode,
         .mipLodBias = 0.0f,
-        .anisotropyEnable = vk::True,
-        .maxAnisotropy = properties.limits.maxSamplerAnisotropy,
-        .compareEnable = vk::False,
-        .compareOp = vk::CompareOp::eAlways,
+        // Shadow lookups sample level zero, anisotropy only adds cost
+        .anisotropyEnable = !compareEnable,
+        .maxAnisotropy =
+            compareEnable ? 1.0f : properties.limits.maxSamplerAnisotropy,
+        .compareEnable = compareEnable,
+        // Passes where the reference is no further than the stored depth
+        .compareOp = compareEnable ? vk::CompareOp::eLessOrEqual
+                                   : vk::CompareOp::eAlways,
         .minLod = std::clamp(minLod, 0.0f, (float)mipLevels),
         .maxLod = VK_LOD_CLAMP_NONE,
         .borderColor = vk::BorderColor::eFloatOpaqueWhite,
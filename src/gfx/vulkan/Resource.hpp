@@ -34,6 +34,12 @@ struct Texture {
 
     uint32_t mipLevels = 1;
     float minLod = 0.0f;
+    // Set before allocate(), more than one layer gets a 2D array view
+    uint32_t arrayLayers = 1;
+    // Set before createSampler(), for depth textures read with SampleCmp.
+    // Each fetch then returns the filtered result of comparing the four
+    // texels around it against the reference.
+    bool compareEnable = false;
 
     void loadFromFile(const char* filename);
     void allocate(vk::Extent2D extent, uint32_t mipLevels, vk::Format format,
@@ -0,0 +1,422 @@
+#include "gfx/vulkan/ShaderReflection.hpp"
+
+#include <algorithm>
+#include <string>
+#include <tuple>
+
+namespace Engine {
+namespace {
+constexpr uint32_t SPIRV_MAGIC = 0x07230203;
+constexpr uint32_t SPIRV_HEADER_WORDS = 5;
+constexpr uint32_t UNSET = ~0u;
+
+// The few opcodes, decorations, storage classes and execution models of
+// the SPIR-V spec the layouts depend on
+enum Op : uint32_t {
+    OpEntryPoint = 15,
+    OpTypeInt = 21,
+    OpTypeFloat = 22,
+    OpTypeVector = 23,
+    OpTypeMatrix = 24,
+    OpTypeImage = 25,
+    OpTypeSampler = 26,
+    OpTypeSampledImage = 27,
+    OpTypeArray = 28,
+    OpTypeRuntimeArray = 29,
+    OpTypeStruct = 30,
+    OpTypePointer = 32,
+    OpConstant = 43,
+    OpVariable = 59,
+    OpDecorate = 71,
+    OpMemberDecorate = 72,
+};
+
+enum Decoration : uint32_t {
+    DecorationBlock = 2,
+    DecorationArrayStride = 6,
+    DecorationMatrixStride = 7,
+    DecorationBuiltIn = 11,
+    DecorationLocation = 30,
+    DecorationBinding = 33,
+    DecorationDescriptorSet = 34,
+    DecorationOffset = 35,
+};
+
+enum StorageClass : uint32_t {
+    StorageInput = 1,
+    StorageUniform = 2,
+    StoragePushConstant = 9,
+};
+
+constexpr uint32_t DIM_BUFFER = 5;
+constexpr uint32_t DIM_SUBPASS_DATA = 6;
+constexpr uint32_t IMAGE_STORAGE = 2;
+
+struct Member {
+    uint32_t offset = 0;
+    uint32_t matrixStride = 0;
+};
+
+// Everything known about one result id. operands are the words after the
+// opcode, the result id included.
+struct Id {
+    uint32_t opcode = 0;
+    std::vector<uint32_t> operands;
+
+    uint32_t set = UNSET;
+    uint32_t binding = UNSET;
+    uint32_t location = UNSET;
+    uint32_t arrayStride = 0;
+    bool builtIn = false;
+    bool block = false;
+    std::vector<Member> members;
+};
+
+class Parser {
+   public:
+    explicit Parser(std::span<const uint32_t> code) {
+        if (code.size() < SPIRV_HEADER_WORDS || code[0] != SPIRV_MAGIC) {
+            throw std::runtime_error("shader code is not SPIR-V");
+        }
+        ids.resize(code[3]);
+
+        for (size_t i = SPIRV_HEADER_WORDS; i < code.size();) {
+            uint32_t wordCount = code[i] >> 16;
+            uint32_t opcode = code[i] & 0xffff;
+            if (wordCount == 0 || i + wordCount > code.size()) {
+                throw std::runtime_error("truncated SPIR-V instruction");
+            }
+            parse(opcode, code.subspan(i + 1, wordCount - 1));
+            i += wordCount;
+        }
+    }
+
+    ShaderReflection reflect() const {
+        ShaderReflection reflection{.stage = stage};
+        for (const auto& variable : variables) {
+            const auto& pointer = ids[variable.operands[0]];
+            uint32_t storage = variable.operands[2];
+            uint32_t type = pointer.operands[2];
+
+            if (storage == StoragePushConstant) {
+                reflection.pushConstantSize = getSize(type);
+            } else if (storage == StorageInput &&
+                       stage == vk::ShaderStageFlagBits::eVertex &&
+                       !variable.builtIn && variable.location != UNSET) {
+                reflection.vertexInputs.push_back(
+                    {variable.location, getFormat(type)});
+            } else if (variable.binding != UNSET) {
+                addBinding(reflection, variable, storage, type);
+            }
+        }
+
+        mergeBindings(reflection.bindings);
+        std::sort(reflection.vertexInputs.begin(),
+                  reflection.vertexInputs.end(),
+                  [](const auto& a, const auto& b) {
+                      return a.location < b.location;
+                  });
+        return reflection;
+    }
+
+   private:
+    std::vector<Id> ids;
+    std::vector<Id> variables;
+    vk::ShaderStageFlagBits stage = vk::ShaderStageFlagBits::eAll;
+
+    Id& at(uint32_t id) {
+        if (id >= ids.size()) {
+            throw std::runtime_error("SPIR-V id out of bounds");
+        }
+        return ids[id];
+    }
+
+    void parse(uint32_t opcode, std::span<const uint32_t> operands) {
+        switch (opcode) {
+            case OpEntryPoint:
+                // Modules built by hlsl_compile.sh hold one entry point
+                if (stage == vk::ShaderStageFlagBits::eAll) {
+                    stage = getStage(operands[0]);
+                }
+                break;
+            case OpDecorate:
+                decorate(at(operands[0]), operands[1], operands);
+                break;
+            case OpMemberDecorate: {
+                auto& members = at(operands[0]).members;
+                if (members.size() <= operands[1]) {
+                    members.resize(operands[1] + 1);
+                }
+                if (operands[2] == DecorationOffset) {
+                    members[operands[1]].offset = operands[3];
+                } else if (operands[2] == DecorationMatrixStride) {
+                    members[operands[1]].matrixStride = operands[3];
+                }
+                break;
+            }
+            case OpTypeInt:
+            case OpTypeFloat:
+            case OpTypeVector:
+            case OpTypeMatrix:
+            case OpTypeImage:
+            case OpTypeSampler:
+            case OpTypeSampledImage:
+            case OpTypeArray:
+            case OpTypeRuntimeArray:
+            case OpTypeStruct:
+            case OpTypePointer:
+                define(operands[0], opcode, operands);
+                break;
+            case OpConstant:
+                define(operands[1], opcode, operands);
+                break;
+            case OpVariable:
+                // Decorations come before the variable, copy them along
+                define(operands[1], opcode, operands);
+                variables.push_back(at(operands[1]));
+                break;
+        }
+    }
+
+    void define(uint32_t id, uint32_t opcode,
+                std::span<const uint32_t> operands) {
+        auto& entry = at(id);
+        entry.opcode = opcode;
+        entry.operands.assign(operands.begin(), operands.end());
+    }
+
+    static void decorate(Id& id, uint32_t decoration,
+                         std::span<const uint32_t> operands) {
+        switch (decoration) {
+            case DecorationBlock:
+                id.block = true;
+                break;
+            case DecorationArrayStride:
+                id.arrayStride = operands[2];
+                break;
+            case DecorationBuiltIn:
+                id.builtIn = true;
+                break;
+            case DecorationLocation:
+                id.location = operands[2];
+                break;
+            case DecorationBinding:
+                id.binding = operands[2];
+                break;
+            case DecorationDescriptorSet:
+                id.set = operands[2];
+                break;
+        }
+    }
+
+    static vk::ShaderStageFlagBits getStage(uint32_t executionModel) {
+        switch (executionModel) {
+            case 0:
+                return vk::ShaderStageFlagBits::eVertex;
+            case 1:
+                return vk::ShaderStageFlagBits::eTessellationControl;
+            case 2:
+                return vk::ShaderStageFlagBits::eTessellationEvaluation;
+            case 3:
+                return vk::ShaderStageFlagBits::eGeometry;
+            case 4:
+                return vk::ShaderStageFlagBits::eFragment;
+            case 5:
+                return vk::ShaderStageFlagBits::eCompute;
+        }
+        throw std::runtime_error("unsupported SPIR-V execution model");
+    }
+
+    uint32_t getArrayLength(const Id& array) const {
+        return ids[array.operands[2]].operands[2];
+    }
+
+    // Bytes a value of the type covers, with the offsets and strides dxc
+    // decorated it with
+    uint32_t getSize(uint32_t type) const {
+        const auto& id = ids[type];
+        switch (id.opcode) {
+            case OpTypeInt:
+            case OpTypeFloat:
+                return id.operands[1] / 8;
+            case OpTypeVector:
+            case OpTypeMatrix:
+                return getSize(id.operands[1]) * id.operands[2];
+            case OpTypeArray: {
+                uint32_t stride = id.arrayStride ? id.arrayStride
+                                                 : getSize(id.operands[1]);
+                return stride * getArrayLength(id);
+            }
+            case OpTypeStruct: {
+                uint32_t size = 0;
+                for (size_t i = 0; i < id.members.size(); i++) {
+                    uint32_t memberType = id.operands[i + 1];
+                    const auto& member = id.members[i];
+                    uint32_t memberSize = getSize(memberType);
+                    if (member.matrixStride != 0) {
+                        memberSize = member.matrixStride *
+                                     ids[memberType].operands[2];
+                    }
+                    size = std::max(size, member.offset + memberSize);
+                }
+                return size;
+            }
+        }
+        return 0;
+    }
+
+    vk::Format getFormat(uint32_t type) const {
+        const auto* id = &ids[type];
+        uint32_t componentCount = 1;
+        if (id->opcode == OpTypeVector) {
+            componentCount = id->operands[2];
+            id = &ids[id->operands[1]];
+        }
+        if (id->operands[1] != 32 || componentCount > 4) {
+            return vk::Format::eUndefined;
+        }
+
+        static constexpr vk::Format floatFormats[] = {
+            vk::Format::eR32Sfloat, vk::Format::eR32G32Sfloat,
+            vk::Format::eR32G32B32Sfloat, vk::Format::eR32G32B32A32Sfloat};
+        static constexpr vk::Format intFormats[] = {
+            vk::Format::eR32Sint, vk::Format::eR32G32Sint,
+            vk::Format::eR32G32B32Sint, vk::Format::eR32G32B32A32Sint};
+        static constexpr vk::Format uintFormats[] = {
+            vk::Format::eR32Uint, vk::Format::eR32G32Uint,
+            vk::Format::eR32G32B32Uint, vk::Format::eR32G32B32A32Uint};
+        if (id->opcode == OpTypeFloat) {
+            return floatFormats[componentCount - 1];
+        }
+        bool isSigned = id->operands[2] != 0;
+        return isSigned ? intFormats[componentCount - 1]
+                        : uintFormats[componentCount - 1];
+    }
+
+    void addBinding(ShaderReflection& reflection, const Id& variable,
+                    uint32_t storage, uint32_t type) const {
+        uint32_t count = 1;
+        const auto* id = &ids[type];
+        if (id->opcode == OpTypeArray) {
+            count = getArrayLength(*id);
+            id = &ids[id->operands[1]];
+        } else if (id->opcode == OpTypeRuntimeArray) {
+            id = &ids[id->operands[1]];
+        }
+
+        vk::DescriptorType descriptorType;
+        switch (id->opcode) {
+            case OpTypeStruct:
+                // Structured buffers are BufferBlocks or in StorageBuffer
+                descriptorType = storage == StorageUniform && id->block
+                                     ? vk::DescriptorType::eUniformBuffer
+                                     : vk::DescriptorType::eStorageBuffer;
+                break;
+            case OpTypeImage: {
+                uint32_t dim = id->operands[2];
+                bool storageImage = id->operands[6] == IMAGE_STORAGE;
+                if (dim == DIM_BUFFER) {
+                    descriptorType =
+                        storageImage ? vk::DescriptorType::eStorageTexelBuffer
+                                     : vk::DescriptorType::eUniformTexelBuffer;
+                } else if (dim == DIM_SUBPASS_DATA) {
+                    descriptorType = vk::DescriptorType::eInputAttachment;
+                } else {
+                    descriptorType = storageImage
+                                         ? vk::DescriptorType::eStorageImage
+                                         : vk::DescriptorType::eSampledImage;
+                }
+                break;
+            }
+            case OpTypeSampler:
+                descriptorType = vk::DescriptorType::eSampler;
+                break;
+            case OpTypeSampledImage:
+                descriptorType = vk::DescriptorType::eCombinedImageSampler;
+                break;
+            default:
+                // Acceleration structures and the like, not used here
+                return;
+        }
+
+        reflection.bindings.push_back({
+            .set = variable.set == UNSET ? 0 : variable.set,
+            .binding = variable.binding,
+            .type = descriptorType,
+            .count = count,
+        });
+    }
+
+    // HLSL has no combined image samplers, a Texture and a SamplerState
+    // bound to the same slot make one
+    static void mergeBindings(
+        std::vector<ShaderReflection::Binding>& bindings) {
+        std::sort(bindings.begin(), bindings.end(),
+                  [](const auto& a, const auto& b) {
+                      return std::tie(a.set, a.binding) <
+                             std::tie(b.set, b.binding);
+                  });
+
+        std::vector<ShaderReflection::Binding> merged;
+        for (const auto& binding : bindings) {
+            if (merged.empty() || merged.back().set != binding.set ||
+                merged.back().binding != binding.binding) {
+                merged.push_back(binding);
+                continue;
+            }
+
+            auto& previous = merged.back();
+            auto isImageAndSampler = [](vk::DescriptorType a,
+                                        vk::DescriptorType b) {
+                return a == vk::DescriptorType::eSampledImage &&
+                       b == vk::DescriptorType::eSampler;
+            };
+            if (isImageAndSampler(previous.type, binding.type) ||
+                isImageAndSampler(binding.type, previous.type)) {
+                previous.type = vk::DescriptorType::eCombinedImageSampler;
+            } else if (previous.type != binding.type) {
+                throw std::runtime_error(
+                    "two resources of different types share set " +
+                    std::to_string(binding.set) + " binding " +
+                    std::to_string(binding.binding));
+            }
+        }
+        bindings = std::move(merged);
+    }
+};
+}  // namespace
+
+std::vector<vk::VertexInputAttributeDescription>
+ShaderReflection::selectVertexAttributes(
+    std::span<const vk::VertexInputAttributeDescription> attributes) const {
+    std::vector<vk::VertexInputAttributeDescription> selected;
+    for (const auto& input : vertexInputs) {
+        auto attribute = std::find_if(
+            attributes.begin(), attributes.end(), [&](const auto& attribute) {
+                return attribute.location == input.location;
+            });
+        if (attribute == attributes.end()) {
+            throw std::runtime_error("no vertex attribute for location " +
+                                     std::to_string(input.location));
+        }
+        selected.push_back(*attribute);
+    }
+    return selected;
+}
+
+void ShaderReflection::makeDynamic(uint32_t set, uint32_t binding) {
+    for (auto& entry : bindings) {
+        if (entry.set != set || entry.binding != binding) {
+            continue;
+        }
+        if (entry.type != vk::DescriptorType::eUniformBuffer) {
+            throw std::runtime_error("only uniform buffers can be dynamic");
+        }
+        entry.type = vk::DescriptorType::eUniformBufferDynamic;
+    }
+}
+
+ShaderReflection reflectShader(std::span<const uint32_t> code) {
+    return Parser(code).reflect();
+}
+}  // namespace Engine
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "gfx/vulkan/VulkanUsage.hpp"
+
+#include <span>
+#include <vector>
+
+namespace Engine {
+// Interface of one shader stage, read straight from its SPIR-V
+struct ShaderReflection {
+    struct Binding {
+        uint32_t set;
+        uint32_t binding;
+        vk::DescriptorType type;
+        uint32_t count;
+    };
+
+    // A location the vertex stage reads, in the format the shader sees
+    struct VertexInput {
+        uint32_t location;
+        vk::Format format;
+    };
+
+    vk::ShaderStageFlagBits stage;
+    // Only the resources the stage references, dxc drops the others. A
+    // texture and a sampler sharing a binding show up as one combined
+    // image sampler.
+    std::vector<Binding> bindings;
+    // Bytes of the push constant block, 0 without one
+    uint32_t pushConstantSize = 0;
+    std::vector<VertexInput> vertexInputs;
+
+    // The attributes of the locations the vertex stage reads, throws when
+    // one of them is missing. The formats stay the buffer's, e.g. packed
+    // normals the shader reads as float3.
+    std::vector<vk::VertexInputAttributeDescription> selectVertexAttributes(
+        std::span<const vk::VertexInputAttributeDescription> attributes) const;
+
+    // SPIR-V has no dynamic uniform buffers, the binding is bound with a
+    // dynamic offset (see UniformRing). Ignored when the stage lacks it.
+    void makeDynamic(uint32_t set, uint32_t binding);
+};
+
+// Walks the instructions once, only the decorations, types and variables
+// the layouts need are looked at. Throws on anything that is not SPIR-V.
+ShaderReflection reflectShader(std::span<const uint32_t> code);
+}  // namespace Engine
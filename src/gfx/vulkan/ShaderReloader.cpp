@@ -0,0 +1,260 @@
+#include "gfx/vulkan/ShaderReloader.hpp"
+#include "gfx/vulkan/Device.hpp"
+#include "gfx/vulkan/Utils.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <regex>
+#include <sstream>
+
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#endif
+
+namespace Engine {
+namespace {
+constexpr auto POLL_INTERVAL = std::chrono::milliseconds(500);
+
+struct EntryPoint {
+    const char* name;
+    const char* profile;
+};
+
+constexpr EntryPoint ENTRY_POINTS[] = {
+    {"vert", "vs_6_0"},
+    {"frag", "ps_6_0"},
+    {"comp", "cs_6_0"},
+};
+
+std::string readSource(const std::filesystem::path& path) {
+    std::ifstream in(path, std::ios::binary);
+    std::stringstream text;
+    text << in.rdbuf();
+    return text.str();
+}
+
+bool hasEntryPoint(const std::string& source, const char* name) {
+    return std::regex_search(source,
+                             std::regex(std::string("\\b") + name + "\\s*\\("));
+}
+
+// Runs the command and returns what it printed, stderr included
+int runCommand(const std::string& command, std::string& output) {
+#ifdef _WIN32
+    // cmd strips the outer quotes
+    auto line = "\"" + command + " 2>&1\"";
+#else
+    auto line = command + " 2>&1";
+#endif
+    FILE* pipe = popen(line.c_str(), "r");
+    if (!pipe) {
+        output = "failed to start " + command;
+        return -1;
+    }
+    char buffer[256];
+    while (fgets(buffer, sizeof(buffer), pipe)) {
+        output += buffer;
+    }
+    return pclose(pipe);
+}
+}  // namespace
+
+void ShaderReloader::init(Device* device) {
+    this->device = device;
+
+    if (!std::filesystem::exists(DXC_PATH)) {
+        LOG_WARN("Shader hot reload disabled, {} not found", DXC_PATH);
+        return;
+    }
+    // The current sources are what the SPIR-V on disk was compiled from
+    scanSources(false);
+    thread = std::thread(&ShaderReloader::run, this);
+}
+
+void ShaderReloader::destroy() {
+    if (thread.joinable()) {
+        {
+            std::lock_guard lock(mutex);
+            stopping = true;
+        }
+        stopSignal.notify_one();
+        thread.join();
+    }
+
+    for (auto& pipeline : retired) {
+        device->getLogicalDevice().destroyPipeline(pipeline.pipeline);
+    }
+    retired.clear();
+    watches.clear();
+}
+
+void ShaderReloader::watch(std::vector<std::string> shaders,
+                           RebuildFunc rebuild) {
+    watches.push_back({std::move(shaders), std::move(rebuild)});
+}
+
+void ShaderReloader::retire(vk::Pipeline pipeline) {
+    retired.push_back({pipeline, MAX_FRAMES_IN_FLIGHT});
+}
+
+void ShaderReloader::update() {
+    std::vector<std::string> changed;
+    {
+        std::lock_guard lock(mutex);
+        changed.swap(compiled);
+    }
+    if (changed.empty()) {
+        return;
+    }
+
+    for (auto& watch : watches) {
+        bool affected = std::any_of(
+            watch.shaders.begin(), watch.shaders.end(),
+            [&](const std::string& shader) {
+                return std::find(changed.begin(), changed.end(), shader) !=
+                       changed.end();
+            });
+        if (!affected) {
+            continue;
+        }
+
+        try {
+            watch.rebuild();
+            LOG("Rebuilt pipelines of {}", watch.shaders.front());
+        } catch (const std::exception& error) {
+            LOG_ERROR("Pipeline rebuild failed, keeping the old one: {}",
+                      error.what());
+        }
+    }
+}
+
+void ShaderReloader::releaseRetired() {
+    auto logicalDevice = device->getLogicalDevice();
+    std::erase_if(retired, [&](RetiredPipeline& pipeline) {
+        if (--pipeline.framesLeft > 0) {
+            return false;
+        }
+        logicalDevice.destroyPipeline(pipeline.pipeline);
+        return true;
+    });
+}
+
+void ShaderReloader::run() {
+    std::unique_lock lock(mutex);
+    while (!stopSignal.wait_for(lock, POLL_INTERVAL,
+                                [this] { return stopping; })) {
+        lock.unlock();
+        try {
+            scanSources(true);
+        } catch (const std::exception& error) {
+            LOG_WARN("Shader scan failed: {}", error.what());
+        }
+        lock.lock();
+    }
+}
+
+void ShaderReloader::scanSources(bool compileChanged) {
+    std::vector<std::filesystem::path> changed;
+    std::error_code error;
+    for (const auto& entry : std::filesystem::recursive_directory_iterator(
+             SHADER_SOURCE_DIR, error)) {
+        if (entry.path().extension() != ".hlsl") {
+            continue;
+        }
+        auto writeTime = entry.last_write_time(error);
+        if (error) {
+            continue;
+        }
+        auto& knownTime = writeTimes[entry.path()];
+        if (knownTime != writeTime) {
+            knownTime = writeTime;
+            changed.push_back(entry.path());
+        }
+    }
+    if (!compileChanged || changed.empty()) {
+        return;
+    }
+
+    // Includes are matched by file name, the shaders include siblings.
+    // Every source added is expanded in turn, so files including a header
+    // through another header are recompiled too.
+    std::vector<std::filesystem::path> sources = changed;
+    for (size_t i = 0; i < sources.size(); i++) {
+        auto include = "#include \"" + sources[i].filename().string() + "\"";
+        for (const auto& [source, writeTime] : writeTimes) {
+            if (std::find(sources.begin(), sources.end(), source) ==
+                    sources.end() &&
+                readSource(source).find(include) != std::string::npos) {
+                sources.push_back(source);
+            }
+        }
+    }
+
+    std::vector<std::string> written;
+    for (const auto& source : sources) {
+        auto shaders = compile(source);
+        written.insert(written.end(), shaders.begin(), shaders.end());
+    }
+    if (!written.empty()) {
+        std::lock_guard lock(mutex);
+        compiled.insert(compiled.end(), written.begin(), written.end());
+    }
+}
+
+std::vector<std::string> ShaderReloader::compile(
+    const std::filesystem::path& source) {
+    auto text = readSource(source);
+    auto relative = std::filesystem::relative(source, SHADER_SOURCE_DIR)
+                        .replace_extension();
+
+    // Every stage is compiled next to its output first and only renamed
+    // over it once all of them compiled, a rebuild then never pairs a new
+    // stage with a stale one or reads a half written module
+    std::vector<std::string> names;
+    bool failed = false;
+    std::error_code error;
+    for (const auto& entryPoint : ENTRY_POINTS) {
+        if (!hasEntryPoint(text, entryPoint.name)) {
+            continue;
+        }
+
+        auto name =
+            relative.generic_string() + "." + entryPoint.name + ".spv";
+        std::filesystem::path output = SHADER_DIR + name;
+        std::filesystem::create_directories(output.parent_path(), error);
+        names.push_back(name);
+
+        auto command = std::string("\"") + DXC_PATH + "\" -spirv -T " +
+                       entryPoint.profile + " -E " + entryPoint.name + " \"" +
+                       source.string() + "\" -Fo \"" + output.string() +
+                       ".tmp\"";
+        std::string log;
+        if (runCommand(command, log) != 0) {
+            LOG_ERROR("Failed to compile {} ({}):\n{}", source.string(),
+                      entryPoint.name, log);
+            failed = true;
+            break;
+        }
+    }
+
+    std::vector<std::string> written;
+    for (const auto& name : names) {
+        auto output = SHADER_DIR + name;
+        if (failed) {
+            std::filesystem::remove(output + ".tmp", error);
+            continue;
+        }
+        std::filesystem::rename(output + ".tmp", output, error);
+        if (error) {
+            LOG_WARN("Failed to write {}: {}", output, error.message());
+            continue;
+        }
+        LOG("Recompiled {}", name);
+        written.push_back(name);
+    }
+    return written;
+}
+}  // namespace Engine
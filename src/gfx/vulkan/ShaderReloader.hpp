@@ -0,0 +1,74 @@
+#pragma once
+
+#include "gfx/vulkan/VulkanUsage.hpp"
+
+#include <condition_variable>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Engine {
+class Device;
+
+// Watches the HLSL sources under SHADER_SOURCE_DIR and recompiles the ones
+// that change on a background thread, with the bundled dxc and the same
+// entry point rules as scripts/hlsl_compile.sh. Sources including a changed
+// file are recompiled with it. update() then calls, between frames, the
+// rebuild of every pipeline whose shaders were replaced. A source that
+// fails to compile logs dxc's output and leaves the pipelines as they are.
+class ShaderReloader {
+   public:
+    using RebuildFunc = std::function<void()>;
+
+    void init(Device* device);
+    void destroy();
+
+    // shaders are named like for createShaderModule(), e.g.
+    // "test/shadow.vert.spv". rebuild creates the new pipelines before it
+    // hands the old ones to retire(), a throw leaves the old ones in use.
+    void watch(std::vector<std::string> shaders, RebuildFunc rebuild);
+
+    // Destroyed by releaseRetired() once no frame in flight can use it
+    void retire(vk::Pipeline pipeline);
+
+    // Between frames, runs the rebuilds of what the thread compiled since
+    // the last call
+    void update();
+    // After the wait on the frame's fence
+    void releaseRetired();
+
+   private:
+    struct Watch {
+        std::vector<std::string> shaders;
+        RebuildFunc rebuild;
+    };
+
+    struct RetiredPipeline {
+        vk::Pipeline pipeline;
+        uint32_t framesLeft;
+    };
+
+    Device* device;
+    std::vector<Watch> watches;
+    std::vector<RetiredPipeline> retired;
+
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable stopSignal;
+    bool stopping = false;
+    // Written SPIR-V, relative to SHADER_DIR, guarded by mutex
+    std::vector<std::string> compiled;
+
+    // Only touched by the thread
+    std::map<std::filesystem::path, std::filesystem::file_time_type>
+        writeTimes;
+
+    void run();
+    void scanSources(bool compileChanged);
+    std::vector<std::string> compile(const std::filesystem::path& source);
+};
+}  // namespace Engine
@@ -0,0 +1,250 @@
+#include "gfx/vulkan/TransientAttachmentPool.hpp"
+#include "gfx/vulkan/Device.hpp"
+#include "gfx/vulkan/Utils.hpp"
+
+#include <algorithm>
+
+namespace Engine {
+namespace {
+constexpr vk::ImageUsageFlags ATTACHMENT_USAGE =
+    vk::ImageUsageFlagBits::eColorAttachment |
+    vk::ImageUsageFlagBits::eDepthStencilAttachment |
+    vk::ImageUsageFlagBits::eInputAttachment;
+
+bool isAttachmentOnly(const TransientImageDesc& desc) {
+    return !(desc.usage & ~ATTACHMENT_USAGE);
+}
+
+vk::ImageCreateInfo getImageCI(const TransientImageDesc& desc) {
+    auto usage = desc.usage;
+    if (isAttachmentOnly(desc)) {
+        usage |= vk::ImageUsageFlagBits::eTransientAttachment;
+    }
+    return vk::ImageCreateInfo{
+        .imageType = vk::ImageType::e2D,
+        .format = desc.format,
+        .extent = {desc.extent.width, desc.extent.height, 1},
+        .mipLevels = desc.mipLevels,
+        .arrayLayers = 1,
+        .samples = desc.sampleCount,
+        .tiling = vk::ImageTiling::eOptimal,
+        .usage = usage,
+        .sharingMode = vk::SharingMode::eExclusive,
+        .initialLayout = vk::ImageLayout::eUndefined,
+    };
+}
+
+uint64_t alignUp(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+}  // namespace
+
+void TransientAttachmentPool::init(Device* device) {
+    this->device = device;
+
+    auto memoryProperties = device->getPhysicalDevice().getMemoryProperties();
+    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+        if (memoryProperties.memoryTypes[i].propertyFlags &
+            vk::MemoryPropertyFlagBits::eLazilyAllocated) {
+            lazyMemory = true;
+        }
+    }
+}
+
+void TransientAttachmentPool::destroy() {
+    for (auto& placement : placements) {
+        destroyPlacement(placement);
+    }
+    placements.clear();
+}
+
+void TransientAttachmentPool::place(
+    const std::vector<TransientImageRequest>& requests, uint64_t frame) {
+    auto it = std::find_if(placements.begin(), placements.end(),
+                           [&](const Placement& placement) {
+                               return placement.requests == requests;
+                           });
+    if (it == placements.end()) {
+        placements.push_back(createPlacement(requests));
+        it = std::prev(placements.end());
+    }
+    it->lastFrame = frame;
+    current = static_cast<uint32_t>(it - placements.begin());
+}
+
+std::vector<vk::Image> TransientAttachmentPool::releaseUnused(
+    uint64_t frame) {
+    std::vector<vk::Image> released;
+    std::erase_if(placements, [&](Placement& placement) {
+        if (frame - placement.lastFrame <= MAX_FRAMES_IN_FLIGHT) {
+            return false;
+        }
+        for (const auto& texture : placement.textures) {
+            released.push_back(texture.image);
+        }
+        destroyPlacement(placement);
+        return true;
+    });
+    current = 0;
+    return released;
+}
+
+bool TransientAttachmentPool::isLazy(const TransientImageDesc& desc) const {
+    return lazyMemory && isAttachmentOnly(desc);
+}
+
+TransientAttachmentPool::Placement TransientAttachmentPool::createPlacement(
+    const std::vector<TransientImageRequest>& requests) {
+    auto logicalDevice = device->getLogicalDevice();
+    auto allocator = device->getAllocator();
+
+    Placement placement{.requests = requests};
+    placement.textures.resize(requests.size(), device->createTexture());
+    placement.aliases.resize(requests.size());
+
+    std::vector<vk::MemoryRequirements> memoryRequirements(requests.size());
+    std::vector<uint32_t> aliased;
+    for (uint32_t i = 0; i < requests.size(); i++) {
+        const auto& desc = requests[i].desc;
+        auto& texture = placement.textures[i];
+        texture.sampleCount = desc.sampleCount;
+        texture.mipLevels = desc.mipLevels;
+
+        VkImageCreateInfo imageCI = getImageCI(desc);
+        if (isLazy(desc)) {
+            VmaAllocationCreateInfo allocCI{
+                .usage = VMA_MEMORY_USAGE_GPU_LAZILY_ALLOCATED,
+            };
+            vkCheckResult(vmaCreateImage(allocator, &imageCI, &allocCI,
+                                         &texture.image, &texture.allocation,
+                                         &texture.allocationInfo));
+            continue;
+        }
+
+        texture.image = logicalDevice.createImage(imageCI);
+        texture.allocation = VK_NULL_HANDLE;
+        memoryRequirements[i] =
+            logicalDevice.getImageMemoryRequirements(texture.image);
+        aliased.push_back(i);
+    }
+
+    // Largest first, each image goes to the lowest offset that does not
+    // collide with an image placed earlier whose passes overlap its own.
+    // Every image is optimal tiling, so bufferImageGranularity never applies.
+    std::sort(aliased.begin(), aliased.end(), [&](uint32_t a, uint32_t b) {
+        return memoryRequirements[a].size > memoryRequirements[b].size;
+    });
+    std::vector<uint64_t> offsets(requests.size());
+    vk::MemoryRequirements blockRequirements{.alignment = 1,
+                                             .memoryTypeBits = ~0u};
+    uint64_t requestedSize = 0;
+    for (size_t placed = 0; placed < aliased.size(); placed++) {
+        uint32_t i = aliased[placed];
+        const auto& requirements = memoryRequirements[i];
+        uint64_t offset = 0;
+        bool moved = true;
+        while (moved) {
+            moved = false;
+            for (size_t k = 0; k < placed; k++) {
+                uint32_t j = aliased[k];
+                bool livesApart =
+                    requests[i].lastPass < requests[j].firstPass ||
+                    requests[j].lastPass < requests[i].firstPass;
+                uint64_t end = offsets[j] + memoryRequirements[j].size;
+                if (livesApart || offset >= end ||
+                    offsets[j] >= offset + requirements.size) {
+                    continue;
+                }
+                offset = alignUp(end, requirements.alignment);
+                moved = true;
+            }
+        }
+        offsets[i] = offset;
+
+        blockRequirements.size =
+            std::max(blockRequirements.size, offset + requirements.size);
+        blockRequirements.alignment =
+            std::max(blockRequirements.alignment, requirements.alignment);
+        blockRequirements.memoryTypeBits &= requirements.memoryTypeBits;
+        requestedSize += requirements.size;
+    }
+
+    if (!aliased.empty()) {
+        if (!blockRequirements.memoryTypeBits) {
+            throw std::runtime_error(
+                "transient images have no memory type in common");
+        }
+
+        VkMemoryRequirements vkRequirements = blockRequirements;
+        VmaAllocationCreateInfo allocCI{
+            .requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        };
+        vkCheckResult(vmaAllocateMemory(allocator, &vkRequirements, &allocCI,
+                                        &placement.memory, nullptr));
+        for (auto i : aliased) {
+            vkCheckResult(vmaBindImageMemory2(allocator, placement.memory,
+                                              offsets[i],
+                                              placement.textures[i].image,
+                                              nullptr));
+        }
+
+        LOG("Transient images: {:.1f} MB aliased into {:.1f} MB",
+            requestedSize / (1024.0 * 1024.0),
+            blockRequirements.size / (1024.0 * 1024.0));
+    }
+
+    for (uint32_t i = 0; i < requests.size(); i++) {
+        const auto& desc = requests[i].desc;
+        auto& texture = placement.textures[i];
+        texture.imageView = logicalDevice.createImageView({
+            .image = texture.image,
+            .viewType = vk::ImageViewType::e2D,
+            .format = desc.format,
+            .subresourceRange =
+                {
+                    .aspectMask = desc.aspect,
+                    .baseMipLevel = 0,
+                    .levelCount = desc.mipLevels,
+                    .baseArrayLayer = 0,
+                    .layerCount = 1,
+                },
+        });
+        if (desc.usage & vk::ImageUsageFlagBits::eSampled) {
+            texture.createSampler();
+        }
+
+        // Any overlap in memory, the packing kept it to images that live
+        // apart
+        if (texture.allocation != VK_NULL_HANDLE) {
+            continue;
+        }
+        for (auto j : aliased) {
+            uint64_t end = offsets[j] + memoryRequirements[j].size;
+            if (j != i && offsets[i] < end &&
+                offsets[j] < offsets[i] + memoryRequirements[i].size) {
+                placement.aliases[i].push_back(placement.textures[j].image);
+            }
+        }
+    }
+
+    return placement;
+}
+
+void TransientAttachmentPool::destroyPlacement(Placement& placement) {
+    auto logicalDevice = device->getLogicalDevice();
+    for (auto& texture : placement.textures) {
+        if (texture.allocation != VK_NULL_HANDLE) {
+            texture.destroy();
+            continue;
+        }
+        if (texture.sampler) {
+            logicalDevice.destroySampler(texture.sampler);
+        }
+        logicalDevice.destroyImageView(texture.imageView);
+        logicalDevice.destroyImage(texture.image);
+    }
+    if (placement.memory != VK_NULL_HANDLE) {
+        vmaFreeMemory(device->getAllocator(), placement.memory);
+    }
+}
+}  // namespace Engine
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "gfx/vulkan/VulkanUsage.hpp"
+#include "gfx/vulkan/Resource.hpp"
+
+#include <vector>
+
+namespace Engine {
+class Device;
+
+// Images whose contents do not outlive the frame
+struct TransientImageDesc {
+    vk::Extent2D extent;
+    vk::Format format;
+    vk::ImageUsageFlags usage;
+    vk::ImageAspectFlags aspect;
+    uint32_t mipLevels = 1;
+    vk::SampleCountFlagBits sampleCount = vk::SampleCountFlagBits::e1;
+
+    bool operator==(const TransientImageDesc&) const = default;
+};
+
+// A transient and the first and last pass that touch it
+struct TransientImageRequest {
+    TransientImageDesc desc;
+    uint32_t firstPass;
+    uint32_t lastPass;
+
+    bool operator==(const TransientImageRequest&) const = default;
+};
+
+// Backs the transient images of a frame. Images only ever used as
+// attachments are created with eTransientAttachment and, where the device
+// has it, lazily allocated memory that tilers never back with real memory.
+// The rest share one allocation in which images whose passes do not overlap
+// alias the same bytes. A placement is kept for as long as frames request
+// the same images.
+class TransientAttachmentPool {
+   public:
+    void init(Device* device);
+    void destroy();
+
+    // Picks or creates the placement for the requests, getTexture() and
+    // getAliases() index the requests
+    void place(const std::vector<TransientImageRequest>& requests,
+               uint64_t frame);
+
+    const Texture& getTexture(uint32_t index) const {
+        return placements[current].textures[index];
+    }
+    // Images of the placement sharing memory with the given one. Whatever
+    // used them last has to finish before the image's first use.
+    const std::vector<vk::Image>& getAliases(uint32_t index) const {
+        return placements[current].aliases[index];
+    }
+
+    // Destroys the placements no frame in flight still uses and returns
+    // their images
+    std::vector<vk::Image> releaseUnused(uint64_t frame);
+
+    bool hasLazyMemory() const { return lazyMemory; }
+
+   private:
+    struct Placement {
+        std::vector<TransientImageRequest> requests;
+        std::vector<Texture> textures;
+        std::vector<std::vector<vk::Image>> aliases;
+        // Shared by the aliased images, their textures own no allocation
+        VmaAllocation memory = VK_NULL_HANDLE;
+        uint64_t lastFrame;
+    };
+
+    Device* device;
+    bool lazyMemory = false;
+
+    std::vector<Placement> placements;
+    uint32_t current = 0;
+
+    Placement createPlacement(
+        const std::vector<TransientImageRequest>& requests);
+    void destroyPlacement(Placement& placement);
+    bool isLazy(const TransientImageDesc& desc) const;
+};
+}  // namespace Engine
@@ -0,0 +1,52 @@
+#include "gfx/vulkan/UniformRing.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace Engine {
+namespace {
+vk::DeviceSize alignUp(vk::DeviceSize size, vk::DeviceSize alignment) {
+    return (size + alignment - 1) / alignment * alignment;
+}
+}  // namespace
+
+void UniformRing::init(Device* device, vk::DeviceSize frameSize) {
+    auto limits = device->getPhysicalDevice().getProperties().limits;
+    alignment =
+        std::max<vk::DeviceSize>(limits.minUniformBufferOffsetAlignment, 1);
+    this->frameSize = alignUp(frameSize, alignment);
+
+    buffer = device->createBuffer();
+    buffer.allocate(this->frameSize * MAX_FRAMES_IN_FLIGHT,
+                    vk::BufferUsageFlagBits::eUniformBuffer, true);
+}
+
+void UniformRing::destroy() { buffer.destroy(); }
+
+void UniformRing::begin(uint32_t frameIndex) {
+    frameOffset = frameSize * frameIndex;
+    offset = 0;
+}
+
+uint32_t UniformRing::push(const void* data, vk::DeviceSize size) {
+    if (offset + size > frameSize) {
+        throw std::runtime_error("uniform ring is full");
+    }
+
+    auto dynamicOffset = frameOffset + offset;
+    std::memcpy(
+        static_cast<char*>(buffer.allocationInfo.pMappedData) + dynamicOffset,
+        data, size);
+    offset = alignUp(offset + size, alignment);
+    return static_cast<uint32_t>(dynamicOffset);
+}
+
+vk::DescriptorBufferInfo UniformRing::getDescriptorInfo(
+    vk::DeviceSize range) const {
+    return {
+        .buffer = buffer.buffer,
+        .offset = 0,
+        .range = range,
+    };
+}
+}  // namespace Engine
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "gfx/vulkan/VulkanUsage.hpp"
+#include "gfx/vulkan/Resource.hpp"
+#include "gfx/vulkan/Device.hpp"
+
+namespace Engine {
+// Uniform data of the frames in flight, one persistently mapped buffer with
+// a region per frame. Every push is copied to the next free spot of the
+// current frame's region, aligned to minUniformBufferOffsetAlignment, and
+// bound through a dynamic uniform buffer descriptor with the returned
+// offset. A frame never overwrites data an earlier frame still reads.
+class UniformRing {
+   public:
+    void init(Device* device, vk::DeviceSize frameSize);
+    void destroy();
+
+    // Starts over on the region of frameIndex, the GPU must be done with it
+    void begin(uint32_t frameIndex);
+
+    // Returns the dynamic offset of the copy
+    uint32_t push(const void* data, vk::DeviceSize size);
+    template <typename T>
+    uint32_t push(const T& data) {
+        return push(&data, sizeof(T));
+    }
+
+    // For eUniformBufferDynamic descriptors, range is the size of the
+    // struct bound at the dynamic offsets
+    vk::DescriptorBufferInfo getDescriptorInfo(vk::DeviceSize range) const;
+
+   private:
+    Buffer buffer;
+    vk::DeviceSize alignment = 1;
+    vk::DeviceSize frameSize = 0;
+
+    vk::DeviceSize frameOffset = 0;
+    vk::DeviceSize offset = 0;
+};
+}  // namespace Engine
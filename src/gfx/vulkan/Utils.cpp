@@ -1,27 +1,20 @@
 #include "gfx/vulkan/Utils.hpp"
+#include "gfx/vulkan/BarrierBatch.hpp"
 
 namespace Engine {
 void imageLayoutTransition(vk::CommandBuffer cmdBuffer,
                            vk::ImageAspectFlags imageAspectFlags,
-                           vk::PipelineStageFlagBits srcStageMask,
-                           vk::PipelineStageFlagBits dstStageMask,
-                           vk::AccessFlags srcAccessMask,
-                           vk::AccessFlags dstAccessMask,
+                           vk::PipelineStageFlags2 srcStageMask,
+                           vk::PipelineStageFlags2 dstStageMask,
+                           vk::AccessFlags2 srcAccessMask,
+                           vk::AccessFlags2 dstAccessMask,
                            vk::ImageLayout oldLayout, vk::ImageLayout newLayout,
-                           vk::Image image, uint32_t mipLevels) {
-    vk::ImageMemoryBarrier imageBarrier{
-        .srcAccessMask = srcAccessMask,
-        .dstAccessMask = dstAccessMask,
-        .oldLayout = oldLayout,
-        .newLayout = newLayout,
-        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-        .image = image,
-        .subresourceRange =
-            vk::ImageSubresourceRange{imageAspectFlags, 0, mipLevels, 0, 1}};
-
-    cmdBuffer.pipelineBarrier(srcStageMask, dstStageMask, {}, nullptr, nullptr,
-                              imageBarrier);
+                           vk::Image image) {
+    BarrierBatch()
+        .addImage(image, wholeImageRange(imageAspectFlags), srcStageMask,
+                  srcAccessMask, dstStageMask, dstAccessMask, oldLayout,
+                  newLayout)
+        .record(cmdBuffer);
 }
 
 VKAPI_ATTR VkBool32 VKAPI_CALL debugMessageFunc(
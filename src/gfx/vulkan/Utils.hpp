@@ -12,14 +12,16 @@ inline void vkCheckResult(VkResult result) {
     }
 }
 
+// One off transition of every mip level and layer, use a BarrierBatch to
+// record several barriers or parts of an image
 void imageLayoutTransition(vk::CommandBuffer cmdBuffer,
                            vk::ImageAspectFlags imageAspectFlags,
-                           vk::PipelineStageFlagBits srcStageMask,
-                           vk::PipelineStageFlagBits dstStageMask,
-                           vk::AccessFlags srcAccessMask,
-                           vk::AccessFlags dstAccessMask,
+                           vk::PipelineStageFlags2 srcStageMask,
+                           vk::PipelineStageFlags2 dstStageMask,
+                           vk::AccessFlags2 srcAccessMask,
+                           vk::AccessFlags2 dstAccessMask,
                            vk::ImageLayout oldLayout, vk::ImageLayout newLayout,
-                           vk::Image image, uint32_t mipLevels = 1);
+                           vk::Image image);
 
 VKAPI_ATTR VkBool32 VKAPI_CALL debugMessageFunc(
     vk::DebugUtilsMessageSeverityFlagBitsEXT messageSeverity,